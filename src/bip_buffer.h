@@ -0,0 +1,256 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+//
+// bip_buffer is a byte queue where every write reservation is a single
+// contiguous region, for APIs that need one output buffer (e.g.
+// deflate() or a TLS library) and can't write into the two segments
+// returned by inline_deque::reserve_back().
+//
+// It's the ring buffer of an inline_deque<char> (see inline_deque.h).
+// When a reservation doesn't fit between the back of the queue and the
+// end of the storage, the rest of the storage is left unused as
+// padding, and the reservation starts from the beginning of the
+// storage instead. Reads skip the padding. Since writes never wrap
+// around the end of the storage, each committed write can also be
+// read back as a single contiguous region.
+//
+// At most one padding region exists at a time. The padding counts
+// towards the capacity, but not the size. When a reservation doesn't
+// fit anywhere, the data is copied to new storage (usually twice as
+// large) without the padding, and the reservation is made after it.
+//
+// Template parameters are as for inline_deque, except that the
+// element type is always char.
+//
+// * bip_buffer(size_t initial_capacity = InlineCapacity,
+//              const Allocator& alloc = Allocator())
+// * char* reserve_contiguous(size_t n)
+//   Grow the queue if needed, and return a pointer to n contiguous
+//   bytes of free space after the back of the queue. Valid until the
+//   queue is modified other than by commit_back().
+// * void commit_back(size_t k)
+//   Add the first k bytes of the last reservation to the queue. Raises
+//   an exception if k is larger than the reservation.
+// * segment peek_contiguous()
+// * const_segment peek_contiguous() const
+//   Return the longest contiguous region of bytes at the front of the
+//   queue. If the queue is not empty, this is at least the oldest
+//   committed write (or what's left of it).
+// * void consume_front(size_t k)
+//   Remove the first k bytes. Raises an exception if the queue has
+//   fewer than k bytes.
+// * empty(), size(), capacity(), clear(), get_allocator()
+//
+// Copying and moving are as for inline_deque.
+
+#ifndef BIP_BUFFER_H
+#define BIP_BUFFER_H
+
+#include <algorithm>
+
+#include "inline_deque.h"
+
+template<size_t InlineCapacity = 64,
+         typename CapacityType = uint32_t,
+         class Allocator = std::allocator<char>>
+class bip_buffer
+    : protected inline_deque<char, InlineCapacity, CapacityType, Allocator> {
+public:
+    typedef inline_deque<char, InlineCapacity, CapacityType,
+                         Allocator> base;
+    typedef typename base::segment segment;
+    typedef typename base::const_segment const_segment;
+    typedef CapacityType size_type;
+
+    explicit bip_buffer(size_t initial_capacity = InlineCapacity,
+                        const Allocator& alloc = Allocator())
+        : base(initial_capacity, alloc) {
+    }
+
+    char* reserve_contiguous(size_t n) {
+        while (true) {
+            CapacityType capacity = this->capacity_;
+            CapacityType start = this->ptr_write() & (capacity - 1);
+            CapacityType tail = capacity - start;
+            if (n > tail && base::empty()) {
+                // Nothing to pad around; start over at the beginning
+                // of the storage.
+                this->ptr_.read_ += tail;
+                this->ptr_.write_ += tail;
+                start = 0;
+                tail = capacity;
+            }
+            CapacityType free = capacity - base::size();
+            if (free >= n) {
+                if (tail >= n) {
+                    reserved_ = n;
+                    return this->storage() + start;
+                }
+                if (!pad_ && free - tail >= n) {
+                    pad_at_ = this->ptr_write();
+                    pad_ = tail;
+                    this->ptr_.write_ += tail;
+                    reserved_ = n;
+                    return this->storage();
+                }
+            }
+            grow(n);
+        }
+    }
+
+    void commit_back(size_t k) {
+        if (k > reserved_) {
+            inline_deque_detail::throw_out_of_range();
+        }
+        reserved_ -= k;
+        base::commit_back(k);
+    }
+
+    segment peek_contiguous() {
+        segment ret = { this->storage() + read_offset(),
+                        contiguous_size() };
+        return ret;
+    }
+
+    const_segment peek_contiguous() const {
+        const_segment ret = { this->storage() + read_offset(),
+                              contiguous_size() };
+        return ret;
+    }
+
+    void consume_front(size_t k) {
+        if (k > size()) {
+            inline_deque_detail::throw_out_of_range();
+        }
+        reserved_ = 0;
+        while (k) {
+            size_t count = std::min<size_t>(k, contiguous_size());
+            base::consume_front(count);
+            k -= count;
+            skip_padding();
+        }
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    CapacityType size() const {
+        return base::size() - pad_;
+    }
+
+    CapacityType capacity() const {
+        return base::capacity();
+    }
+
+    void clear() {
+        base::clear();
+        pad_ = 0;
+        reserved_ = 0;
+    }
+
+    Allocator get_allocator() const {
+        return base::get_allocator();
+    }
+
+    // Copying / assignment. A copy keeps the indices of the original,
+    // so the padding stays where it was.
+
+    bip_buffer(const bip_buffer& other) = default;
+
+    bip_buffer(bip_buffer&& other)
+        : base(std::move(other)) {
+        move_from(other);
+    }
+
+    bip_buffer& operator=(const bip_buffer& other) = default;
+
+    bip_buffer& operator=(bip_buffer&& other) {
+        if (&other != this) {
+            base::operator=(std::move(other));
+            move_from(other);
+        }
+        return *this;
+    }
+
+protected:
+    // Move the data to a new buffer, starting at the beginning of the
+    // storage, such that there are at least n bytes of free space
+    // after it. The padding is dropped. The buffer is grown unless the
+    // data and the reservation take at most half of the current
+    // capacity, in which case the data is just compacted.
+    //
+    // This always copies rather than using the resizing of
+    // inline_deque, which would keep the padding in the middle of the
+    // data, and might not leave the free space in one piece.
+    INLINE_DEQUE_COLD void grow(size_t n) {
+        CapacityType data = size();
+        if (n > base::max_size() - data) {
+            inline_deque_detail::throw_length_error();
+        }
+        CapacityType new_capacity = this->capacity_;
+        if (data + n > new_capacity / 2) {
+            new_capacity = inline_deque_detail::grow_capacity<CapacityType>(
+                this->capacity_, data, n);
+        }
+        base fresh(new_capacity, get_allocator());
+        segment space[2];
+        if (fresh.reserve_back(data, space)) {
+            // The new queue is empty, so the space is in one piece.
+            char* to = space[0].data;
+            segment out[2];
+            CapacityType before_pad = pad_ ?
+                CapacityType(pad_at_ - this->ptr_read()) : data;
+            int count = this->segments(0, before_pad, out);
+            for (int i = 0; i < count; ++i) {
+                to = std::copy(out[i].begin(), out[i].end(), to);
+            }
+            count = this->segments(before_pad + pad_, base::size(), out);
+            for (int i = 0; i < count; ++i) {
+                to = std::copy(out[i].begin(), out[i].end(), to);
+            }
+            fresh.commit_back(data);
+        }
+        base::operator=(std::move(fresh));
+        pad_ = 0;
+    }
+
+    void move_from(bip_buffer& other) {
+        pad_at_ = other.pad_at_;
+        pad_ = other.pad_;
+        other.pad_ = 0;
+        other.reserved_ = 0;
+    }
+
+    size_t read_offset() const {
+        return this->ptr_read() & (this->capacity_ - 1);
+    }
+
+    // The number of bytes from the front of the queue to the padding,
+    // the back of the queue, or the end of the storage, whichever
+    // comes first.
+    CapacityType contiguous_size() const {
+        CapacityType data = pad_ ? CapacityType(pad_at_ - this->ptr_read()) :
+            base::size();
+        return std::min<size_t>(data, this->capacity_ - read_offset());
+    }
+
+    void skip_padding() {
+        if (pad_ && this->ptr_read() == pad_at_) {
+            CapacityType pad = pad_;
+            pad_ = 0;
+            base::consume_front(pad);
+        }
+    }
+
+    // The start index and length of the padding, if any.
+    CapacityType pad_at_ = 0;
+    CapacityType pad_ = 0;
+    // The number of bytes from the last reservation that can still be
+    // committed.
+    size_t reserved_ = 0;
+};
+
+#endif // BIP_BUFFER_H
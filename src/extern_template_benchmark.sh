@@ -0,0 +1,112 @@
+#!/bin/sh
+#
+# Copyright 2016 Juho Snellman, released under a MIT license (see
+# LICENSE).
+#
+# Measure the effect of the explicit instantiations in
+# inline_deque_instances.h on a synthetic project with many
+# translation units, each of which uses a few common inline_deque
+# instantiations. The project is built twice: once including
+# inline_deque.h, and once including inline_deque_instances.h and
+# linking in the explicit instantiations. Reports the total time
+# spent compiling (not counting the instantiations themselves,
+# which are only compiled once) and linking, and the .text size of
+# the object files and of the final binary. The instantiations are
+# compiled with -ffunction-sections, and the binaries linked with
+# --gc-sections, so that unused members don't end up in the binary.
+#
+# Usage: extern_template_benchmark.sh [compiler] [translation units]
+
+CXX=${1:-${CXX:-c++}}
+UNITS=${2:-32}
+FLAGS="-std=c++11 -O3"
+SRC=$(cd "$(dirname "$0")" && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+now_ms() {
+    echo $(($(date +%s%N) / 1000000))
+}
+
+text_size() {
+    size -A "$@" | awk '$1 ~ /^\.text/ { sum += $2 } END { print sum + 0 }'
+}
+
+generate() {
+    header=$1
+    dir=$2
+    mkdir -p "$dir"
+    echo "#include <cstdint>" > "$dir/main.cc"
+    i=0
+    while [ $i -lt "$UNITS" ]; do
+        cat > "$dir/unit$i.cc" <<UNIT
+#include "$SRC/$header"
+
+template<typename Q, typename V>
+static uint64_t exercise(Q& q, V v) {
+    uint64_t n = 0;
+    for (int i = 0; i < $i + 10; ++i) {
+        q.push_back(v);
+        q.emplace_front(v);
+    }
+    q.insert(q.begin() + 1, v);
+    q.erase(q.begin() + 2, q.begin() + 4);
+    Q copy(q);
+    n += copy.size() + (q.at(1 + $i % 4) == v);
+    while (!q.empty()) {
+        q.pop_front();
+        ++n;
+    }
+    q.shrink_to_fit();
+    return n;
+}
+
+uint64_t unit$i() {
+    inline_deque<uint32_t, 16> a;
+    inline_deque<uint64_t> b;
+    inline_deque<void*, 4> c;
+    inline_deque<std::string, 4> d;
+    return exercise(a, uint32_t($i)) + exercise(b, uint64_t($i)) +
+        exercise(c, (void*) 0) + exercise(d, std::string("$i"));
+}
+UNIT
+        echo "uint64_t unit$i();" >> "$dir/main.cc"
+        i=$((i + 1))
+    done
+    echo "int main() { uint64_t n = 0;" >> "$dir/main.cc"
+    i=0
+    while [ $i -lt "$UNITS" ]; do
+        echo "n += unit$i();" >> "$dir/main.cc"
+        i=$((i + 1))
+    done
+    echo "return n == 0; }" >> "$dir/main.cc"
+}
+
+# Print "<compile ms> <link ms> <object .text> <binary .text>"
+build() {
+    dir=$1
+    shift
+    start=$(now_ms)
+    for f in "$dir"/*.cc; do
+        $CXX $FLAGS -c "$f" -o "${f%.cc}.o" || exit 1
+    done
+    mid=$(now_ms)
+    $CXX $FLAGS -Wl,--gc-sections "$dir"/*.o "$@" -o "$dir/bin" || exit 1
+    end=$(now_ms)
+    echo "$((mid - start)) $((end - mid)) $(text_size "$dir"/*.o)" \
+         "$(text_size "$dir/bin")"
+}
+
+$CXX $FLAGS -ffunction-sections -c "$SRC/inline_deque_instances.cc" \
+    -o "$TMP/instances.o" || exit 1
+
+generate inline_deque.h "$TMP/plain"
+generate inline_deque_instances.h "$TMP/extern"
+
+printf "%-24s %10s %10s %12s %12s\n" \
+    "$UNITS translation units" "compile ms" "link ms" "objects .text" \
+    "binary .text"
+set -- $(build "$TMP/plain")
+printf "%-24s %10d %10d %12d %12d\n" "inline_deque.h" $1 $2 $3 $4
+set -- $(build "$TMP/extern" "$TMP/instances.o")
+printf "%-24s %10d %10d %12d %12d\n" "inline_deque_instances.h" $1 $2 $3 $4
@@ -0,0 +1,170 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+//
+// Measure splitting a stream of length-prefixed frames in an
+// inline_byte_deque, as it would arrive from a socket in 4KB chunks.
+// The frames are 16 bytes to 2KB, mostly small. Every frame is read
+// in full by the consumer.
+//
+// * copy: copy each frame out of the queue into a separate buffer
+//   (the usual approach).
+// * segments: frame_reader, with the consumer reading the payload
+//   directly from the one or two segments of queue storage.
+// * contiguous: frame_reader, with the consumer asking for a
+//   contiguous payload, so that only the frames split across the end
+//   of the storage are copied.
+//
+// Usage: frame_benchmark [megabytes of input, default 1000]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "frame_reader.h"
+#include "inline_byte_deque.h"
+
+typedef inline_byte_deque<64> byte_queue;
+typedef frame_reader<byte_queue> reader_type;
+
+static const size_t kChunk = 4096;
+
+static std::vector<char> make_input(size_t bytes) {
+    std::mt19937 rand(1);
+    std::vector<char> input;
+    while (input.size() < bytes) {
+        uint32_t r = rand();
+        uint32_t size = 16 + (r >> 8) % (r % 4 ? 113 : 2033);
+        for (int i = 3; i >= 0; --i) {
+            input.push_back(size >> (8 * i));
+        }
+        for (uint32_t i = 0; i < size; ++i) {
+            input.push_back(i);
+        }
+    }
+    return input;
+}
+
+static uint64_t read_payload(const char* data, size_t size) {
+    uint64_t csum = size;
+    for (size_t i = 0; i < size; ++i) {
+        csum += data[i];
+    }
+    return csum;
+}
+
+// Append a chunk of the input to the queue, as read_from() would.
+static void receive(byte_queue* q, const std::vector<char>& input,
+                    size_t* pos) {
+    byte_queue::segment out[2];
+    size_t n = std::min(kChunk, input.size() - *pos);
+    int count = q->reserve_back(n, out);
+    for (int i = 0; i < count; ++i) {
+        memcpy(out[i].data, input.data() + *pos, out[i].size);
+        *pos += out[i].size;
+    }
+    q->commit_back(n);
+}
+
+static uint64_t run_copy(const std::vector<char>& input, size_t* frames) {
+    byte_queue q;
+    std::vector<char> buffer;
+    uint64_t csum = 0;
+    size_t pos = 0;
+    while (pos < input.size()) {
+        receive(&q, input, &pos);
+        while (q.size() >= 4) {
+            size_t length = 0;
+            for (int i = 0; i < 4; ++i) {
+                length = (length << 8) | static_cast<unsigned char>(q[i]);
+            }
+            if (q.size() - 4 < length) {
+                break;
+            }
+            q.consume_front(4);
+            buffer.resize(length);
+            byte_queue::segment out[2];
+            int count = q.peek_front(length, out);
+            size_t offset = 0;
+            for (int i = 0; i < count; ++i) {
+                memcpy(buffer.data() + offset, out[i].data, out[i].size);
+                offset += out[i].size;
+            }
+            q.consume_front(length);
+            csum += read_payload(buffer.data(), length);
+            ++*frames;
+        }
+    }
+    return csum;
+}
+
+static uint64_t run_segments(const std::vector<char>& input, size_t* frames) {
+    byte_queue q;
+    reader_type reader;
+    reader_type::frame f;
+    uint64_t csum = 0;
+    size_t pos = 0;
+    while (pos < input.size()) {
+        receive(&q, input, &pos);
+        while (reader.next(q, &f)) {
+            csum += f.size;
+            for (int i = 0; i < f.count; ++i) {
+                csum += read_payload(f.segments[i].data,
+                                     f.segments[i].size) -
+                    f.segments[i].size;
+            }
+            reader.pop(q, f);
+            ++*frames;
+        }
+    }
+    return csum;
+}
+
+static uint64_t run_contiguous(const std::vector<char>& input,
+                               size_t* frames) {
+    byte_queue q;
+    reader_type reader;
+    reader_type::frame f;
+    uint64_t csum = 0;
+    size_t pos = 0;
+    while (pos < input.size()) {
+        receive(&q, input, &pos);
+        while (reader.next(q, &f)) {
+            csum += read_payload(reader.contiguous(f), f.size);
+            reader.pop(q, f);
+            ++*frames;
+        }
+    }
+    return csum;
+}
+
+static void bench(const char* label,
+                  uint64_t (*fn)(const std::vector<char>&, size_t*),
+                  const std::vector<char>& input) {
+    typedef std::chrono::steady_clock clock;
+    size_t frames = 0;
+    auto start = clock::now();
+    uint64_t csum = fn(input, &frames);
+    auto end = clock::now();
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    printf("%-12s %10.1f ms  %8.1f MB/s  %zu frames  (%lu)\n",
+           label, ms, input.size() / 1048576.0 / (ms / 1000), frames, csum);
+}
+
+int main(int argc, char** argv) {
+    size_t megabytes = 1000;
+    if (argc > 1) {
+        megabytes = strtoull(argv[1], NULL, 10);
+    }
+
+    std::vector<char> input = make_input(megabytes << 20);
+    bench("copy", run_copy, input);
+    bench("segments", run_segments, input);
+    bench("contiguous", run_contiguous, input);
+
+    return 0;
+}
@@ -0,0 +1,129 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+//
+// frame_reader splits the contents of a byte queue (an
+// inline_byte_deque, or any inline_deque<char>) into length-prefixed
+// frames, without copying them out of the queue.
+//
+// Each frame is a LengthType length in network byte order (big
+// endian), followed by that many bytes of payload. The data may
+// arrive in arbitrary chunks, e.g. from inline_byte_deque::read_from(),
+// and the ring buffer of the queue may wrap around in the middle of
+// either the length or the payload. A complete frame is returned as
+// the one or two segments of queue storage that hold its payload.
+// Only if the consumer needs the payload in one piece, and it's split
+// across the end of the storage, is it copied into a scratch buffer
+// owned by the frame_reader.
+//
+// Template parameters:
+//
+// * class Deque
+//   The type of the queue.
+// * typename LengthType
+//   The type of the length prefix, e.g. uint16_t or uint32_t.
+//
+// * frame_reader(size_t max_frame_size = 16 << 20)
+//   Frames with a length over max_frame_size are rejected.
+// * bool next(Deque& q, frame* out)
+//   If the queue starts with a complete frame, store its payload in
+//   "out" and return true. Otherwise return false; call again once
+//   more data has been added. Raises std::length_error if the length
+//   of the frame is over max_frame_size. Doesn't modify the queue.
+// * void pop(Deque& q, const frame& f)
+//   Remove the frame f (returned by next()) from the front of the
+//   queue. Invalidates f.
+// * const char* contiguous(const frame& f)
+//   Return a pointer to the payload of f as a single array: either
+//   directly to the queue storage, or to a copy in the scratch buffer.
+//   Valid until the next call to contiguous() or until f is
+//   invalidated, whichever comes first.
+//
+// A frame has the members:
+//
+// * typename Deque::segment segments[2]
+// * int count
+//   The segments holding the payload (0 for an empty payload).
+// * size_t size
+//   The total size of the payload.
+//
+// Example:
+//
+//   frame_reader<inline_byte_deque<>> reader;
+//   frame_reader<inline_byte_deque<>>::frame f;
+//   while (q.read_from(fd) > 0) {
+//       while (reader.next(q, &f)) {
+//           handle(reader.contiguous(f), f.size);
+//           reader.pop(q, f);
+//       }
+//   }
+
+#ifndef FRAME_READER_H
+#define FRAME_READER_H
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+template<class Deque, typename LengthType = uint32_t>
+class frame_reader {
+public:
+    typedef typename Deque::segment segment;
+
+    static const size_t kHeaderSize = sizeof(LengthType);
+
+    struct frame {
+        segment segments[2];
+        int count;
+        size_t size;
+    };
+
+    explicit frame_reader(size_t max_frame_size = 16 << 20)
+        : max_frame_size_(max_frame_size) {
+    }
+
+    bool next(Deque& q, frame* out) {
+        if (q.size() < kHeaderSize) {
+            return false;
+        }
+        // The length may itself be split across the end of the
+        // storage, so read it byte by byte.
+        size_t length = 0;
+        for (size_t i = 0; i < kHeaderSize; ++i) {
+            length = (length << 8) | static_cast<unsigned char>(q[i]);
+        }
+        if (length > max_frame_size_) {
+            throw std::length_error("frame too large");
+        }
+        if (q.size() - kHeaderSize < length) {
+            return false;
+        }
+        out->count = q.segments(kHeaderSize, kHeaderSize + length,
+                                out->segments);
+        out->size = length;
+        return true;
+    }
+
+    void pop(Deque& q, const frame& f) {
+        q.consume_front(kHeaderSize + f.size);
+    }
+
+    const char* contiguous(const frame& f) {
+        if (f.count < 2) {
+            return f.count ? f.segments[0].data : scratch_.data();
+        }
+        scratch_.resize(f.size);
+        memcpy(scratch_.data(), f.segments[0].data, f.segments[0].size);
+        memcpy(scratch_.data() + f.segments[0].size, f.segments[1].data,
+               f.segments[1].size);
+        return scratch_.data();
+    }
+
+private:
+    size_t max_frame_size_;
+    std::vector<char> scratch_;
+};
+
+#endif // FRAME_READER_H
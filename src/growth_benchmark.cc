@@ -0,0 +1,119 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+//
+// Measure the cost of growing large queues of trivially copyable
+// elements, with the default allocator (every resize copies all
+// elements to a new buffer) and with realloc_allocator (the buffer
+// is reallocated in place, and only the shorter segment of a wrapped
+// queue is moved).
+//
+// * fill: push_back only, so the queue is never wrapped when it's
+//   resized.
+// * wrapped: push two elements at the back for every one popped from
+//   the front, so the queue is usually wrapped when it's resized.
+// * shrink: fill the queue (untimed), and then pop_back all elements,
+//   so that the queue is repeatedly shrunk. realloc_allocator shrinks
+//   in place, moving at most one segment.
+//
+// hybrid_deque is included for comparison: it switches to a chunked
+// representation past 64K elements, and never copies after that.
+//
+// Also reports the time of the single slowest push, which for large
+// queues is the final resize.
+//
+// Usage: growth_benchmark [max elements, default 100M]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "hybrid_deque.h"
+#include "inline_deque.h"
+#include "inline_deque_allocator.h"
+
+template<typename Q>
+void bench_shrink(const char* label, size_t count) {
+    typedef std::chrono::steady_clock clock;
+    double max_ms = 0;
+    uint64_t csum = 0;
+    Q q;
+    for (uint64_t i = 0; i < count; ++i) {
+        q.push_back(i);
+    }
+    auto start = clock::now();
+    while (!q.empty()) {
+        auto op_start = clock::now();
+        csum += q.back();
+        q.pop_back();
+        double op_ms = std::chrono::duration<double, std::milli>(
+            clock::now() - op_start).count();
+        if (op_ms > max_ms) {
+            max_ms = op_ms;
+        }
+    }
+    auto end = clock::now();
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    printf("%-10zu %-8s %-18s %10.1f ms  %8.1f ms max  (%lu)\n",
+           count, "shrink", label, ms, max_ms, csum);
+}
+
+template<typename Q>
+void bench(const char* label, const char* pattern, size_t count) {
+    typedef std::chrono::steady_clock clock;
+    double max_ms = 0;
+    uint64_t csum = 0;
+    auto start = clock::now();
+    {
+        Q q;
+        bool wrapped = pattern[0] == 'w';
+        uint64_t i = 0;
+        while (q.size() < count) {
+            auto op_start = clock::now();
+            q.push_back(i++);
+            if (wrapped) {
+                q.push_back(i++);
+            }
+            double op_ms = std::chrono::duration<double, std::milli>(
+                clock::now() - op_start).count();
+            if (op_ms > max_ms) {
+                max_ms = op_ms;
+            }
+            if (wrapped) {
+                csum += q.front();
+                q.pop_front();
+            }
+        }
+        csum += q.back();
+    }
+    auto end = clock::now();
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    printf("%-10zu %-8s %-18s %10.1f ms  %8.1f ms max  (%lu)\n",
+           count, pattern, label, ms, max_ms, csum);
+}
+
+int main(int argc, char** argv) {
+    size_t max_count = 100000000;
+    if (argc > 1) {
+        max_count = strtoull(argv[1], NULL, 10);
+    }
+
+    typedef inline_deque<uint64_t, 1, uint32_t> default_queue;
+    typedef inline_deque<uint64_t, 1, uint32_t,
+                         realloc_allocator<uint64_t>> realloc_queue;
+    typedef hybrid_deque<uint64_t> hybrid_queue;
+
+    for (size_t count = 1000000; count <= max_count; count *= 10) {
+        bench<default_queue>("std::allocator", "fill", count);
+        bench<realloc_queue>("realloc_allocator", "fill", count);
+        bench<hybrid_queue>("hybrid_deque", "fill", count);
+        bench<default_queue>("std::allocator", "wrapped", count);
+        bench<realloc_queue>("realloc_allocator", "wrapped", count);
+        bench<hybrid_queue>("hybrid_deque", "wrapped", count);
+        bench_shrink<default_queue>("std::allocator", count);
+        bench_shrink<realloc_queue>("realloc_allocator", count);
+    }
+
+    return 0;
+}
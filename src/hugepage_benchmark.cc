@@ -0,0 +1,93 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+//
+// Measure access to large queues with buffers on normal pages
+// (std::allocator) and on huge pages (hugepage_allocator, with
+// transparent huge pages and with the hugetlbfs pool).
+//
+// * fill: push_back the given number of elements.
+// * seq: sum all elements with operator[], in order.
+// * random: sum the same number of elements at random indices.
+//
+// Also reports how much of the process memory was on transparent
+// huge pages while the queue was alive (from /proc/self/smaps_rollup),
+// since whether it is depends on the kernel configuration.
+//
+// Usage: hugepage_benchmark [elements, default 64M]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "inline_deque.h"
+#include "inline_deque_allocator.h"
+
+static long anon_huge_kb() {
+    FILE* f = fopen("/proc/self/smaps_rollup", "r");
+    if (!f) {
+        return -1;
+    }
+    char line[256];
+    long kb = -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "AnonHugePages:", 14) == 0) {
+            kb = strtol(line + 14, NULL, 10);
+        }
+    }
+    fclose(f);
+    return kb;
+}
+
+template<typename Q>
+void bench(const char* label, uint64_t count) {
+    typedef std::chrono::steady_clock clock;
+    typedef std::chrono::duration<double, std::milli> ms;
+    Q q;
+
+    auto start = clock::now();
+    for (uint64_t i = 0; i < count; ++i) {
+        q.push_back(i);
+    }
+    auto filled = clock::now();
+
+    uint64_t csum = 0;
+    for (uint64_t i = 0; i < count; ++i) {
+        csum += q[i];
+    }
+    auto scanned = clock::now();
+
+    uint64_t x = 88172645463325252ull;
+    for (uint64_t i = 0; i < count; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        csum += q[x % count];
+    }
+    auto random = clock::now();
+
+    printf("%-24s fill %8.1f ms  seq %8.1f ms  random %8.1f ms  "
+           "huge %7ld kB  (%lu)\n",
+           label, ms(filled - start).count(), ms(scanned - filled).count(),
+           ms(random - scanned).count(), anon_huge_kb(), csum);
+}
+
+int main(int argc, char** argv) {
+    uint64_t count = 64 * 1024 * 1024;
+    if (argc > 1) {
+        count = strtoull(argv[1], NULL, 10);
+    }
+
+    bench<inline_deque<uint64_t>>("std::allocator", count);
+    bench<inline_deque<uint64_t, 1, uint32_t,
+                       hugepage_allocator<uint64_t>>>(
+        "hugepage_allocator", count);
+    bench<inline_deque<uint64_t, 1, uint32_t,
+                       hugepage_allocator<uint64_t, 2 * 1024 * 1024,
+                                          true>>>(
+        "hugepage_allocator (tlb)", count);
+
+    return 0;
+}
@@ -0,0 +1,526 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+//
+// hybrid_deque is a double-ended queue that switches between
+// representations depending on its size:
+//
+// * Small queues are stored inline, and medium sized ones in a
+//   single ring buffer, exactly like inline_deque (see
+//   inline_deque.h).
+// * When the ring buffer would need to grow beyond ChunkThreshold
+//   elements, the queue switches to a chunked representation like
+//   std::deque: the elements are stored in fixed size blocks, with
+//   a ring buffer of block pointers. Growth at either end then just
+//   allocates a new block, without copying any elements or
+//   over-allocating more than a block.
+// * When a chunked queue shrinks below ChunkThreshold / 4 elements,
+//   it switches back to a single ring buffer. The gap between the
+//   two thresholds keeps a queue whose size hovers around the
+//   threshold from switching back and forth.
+//
+// Switching representations moves all elements, like a resize of an
+// inline_deque does. If allocating the blocks fails, the queue stays
+// in the single ring buffer. Other than that, which representation
+// is in use is not visible through the API.
+//
+// Template parameters:
+//
+// * typename T, size_t InlineCapacity, typename CapacityType,
+//   class Allocator
+//   As for inline_deque.
+// * size_t ChunkThreshold
+//   The largest capacity of the single ring buffer. Must be a power
+//   of two, and at least as large as the block size.
+// * size_t BlockSize
+//   The number of elements per block in the chunked representation.
+//   Must be a power of two. Defaults to about 4KB worth of elements,
+//   but at least 16.
+//
+// The API is a subset of the inline_deque one:
+//
+// * hybrid_deque(const Allocator& alloc = Allocator())
+// * push_front(), push_back(), emplace_front(), emplace_back()
+// * pop_front(), pop_back()
+// * front(), back(), operator[], at()
+// * empty(), size(), max_size(), clear()
+// * begin(), end(), cbegin(), cend() (random access iterators)
+// * copy and move construction / assignment
+// * get_allocator()
+//
+// Additionally:
+//
+// * bool chunked() const
+//   Return true if the queue is currently using the chunked
+//   representation.
+//
+// Invalidation: As for inline_deque, except that in the chunked
+// representation pushing and popping at the ends of the queue never
+// invalidates references to other elements.
+
+#ifndef HYBRID_DEQUE_H
+#define HYBRID_DEQUE_H
+
+#include "inline_deque.h"
+
+namespace hybrid_deque_detail {
+
+// The largest power of two that's at most n (n must be at least 1).
+constexpr size_t floor_pow2(size_t n, size_t p = 1) {
+    return p * 2 > n ? p : floor_pow2(n, p * 2);
+}
+
+// Blocks are about 4KB, but with at least 16 elements.
+constexpr size_t block_size(size_t element_size) {
+    return floor_pow2(4096 / element_size < 16 ? 16 :
+                      4096 / element_size);
+}
+
+}  // namespace hybrid_deque_detail
+
+template<typename T,
+         size_t InlineCapacity = 1,
+         typename CapacityType = uint32_t,
+         class Allocator = std::allocator<T>,
+         size_t ChunkThreshold = 65536,
+         size_t BlockSize = hybrid_deque_detail::block_size(sizeof(T))>
+class hybrid_deque {
+public:
+    static const size_t kBlockSize = BlockSize;
+
+    static_assert((BlockSize & (BlockSize - 1)) == 0,
+                  "BlockSize must be a power of two");
+    static_assert((ChunkThreshold & (ChunkThreshold - 1)) == 0,
+                  "ChunkThreshold must be a power of two");
+    static_assert(ChunkThreshold >= kBlockSize,
+                  "ChunkThreshold must be at least the block size");
+    static_assert(ChunkThreshold > InlineCapacity,
+                  "ChunkThreshold must be larger than InlineCapacity");
+
+    typedef T value_type;
+    typedef Allocator allocator_type;
+    typedef CapacityType size_type;
+    typedef ptrdiff_t difference_type;
+    typedef T& reference;
+    typedef const T& const_reference;
+
+    typedef inline_deque<T, InlineCapacity, CapacityType, Allocator> ring_type;
+
+    explicit hybrid_deque(const Allocator& alloc = Allocator())
+        : ring_(InlineCapacity, alloc),
+          chunks_(alloc) {
+    }
+
+    ~hybrid_deque() {
+        clear();
+    }
+
+    // Adding new elements at front / back of queue.
+
+    void push_front(const T& e) {
+        emplace_front(e);
+    }
+
+    void push_back(const T& e) {
+        emplace_back(e);
+    }
+
+    void push_front(T&& e) {
+        emplace_front(std::move(e));
+    }
+
+    void push_back(T&& e) {
+        emplace_back(std::move(e));
+    }
+
+    template<typename... Args>
+    void emplace_front(Args&&... args) {
+        if (!chunked_) {
+            if (!ring_full()) {
+                ring_.emplace_front(std::forward<Args>(args)...);
+                return;
+            }
+            to_chunked();
+        }
+        require_space();
+        if (chunks_.offset_ == 0) {
+            T* block = new_block();
+            try {
+                chunks_.map_.push_front(block);
+            } catch (...) {
+                free_block(block);
+                throw;
+            }
+            chunks_.offset_ = kBlockSize;
+        }
+        chunks_.construct(&chunk_slot(-1), std::forward<Args>(args)...);
+        chunks_.offset_--;
+        chunks_.size_++;
+    }
+
+    template<typename... Args>
+    void emplace_back(Args&&... args) {
+        if (!chunked_) {
+            if (!ring_full()) {
+                ring_.emplace_back(std::forward<Args>(args)...);
+                return;
+            }
+            to_chunked();
+        }
+        require_space();
+        if (chunks_.offset_ + chunks_.size_ ==
+            chunks_.map_.size() * kBlockSize) {
+            T* block = new_block();
+            try {
+                chunks_.map_.push_back(block);
+            } catch (...) {
+                free_block(block);
+                throw;
+            }
+        }
+        chunks_.construct(&chunk_slot(chunks_.size_),
+                          std::forward<Args>(args)...);
+        chunks_.size_++;
+    }
+
+    // Accessing items (front, back, random access, pop).
+
+    const T& front() const {
+        require_nonempty();
+        return (*this)[0];
+    }
+
+    const T& back() const {
+        require_nonempty();
+        return (*this)[size() - 1];
+    }
+
+    T& front() {
+        require_nonempty();
+        return (*this)[0];
+    }
+
+    T& back() {
+        require_nonempty();
+        return (*this)[size() - 1];
+    }
+
+    T& operator[] (size_t i) {
+        return chunked_ ? chunk_slot(i) : ring_[i];
+    }
+
+    const T& operator[] (size_t i) const {
+        return chunked_ ? chunk_slot(i) : ring_[i];
+    }
+
+    T& at(size_t i) {
+        if (i >= size()) {
+            inline_deque_detail::throw_out_of_range();
+        }
+        return (*this)[i];
+    }
+
+    const T& at(size_t i) const {
+        if (i >= size()) {
+            inline_deque_detail::throw_out_of_range();
+        }
+        return (*this)[i];
+    }
+
+    void pop_front() {
+        if (!chunked_) {
+            ring_.pop_front();
+            return;
+        }
+        require_nonempty();
+        chunks_.destroy(&chunk_slot(0));
+        chunks_.offset_++;
+        chunks_.size_--;
+        if (chunks_.offset_ == kBlockSize) {
+            free_block(chunks_.map_.front());
+            chunks_.map_.pop_front();
+            chunks_.offset_ = 0;
+        }
+        maybe_to_ring();
+    }
+
+    void pop_back() {
+        if (!chunked_) {
+            ring_.pop_back();
+            return;
+        }
+        require_nonempty();
+        chunks_.size_--;
+        chunks_.destroy(&chunk_slot(chunks_.size_));
+        if (chunks_.offset_ + chunks_.size_ ==
+            (chunks_.map_.size() - 1) * kBlockSize) {
+            free_block(chunks_.map_.back());
+            chunks_.map_.pop_back();
+        }
+        maybe_to_ring();
+    }
+
+    // Size of queue
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    CapacityType size() const {
+        return chunked_ ? chunks_.size_ : ring_.size();
+    }
+
+    CapacityType max_size() const {
+        return ring_.max_size();
+    }
+
+    bool chunked() const {
+        return chunked_;
+    }
+
+    void clear() {
+        if (chunked_) {
+            for (CapacityType i = 0; i < chunks_.size_; ++i) {
+                chunks_.destroy(&chunk_slot(i));
+            }
+            free_blocks();
+            chunked_ = false;
+        } else {
+            ring_.clear();
+            ring_.shrink_to_fit();
+        }
+    }
+
+    // Copying / assignment
+
+    hybrid_deque(const hybrid_deque& other)
+        : hybrid_deque(other.chunks_) {
+        for (CapacityType i = 0; i < other.size(); ++i) {
+            emplace_back(other[i]);
+        }
+    }
+
+    hybrid_deque(hybrid_deque&& other)
+        : ring_(std::move(other.ring_)),
+          chunks_(other.chunks_) {
+        move_from(other);
+    }
+
+    hybrid_deque& operator=(const hybrid_deque& other) {
+        if (&other != this) {
+            hybrid_deque tmp(other);
+            *this = std::move(tmp);
+        }
+        return *this;
+    }
+
+    hybrid_deque& operator=(hybrid_deque&& other) {
+        if (&other != this) {
+            clear();
+            ring_ = std::move(other.ring_);
+            move_from(other);
+        }
+        return *this;
+    }
+
+    // Iterators
+
+    typedef inline_deque_detail::index_iterator<
+        hybrid_deque, T> iterator;
+    typedef inline_deque_detail::index_iterator<
+        const hybrid_deque, const T> const_iterator;
+
+    iterator begin() {
+        return iterator(this, 0);
+    }
+
+    iterator end() {
+        return iterator(this, size());
+    }
+
+    const_iterator begin() const {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const {
+        return const_iterator(this, size());
+    }
+
+    const_iterator cbegin() const {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator cend() const {
+        return const_iterator(this, size());
+    }
+
+    // Misc
+
+    Allocator get_allocator() const {
+        return chunks_;
+    }
+
+protected:
+    typedef typename std::allocator_traits<Allocator>::template
+        rebind_alloc<T*> map_allocator;
+    typedef inline_deque<T*, 8, size_t, map_allocator> map_type;
+
+    // The ring buffer can't grow any further without exceeding the
+    // threshold.
+    bool ring_full() const {
+        return ring_.size() == ring_.capacity() &&
+            ring_.capacity() >= ChunkThreshold;
+    }
+
+    // Everything is allocated and constructed in a separate map
+    // first, so that if that fails the queue is still a valid ring.
+    INLINE_DEQUE_COLD void to_chunked() {
+        CapacityType count = ring_.size();
+        map_type map((count + kBlockSize - 1) / kBlockSize,
+                     map_allocator(get_allocator()));
+        CapacityType constructed = 0;
+        try {
+            for (CapacityType i = 0; i < count; i += kBlockSize) {
+                map.push_back(chunks_.allocate(kBlockSize));
+            }
+            for (; constructed < count; ++constructed) {
+                chunks_.construct(&map[constructed / kBlockSize]
+                                  [constructed % kBlockSize],
+                                  std::move(ring_[constructed]));
+            }
+        } catch (...) {
+            for (CapacityType i = 0; i < constructed; ++i) {
+                chunks_.destroy(&map[i / kBlockSize][i % kBlockSize]);
+            }
+            for (size_t i = 0; i < map.size(); ++i) {
+                chunks_.deallocate(map[i], kBlockSize);
+            }
+            throw;
+        }
+        chunks_.map_ = std::move(map);
+        chunks_.offset_ = 0;
+        chunks_.size_ = count;
+        chunked_ = true;
+        ring_.clear();
+        ring_.shrink_to_fit();
+    }
+
+    void maybe_to_ring() {
+        if (chunks_.size_ < ChunkThreshold / 4) {
+            to_ring();
+        }
+    }
+
+    INLINE_DEQUE_COLD void to_ring() {
+        ring_type ring(chunks_.size_ * 2, chunks_);
+        for (CapacityType i = 0; i < chunks_.size_; ++i) {
+            ring.emplace_back(std::move(chunk_slot(i)));
+            chunks_.destroy(&chunk_slot(i));
+        }
+        free_blocks();
+        ring_ = std::move(ring);
+        chunked_ = false;
+    }
+
+    T* new_block() {
+        if (chunks_.spare_) {
+            T* block = chunks_.spare_;
+            chunks_.spare_ = NULL;
+            return block;
+        }
+        return chunks_.allocate(kBlockSize);
+    }
+
+    // Keep one freed block around, so that a queue whose size
+    // oscillates across a block boundary doesn't allocate and free
+    // a block on every operation.
+    void free_block(T* block) {
+        if (chunks_.spare_) {
+            chunks_.deallocate(block, kBlockSize);
+        } else {
+            chunks_.spare_ = block;
+        }
+    }
+
+    void free_blocks() {
+        for (size_t i = 0; i < chunks_.map_.size(); ++i) {
+            chunks_.deallocate(chunks_.map_[i], kBlockSize);
+        }
+        chunks_.map_.clear();
+        chunks_.map_.shrink_to_fit();
+        if (chunks_.spare_) {
+            chunks_.deallocate(chunks_.spare_, kBlockSize);
+            chunks_.spare_ = NULL;
+        }
+        chunks_.offset_ = 0;
+        chunks_.size_ = 0;
+    }
+
+    void move_from(hybrid_deque& other) {
+        chunks_.map_ = std::move(other.chunks_.map_);
+        chunks_.offset_ = other.chunks_.offset_;
+        chunks_.size_ = other.chunks_.size_;
+        chunks_.spare_ = other.chunks_.spare_;
+        chunked_ = other.chunked_;
+        other.chunks_.offset_ = 0;
+        other.chunks_.size_ = 0;
+        other.chunks_.spare_ = NULL;
+        other.chunked_ = false;
+    }
+
+    // The chunked representation has no capacity limiting its size,
+    // so check against max_size() before each push.
+    void require_space() const {
+        if (chunks_.size_ >= max_size()) {
+            inline_deque_detail::throw_length_error();
+        }
+    }
+
+    void require_nonempty() const {
+        if (empty()) {
+            inline_deque_detail::throw_empty();
+        }
+    }
+
+    // The element at index i (which may be -1, for push_front()) of
+    // the chunked representation.
+    T& chunk_slot(ptrdiff_t i) {
+        size_t index = chunks_.offset_ + i;
+        return chunks_.map_[index / kBlockSize][index % kBlockSize];
+    }
+
+    const T& chunk_slot(ptrdiff_t i) const {
+        size_t index = chunks_.offset_ + i;
+        return chunks_.map_[index / kBlockSize][index % kBlockSize];
+    }
+
+    ring_type ring_;
+
+    // The chunked representation. Element i is at index offset_ + i
+    // of the concatenation of the blocks in map_.
+    struct chunks : Allocator {
+        chunks(const Allocator& alloc)
+            : Allocator(alloc),
+              map_(8, map_allocator(alloc)) {
+        }
+
+        chunks(const chunks& other)
+            : Allocator(other),
+              map_(8, map_allocator(other)) {
+        }
+
+        map_type map_;
+        size_t offset_ = 0;
+        CapacityType size_ = 0;
+        T* spare_ = NULL;
+    } chunks_;
+    bool chunked_ = false;
+};
+
+template<typename T, size_t InlineCapacity, typename CapacityType,
+         class Allocator, size_t ChunkThreshold, size_t BlockSize>
+const size_t hybrid_deque<T, InlineCapacity, CapacityType, Allocator,
+                          ChunkThreshold, BlockSize>::kBlockSize;
+
+#endif // HYBRID_DEQUE_H
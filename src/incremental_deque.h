@@ -0,0 +1,464 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+//
+// incremental_deque is a variant of inline_deque (see inline_deque.h)
+// with a bounded worst case cost for every operation.
+//
+// When an inline_deque is full, the push that overflows it moves all
+// the elements to a new buffer of twice the size, which is an O(n)
+// stall. An incremental_deque instead allocates the new buffer but
+// leaves the elements in the old one, and keeps both buffers around
+// while migrating at most MigrateStep elements to the new buffer on
+// each subsequent operation. Until the migration is complete, each
+// element access has to check which of the two buffers the element
+// is in.
+//
+// The migration always finishes before the new buffer gets full, so
+// there are never more than two buffers. The cost of this is a few
+// percent of throughput, and an extra buffer of memory while
+// migrating. There is no inline storage, and the queue never shrinks
+// except on an explicit shrink_to_fit().
+//
+// Template parameters:
+//
+// * typename T
+//   The type of the elements
+// * typename CapacityType
+//   The type of the indices
+// * class Allocator
+//   The allocator used for memory allocation and element
+//   construction / destruction.
+// * size_t MigrateStep
+//   The maximum number of elements migrated per operation. Must be
+//   at least 1.
+//
+// The API is a subset of the inline_deque one:
+//
+// * incremental_deque(size_t initial_capacity = 0,
+//                     const Allocator& alloc = Allocator())
+// * push_front(), push_back(), emplace_front(), emplace_back()
+// * pop_front(), pop_back()
+// * front(), back(), operator[], at()
+// * empty(), size(), max_size(), capacity(), clear(), shrink_to_fit()
+// * begin(), end(), cbegin(), cend() (random access iterators)
+// * copy and move construction / assignment
+// * get_allocator()
+//
+// Additionally:
+//
+// * bool migrating() const
+//   Return true if some elements are still in the old buffer.
+// * void finish_migration()
+//   Migrate all the remaining elements to the new buffer, and free
+//   the old buffer.
+//
+// Invalidation: References to elements are invalidated whenever the
+// element is migrated, i.e. by any operation on the queue while
+// migrating() is true. Iterators are invalidated as for inline_deque.
+
+#ifndef INCREMENTAL_DEQUE_H
+#define INCREMENTAL_DEQUE_H
+
+#include "inline_deque.h"
+
+template<typename T,
+         typename CapacityType = uint32_t,
+         class Allocator = std::allocator<T>,
+         size_t MigrateStep = 2>
+class incremental_deque {
+public:
+    static_assert(MigrateStep > 0, "MigrateStep must be at least 1");
+
+    typedef T value_type;
+    typedef Allocator allocator_type;
+    typedef CapacityType size_type;
+    typedef ptrdiff_t difference_type;
+    typedef T& reference;
+    typedef const T& const_reference;
+
+    explicit incremental_deque(size_t initial_capacity = 0,
+                               const Allocator& alloc = Allocator())
+        : ptr_(alloc) {
+        if (initial_capacity) {
+            capacity_ = 1;
+            while (capacity_ < initial_capacity) {
+                capacity_ *= 2;
+            }
+            e_ = ptr_.allocate(capacity_);
+        }
+    }
+
+    ~incremental_deque() {
+        reset();
+    }
+
+    // Adding new elements at front / back of queue.
+
+    void push_front(const T& e) {
+        emplace_front(e);
+    }
+
+    void push_back(const T& e) {
+        emplace_back(e);
+    }
+
+    void push_front(T&& e) {
+        emplace_front(std::move(e));
+    }
+
+    void push_back(T&& e) {
+        emplace_back(std::move(e));
+    }
+
+    template<typename... Args>
+    void emplace_front(Args&&... args) {
+        if (full()) {
+            overflow();
+        }
+        ptr_.construct(&new_slot(ptr_.read_ - 1),
+                       std::forward<Args>(args)...);
+        ptr_.read_--;
+        migrate();
+    }
+
+    template<typename... Args>
+    void emplace_back(Args&&... args) {
+        if (full()) {
+            overflow();
+        }
+        ptr_.construct(&new_slot(ptr_.write_),
+                       std::forward<Args>(args)...);
+        ptr_.write_++;
+        migrate();
+    }
+
+    // Accessing items (front, back, random access, pop).
+
+    const T& front() const {
+        require_nonempty();
+        return slot(ptr_.read_);
+    }
+
+    const T& back() const {
+        require_nonempty();
+        return slot(ptr_.write_ - 1);
+    }
+
+    T& front() {
+        require_nonempty();
+        return slot(ptr_.read_);
+    }
+
+    T& back() {
+        require_nonempty();
+        return slot(ptr_.write_ - 1);
+    }
+
+    T& operator[] (size_t i) {
+        return slot(ptr_.read_ + i);
+    }
+
+    const T& operator[] (size_t i) const {
+        return slot(ptr_.read_ + i);
+    }
+
+    T& at(size_t i) {
+        if (i >= size()) {
+            inline_deque_detail::throw_out_of_range();
+        }
+        return slot(ptr_.read_ + i);
+    }
+
+    const T& at(size_t i) const {
+        if (i >= size()) {
+            inline_deque_detail::throw_out_of_range();
+        }
+        return slot(ptr_.read_ + i);
+    }
+
+    void pop_front() {
+        require_nonempty();
+        if (in_old(ptr_.read_)) {
+            ptr_.destroy(&old_slot(ptr_.read_));
+            migrate_begin_++;
+        } else {
+            ptr_.destroy(&new_slot(ptr_.read_));
+        }
+        ptr_.read_++;
+        migrate();
+    }
+
+    void pop_back() {
+        require_nonempty();
+        ptr_.write_--;
+        if (in_old(ptr_.write_)) {
+            ptr_.destroy(&old_slot(ptr_.write_));
+            migrate_end_--;
+        } else {
+            ptr_.destroy(&new_slot(ptr_.write_));
+        }
+        migrate();
+    }
+
+    // Size of queue
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    CapacityType size() const {
+        return ptr_.write_ - ptr_.read_;
+    }
+
+    CapacityType max_size() const {
+        return (std::numeric_limits<CapacityType>::max() >> 1) + 1;
+    }
+
+    CapacityType capacity() const {
+        return capacity_;
+    }
+
+    bool migrating() const {
+        return old_e_ != NULL;
+    }
+
+    void clear() {
+        while (!empty()) {
+            ptr_.destroy(&slot(ptr_.read_));
+            ptr_.read_++;
+        }
+        migrate_begin_ = migrate_end_;
+        free_old();
+    }
+
+    void shrink_to_fit() {
+        finish_migration();
+        CapacityType new_capacity = capacity_;
+        // (Not "new_capacity > size() * 2", which overflows for a
+        // queue of max_size() elements.)
+        while (new_capacity && new_capacity - size() > size()) {
+            new_capacity /= 2;
+        }
+        if (new_capacity == capacity_) {
+            return;
+        }
+        T* new_e = new_capacity ? ptr_.allocate(new_capacity) : NULL;
+        for (CapacityType i = 0; i < size(); ++i) {
+            ptr_.construct(&new_e[i], std::move(slot(ptr_.read_ + i)));
+            ptr_.destroy(&slot(ptr_.read_ + i));
+        }
+        if (e_) {
+            ptr_.deallocate(e_, capacity_);
+        }
+        e_ = new_e;
+        capacity_ = new_capacity;
+        ptr_.write_ -= ptr_.read_;
+        ptr_.read_ = 0;
+    }
+
+    void finish_migration() {
+        while (migrating()) {
+            migrate();
+        }
+    }
+
+    // Copying / assignment
+
+    incremental_deque(const incremental_deque& other)
+        : incremental_deque(other.size(), other.ptr_) {
+        for (CapacityType i = 0; i < other.size(); ++i) {
+            emplace_back(other[i]);
+        }
+    }
+
+    incremental_deque(incremental_deque&& other)
+        : ptr_(other.ptr_) {
+        move_from(other);
+    }
+
+    incremental_deque& operator=(const incremental_deque& other) {
+        if (&other != this) {
+            incremental_deque tmp(other);
+            *this = std::move(tmp);
+        }
+        return *this;
+    }
+
+    incremental_deque& operator=(incremental_deque&& other) {
+        if (&other != this) {
+            reset();
+            ptr_ = other.ptr_;
+            move_from(other);
+        }
+        return *this;
+    }
+
+    // Iterators
+
+    typedef inline_deque_detail::index_iterator<
+        incremental_deque, T> iterator;
+    typedef inline_deque_detail::index_iterator<
+        const incremental_deque, const T> const_iterator;
+
+    iterator begin() {
+        return iterator(this, 0);
+    }
+
+    iterator end() {
+        return iterator(this, size());
+    }
+
+    const_iterator begin() const {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const {
+        return const_iterator(this, size());
+    }
+
+    const_iterator cbegin() const {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator cend() const {
+        return const_iterator(this, size());
+    }
+
+    // Misc
+
+    Allocator get_allocator() const {
+        return ptr_;
+    }
+
+protected:
+    bool full() const {
+        return size() == capacity_;
+    }
+
+    // Switch to a new buffer of twice the size. All the current
+    // elements are left in the old buffer, to be migrated later.
+    INLINE_DEQUE_COLD void overflow() {
+        // Only reachable while migrating if MigrateStep elements per
+        // operation wasn't enough, which can't happen. But be safe.
+        finish_migration();
+        CapacityType new_capacity =
+            inline_deque_detail::grow_capacity<CapacityType>(
+                capacity_, size(), 1);
+        T* new_e = ptr_.allocate(new_capacity);
+        if (empty()) {
+            if (e_) {
+                ptr_.deallocate(e_, capacity_);
+            }
+        } else {
+            old_e_ = e_;
+            old_capacity_ = capacity_;
+            migrate_begin_ = ptr_.read_;
+            migrate_end_ = ptr_.write_;
+        }
+        e_ = new_e;
+        capacity_ = new_capacity;
+    }
+
+    // Move up to MigrateStep elements from the old buffer to the new
+    // one, starting from the front of the queue. Pushes call this
+    // only after the new element has been constructed, so that
+    // arguments referring to elements of the queue stay valid.
+    void migrate() {
+        if (!migrating()) {
+            return;
+        }
+        for (size_t i = 0; i < MigrateStep &&
+                 migrate_begin_ != migrate_end_; ++i) {
+            T& from = old_slot(migrate_begin_);
+            ptr_.construct(&new_slot(migrate_begin_), std::move(from));
+            ptr_.destroy(&from);
+            migrate_begin_++;
+        }
+        if (migrate_begin_ == migrate_end_) {
+            free_old();
+        }
+    }
+
+    void free_old() {
+        if (old_e_) {
+            ptr_.deallocate(old_e_, old_capacity_);
+            old_e_ = NULL;
+            old_capacity_ = 0;
+        }
+    }
+
+    void move_from(incremental_deque& other) {
+        e_ = other.e_;
+        capacity_ = other.capacity_;
+        old_e_ = other.old_e_;
+        old_capacity_ = other.old_capacity_;
+        migrate_begin_ = other.migrate_begin_;
+        migrate_end_ = other.migrate_end_;
+        other.e_ = NULL;
+        other.capacity_ = 0;
+        other.old_e_ = NULL;
+        other.old_capacity_ = 0;
+        other.ptr_.read_ = other.ptr_.write_;
+    }
+
+    void reset() {
+        clear();
+        if (e_) {
+            ptr_.deallocate(e_, capacity_);
+            e_ = NULL;
+            capacity_ = 0;
+        }
+    }
+
+    void require_nonempty() const {
+        if (empty()) {
+            inline_deque_detail::throw_empty();
+        }
+    }
+
+    // True if the element at this index has not been migrated yet.
+    bool in_old(CapacityType index) const {
+        return old_e_ &&
+            CapacityType(index - migrate_begin_) <
+            CapacityType(migrate_end_ - migrate_begin_);
+    }
+
+    T& slot(CapacityType index) {
+        return in_old(index) ? old_slot(index) : new_slot(index);
+    }
+
+    const T& slot(CapacityType index) const {
+        return in_old(index) ? old_slot(index) : new_slot(index);
+    }
+
+    T& old_slot(CapacityType index) {
+        return old_e_[index & (old_capacity_ - 1)];
+    }
+
+    const T& old_slot(CapacityType index) const {
+        return old_e_[index & (old_capacity_ - 1)];
+    }
+
+    T& new_slot(CapacityType index) {
+        return e_[index & (capacity_ - 1)];
+    }
+
+    const T& new_slot(CapacityType index) const {
+        return e_[index & (capacity_ - 1)];
+    }
+
+    T* e_ = NULL;
+    CapacityType capacity_ = 0;
+    // The old buffer, and the range of indices whose elements are
+    // still in it.
+    T* old_e_ = NULL;
+    CapacityType old_capacity_ = 0;
+    CapacityType migrate_begin_ = 0;
+    CapacityType migrate_end_ = 0;
+
+    inline_deque_detail::ring_ptrs<Allocator, CapacityType> ptr_;
+};
+
+#endif // INCREMENTAL_DEQUE_H
@@ -0,0 +1,101 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+//
+// inline_byte_deque is an inline_deque of chars (see inline_deque.h)
+// for use as an I/O buffer. In addition to the normal queue API, it
+// can read data from a file descriptor directly into its free space,
+// and write its contents directly to a file descriptor, with readv()
+// and writev() on the (at most two) contiguous segments of storage.
+// No data is copied through a temporary buffer.
+//
+// Template parameters are as for inline_deque, except that the
+// element type is always char.
+//
+// * ssize_t read_from(int fd, size_t max_bytes = 4096)
+//   Read at most max_bytes bytes from fd, and add them at the back of
+//   the queue. If the queue has any free space, at most that much is
+//   read, and the queue isn't resized. Only a full queue is first
+//   grown, so that it has space for max_bytes more bytes (raising
+//   std::length_error if that would exceed max_size()). The growth is
+//   kept even if nothing is then read. Returns the number of bytes
+//   read, 0 at end of file, or -1 on error (with errno set, e.g. to
+//   EAGAIN for a non-blocking fd with no data). Only the bytes
+//   actually read are added.
+// * ssize_t write_to(int fd, size_t max_bytes = SIZE_MAX)
+//   Write at most max_bytes bytes from the front of the queue to fd,
+//   and remove the written bytes from the queue. Returns the number
+//   of bytes written, or -1 on error (with errno set). Only the bytes
+//   actually written are removed.
+//
+// Invalidation: As for inline_deque. read_from() may resize a full
+// queue.
+
+#ifndef INLINE_BYTE_DEQUE_H
+#define INLINE_BYTE_DEQUE_H
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "inline_deque.h"
+
+template<size_t InlineCapacity = 64,
+         typename CapacityType = uint32_t,
+         class Allocator = std::allocator<char>>
+class inline_byte_deque
+    : public inline_deque<char, InlineCapacity, CapacityType, Allocator> {
+public:
+    typedef inline_deque<char, InlineCapacity, CapacityType,
+                         Allocator> base;
+
+    explicit inline_byte_deque(size_t initial_capacity = InlineCapacity,
+                               const Allocator& alloc = Allocator())
+        : base(initial_capacity, alloc) {
+    }
+
+    ssize_t read_from(int fd, size_t max_bytes = 4096) {
+        if (!max_bytes) {
+            return 0;
+        }
+        size_t free = this->capacity() - this->size();
+        if (free) {
+            max_bytes = std::min(max_bytes, free);
+        }
+        typename base::segment segments[2];
+        struct iovec iov[2];
+        int count = this->reserve_back(max_bytes, segments);
+        to_iovec(segments, count, iov);
+        ssize_t ret = readv(fd, iov, count);
+        if (ret > 0) {
+            this->commit_back(ret);
+        }
+        return ret;
+    }
+
+    ssize_t write_to(int fd, size_t max_bytes = SIZE_MAX) {
+        typename base::segment segments[2];
+        struct iovec iov[2];
+        int count = this->peek_front(max_bytes, segments);
+        if (!count) {
+            return 0;
+        }
+        to_iovec(segments, count, iov);
+        ssize_t ret = writev(fd, iov, count);
+        if (ret > 0) {
+            this->consume_front(ret);
+        }
+        return ret;
+    }
+
+protected:
+    static void to_iovec(const typename base::segment* segments, int count,
+                         struct iovec* out) {
+        for (int i = 0; i < count; ++i) {
+            out[i].iov_base = segments[i].data;
+            out[i].iov_len = segments[i].size;
+        }
+    }
+};
+
+#endif // INLINE_BYTE_DEQUE_H
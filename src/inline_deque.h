@@ -34,18 +34,30 @@
 //   The maximum number of elements to store inline. This number should
 //   be a power of two.
 // * typename CapacityType
-//   The type of the indices
+//   The type of the indices. Any unsigned integer type works; the
+//   queue can hold at most half of the range of the type. Use
+//   uint64_t for queues that may grow beyond 2^31 elements.
 // * class Allocator
 //   The allocator used for memory allocation and element
-//   construction / destruction
+//   construction / destruction. (Except that trivially copyable
+//   elements are moved to a new buffer with memcpy when the queue
+//   is resized, rather than with construct() / destroy()). If the
+//   allocator has a reallocate() member function, queues of
+//   trivially copyable elements grow their heap storage in place
+//   with it; see inline_deque_allocator.h.
+// * class OverflowPolicy
+//   What to do when adding an element to a full queue. See "Overflow
+//   policies" below.
 //
 // Constructors:
 //
 // * inline_deque(size_t initial_capacity = InlineCapacity,
-//                const Allocator& alloc = Allocator()) -
+//                const Allocator& alloc = Allocator(),
+//                const OverflowPolicy& policy = OverflowPolicy()) -
 //   Construct a new queue with space for initial_capacity elements.
 //   Will be rounded up to either InlineCapacity or a power of two,
-//   which ever is higher.
+//   which ever is higher. Raises std::length_error if larger than
+//   max_size().
 // * inline_deque(std::initializer_list<T> init,
 //                const Allocator& alloc = Allocator())
 //   Construct a new queue, setting the contents to the elements of
@@ -56,21 +68,23 @@
 //
 // Modifying elements:
 //
-// * void push_front(const T& e)
-// * void push_back(const T& e)
+// * bool push_front(const T& e)
+// * bool push_back(const T& e)
 //   Insert a copy of this element at the head/tail of the queue.
 //   If queue is full, it will automatically be resized to a larger
 //   capacity.
-// * void push_front(T&& e)
-// * void push_back(T&& e)
+// * bool push_front(T&& e)
+// * bool push_back(T&& e)
 //   Move this element to the the head/tail of the queue. If queue is
 //   full, it will automatically be resized to a larger capacity.
-// * template<typename... Args> void emplace_front(Args&&... args)
-// * template<typename... Args> void emplace_back(Args&&... args)
+// * template<typename... Args> bool emplace_front(Args&&... args)
+// * template<typename... Args> bool emplace_back(Args&&... args)
 //   Construct a new element at the head/tail of the queue.
 //   Insert a copy of this element at the head/tail of the queue.
 //   If queue is full, it will automatically be resized to a larger
 //   capacity.
+//   All of the above return true if the element was added. This is
+//   always the case unless the overflow policy says otherwise.
 // * void pop_front()
 // * void pop_back()
 //   Remove the element at the head/tail of the queue. The element
@@ -111,6 +125,11 @@
 //   Resize the queue such that it is using as little memory as possible,
 //   given the constraints of having to still contain all the elements,
 //   and the capacity having to be a power of two.
+// * void reserve(size_t n)
+//   Resize the queue, if needed, such that it can hold n elements
+//   without being resized again. The capacity is rounded up to a power
+//   of two. Raises std::length_error if n is larger than max_size().
+//   This ignores the overflow policy.
 //
 // Copying / assignment
 //
@@ -142,6 +161,13 @@
 //   Return a constant iterator to the start of the queue, or to the
 //   point past the end of the queue.
 //
+// Iterators have the usual random access iterator operators, and
+// additionally:
+// * int segments(iterator last, segment out[2]) const
+// * int segments(const_iterator last, const_segment out[2]) const
+//   Same as inline_deque::segments(), for the elements in the range
+//   [*this, last). Used by the algorithms in inline_deque_algorithm.h.
+//
 // Iterator operators:
 // * iterator erase(const_iterator pos)
 //   Erase the element at the specified position.
@@ -156,20 +182,631 @@
 // * iterator insert(const_iterator pos, T&& val)
 //   Make space for a new element at the specified position, and move
 //   the element there.
+// * iterator insert(const_iterator pos, size_t n, const T& val)
+//   Make space for n new elements at the specified position, and
+//   insert n copies of the element there. Raises std::length_error
+//   if the queue would grow beyond max_size().
+//
+// Contiguous storage
+//
+// The elements of the queue are stored in at most two contiguous
+// segments of memory: one from the read pointer to the end of the
+// storage, and one from the start of the storage to the write
+// pointer. These give direct access to those segments, for loops
+// that need to run at full speed (see also inline_deque_simd.h).
+// The segments are invalidated by anything that invalidates
+// references.
+//
+// * struct segment { T* data; size_t size; }
+// * struct const_segment { const T* data; size_t size; }
+//   A contiguous range of elements. Has begin() and end() members
+//   returning pointers, and can be used in range-based for loops.
+// * int segments(segment out[2])
+// * int segments(const_segment out[2]) const
+//   Store the segments holding all elements of the queue in "out",
+//   in order. Return the number of non-empty segments (0-2).
+// * int segments(size_t first, size_t last, segment out[2])
+// * int segments(size_t first, size_t last, const_segment out[2]) const
+//   Same as above, but for the elements with indices [first, last).
+// * segment make_contiguous()
+//   Rearrange the elements in place such that they're stored in a
+//   single segment, and return that segment. The elements are
+//   moved within the existing storage, without allocating memory.
+//   Invalidates references, but not iterators. Moves each element
+//   at most a few times (trivially copyable elements with memmove);
+//   if the queue is already contiguous, does nothing.
+//
+// Producers and consumers can also work on the storage directly,
+// e.g. to decode into the queue or to send from it without copying
+// through a temporary buffer:
+//
+// * int reserve_back(size_t n, segment out[2])
+//   Grow the queue if needed so that there's space for n more
+//   elements, and store the (uninitialized) segments for the next n
+//   elements after the back of the queue in "out". Return the number
+//   of segments (1-2, or 0 if n is 0). The segments stay valid until
+//   the queue is modified other than by commit_back().
+// * void commit_back(size_t k)
+//   Add the first k elements of the space returned by reserve_back()
+//   to the back of the queue, without constructing them. The caller
+//   must have constructed them already; for trivial types writing
+//   the values is enough. Raises an exception if there isn't space
+//   for k more elements.
+// * int peek_front(size_t n, segment out[2])
+// * int peek_front(size_t n, const_segment out[2]) const
+//   Store the segments for the first min(n, size()) elements in
+//   "out", and return the number of segments (0-2).
+// * void consume_front(size_t k)
+//   Remove the first k elements, as if by k calls to pop_front().
+//   Raises an exception if the queue has fewer than k elements.
+//
+// Overflow policies
+//
+// By default a full queue grows when an element is added. The
+// OverflowPolicy template parameter can change that, e.g. for
+// bounded buffers. The policy is only consulted when the queue is
+// full, so it costs nothing on the fast path of a push. It's stored
+// in the queue (taking no space if it has no members), and is
+// passed to the constructor. A policy has the members:
+//
+// * inline_deque_overflow on_overflow(size_t capacity)
+//   Called when adding an element to a full queue with the given
+//   capacity. Returns one of:
+//   - inline_deque_overflow::grow: Grow the queue as usual.
+//   - inline_deque_overflow::reject: Don't add the element, and
+//     return false from the push.
+//   - inline_deque_overflow::drop_newest: Same as reject, but count
+//     the element as dropped.
+//   - inline_deque_overflow::overwrite_oldest: Remove the element at
+//     the other end of the queue (the front for push_back(), the back
+//     for push_front()) and count it as dropped, then add the new
+//     element. The new element is constructed first, so it may be a
+//     copy of the removed one (e.g. q.push_back(q.front())).
+//   - inline_deque_overflow::abort: A full queue is a programming
+//     error, and the program is aborted.
+// * void on_drop()
+//   Called for every dropped element.
+// * bool allow_shrink() const
+//   Return false to keep the queue from shrinking automatically when
+//   elements are removed. (shrink_to_fit() still shrinks it.)
+// * void after_push(size_t size)
+// * void after_pop(size_t size)
+//   Called with the new size after elements were added (by a push,
+//   emplace or insert) or removed (by a pop, erase or clear). Empty
+//   in the default policies, so they compile to nothing. Destroying
+//   or assigning over a queue doesn't call after_pop().
+// * void on_moved_from()
+//   Called when the elements of the queue were moved to another
+//   queue, leaving it empty. The other queue gets a copy of the
+//   policy, so this should reset any state that tracks the size.
+//
+// insert() and emplace() never drop elements; if the policy doesn't
+// allow growing, they raise std::length_error.
+//
+// * inline_deque_unbounded
+//   The default policy; always grows.
+// * inline_deque_bounded(size_t max_capacity = SIZE_MAX,
+//                        inline_deque_overflow mode = reject)
+//   Grows the queue until its capacity is max_capacity (rounded up
+//   to a power of two), and then handles overflows according to
+//   "mode". The limit and mode can be changed later with
+//   set_max_capacity() and set_mode(). drops() returns the number of
+//   elements dropped so far, and reset_drops() resets it to 0.
+// * inline_deque_watermarks<Policy = inline_deque_unbounded>
+//   Policy, plus high / low watermarks for flow control. When the
+//   size reaches the high watermark, above_high_watermark() becomes
+//   true and the callback (if any) is called with true. When the size
+//   then drops to the low watermark, above_high_watermark() becomes
+//   false and the callback is called with false. So each crossing
+//   fires once, however the size moves between the watermarks.
+//   Constructed with (high, low, callback, policy); the watermarks can
+//   be changed with set_watermarks(high, low), which doesn't fire the
+//   callback.
+// * inline_deque_no_shrink<Policy = inline_deque_unbounded>
+//   Policy, but never shrinks the queue automatically. For latency
+//   sensitive queues, where the memory should stay allocated (and
+//   faulted in) once the queue has grown to its working size. Use
+//   with reserve() and prefault_allocator (see
+//   inline_deque_allocator.h) to do all the growing up front.
 //
 // Misc
 // * Allocator get_allocator() const
 //   Return the allocator used for this queue.
+// * OverflowPolicy& overflow_policy()
+// * const OverflowPolicy& overflow_policy() const
+//   Return the overflow policy of this queue.
 
 
 #ifndef INLINE_DEQUE_H
 #define INLINE_DEQUE_H
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iterator>
 #include <limits>
+#include <memory>
+#include <new>
 #include <stdexcept>
 #include <type_traits>
 
+// Cold paths (growth, error handling) are kept out of line, and as
+// far as possible outside of the class template. The code that's
+// not templated on T is shared by all instantiations, rather than
+// being duplicated in each one.
+#if defined(__GNUC__)
+#define INLINE_DEQUE_NOINLINE __attribute__((noinline))
+#define INLINE_DEQUE_COLD __attribute__((noinline, cold))
+#else
+#define INLINE_DEQUE_NOINLINE
+#define INLINE_DEQUE_COLD
+#endif
+
+namespace inline_deque_detail {
+
+[[noreturn]] INLINE_DEQUE_COLD inline void throw_empty() {
+    throw std::out_of_range("empty queue");
+}
+
+[[noreturn]] INLINE_DEQUE_COLD inline void throw_out_of_range() {
+    throw std::out_of_range("index too large");
+}
+
+[[noreturn]] INLINE_DEQUE_COLD inline void throw_length_error() {
+    throw std::length_error("max_size exceeded");
+}
+
+// Return the capacity that a queue with the given capacity needs to
+// grow to, for "count" elements to be added to a queue of "size"
+// elements. The capacity is doubled until it's large enough.
+template<typename CapacityType>
+INLINE_DEQUE_NOINLINE CapacityType grow_capacity(CapacityType capacity,
+                                                 CapacityType size,
+                                                 CapacityType count) {
+    if (count > std::numeric_limits<CapacityType>::max() - size) {
+        throw_length_error();
+    }
+    CapacityType needed = size + count;
+    CapacityType new_capacity = capacity ? capacity * 2 : 1;
+    while (new_capacity && new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    if (new_capacity == 0) {
+        throw_length_error();
+    }
+    return new_capacity;
+}
+
+// Copy "count" elements of "size" bytes each from a ring buffer
+// with "capacity" elements at "src", starting at ring index "read",
+// to the start of the array at "dst". Used for relocating trivially
+// copyable elements when a queue is resized.
+INLINE_DEQUE_NOINLINE inline void relocate_trivial(void* dst,
+                                                   const void* src,
+                                                   size_t size,
+                                                   size_t capacity,
+                                                   size_t read,
+                                                   size_t count) {
+    // An empty queue without inline storage has no array at all,
+    // and memcpy() from or to NULL is undefined even for 0 bytes.
+    if (count == 0) {
+        return;
+    }
+    size_t start = read & (capacity - 1);
+    size_t first = std::min(count, capacity - start);
+    memcpy(dst, static_cast<const char*>(src) + start * size,
+           first * size);
+    memcpy(static_cast<char*>(dst) + first * size, src,
+           (count - first) * size);
+}
+
+// After the storage "array" of a ring buffer with "count" elements of
+// "size" bytes each, starting at ring index "read", was reallocated
+// from "old_capacity" to "new_capacity" elements in place, move the
+// shorter of the two segments such that the elements are again in
+// ring order. Return the new storage index of the first element.
+INLINE_DEQUE_NOINLINE inline size_t unwrap_grown(void* array,
+                                                 size_t size,
+                                                 size_t old_capacity,
+                                                 size_t new_capacity,
+                                                 size_t read,
+                                                 size_t count) {
+    char* base = static_cast<char*>(array);
+    size_t start = read & (old_capacity - 1);
+    if (start + count <= old_capacity) {
+        return start;
+    }
+    size_t head = old_capacity - start;
+    size_t tail = count - head;
+    if (tail <= head) {
+        // Append the wrapped prefix after the old end of the storage.
+        memcpy(base + old_capacity * size, base, tail * size);
+        return start;
+    }
+    // Move the head segment to the end of the new storage.
+    memcpy(base + (new_capacity - head) * size, base + start * size,
+           head * size);
+    return new_capacity - head;
+}
+
+// Before the storage "array" of a ring buffer with "count" elements
+// of "size" bytes each, starting at ring index "read", is reallocated
+// in place from "old_capacity" to a smaller "new_capacity", move the
+// elements such that they're all in the first "new_capacity" slots
+// and in ring order for the new capacity. At most one segment is
+// moved, and only to slots that are free at the old capacity, so the
+// elements also stay valid at their old positions. Return the new
+// storage index of the first element.
+INLINE_DEQUE_NOINLINE inline size_t compact_shrunk(void* array,
+                                                   size_t size,
+                                                   size_t old_capacity,
+                                                   size_t new_capacity,
+                                                   size_t read,
+                                                   size_t count) {
+    char* base = static_cast<char*>(array);
+    size_t start = read & (old_capacity - 1);
+    if (start + count > old_capacity) {
+        // Wrapped. The head segment is in the upper half of the
+        // storage, since count <= new_capacity <= old_capacity / 2.
+        // Move it to the end of the new storage.
+        size_t head = old_capacity - start;
+        memcpy(base + (new_capacity - head) * size, base + start * size,
+               head * size);
+        return new_capacity - head;
+    }
+    if (start + count <= new_capacity) {
+        return start;
+    }
+    if (start < new_capacity) {
+        // Move the part beyond the new end to the start, so that it
+        // follows the rest in ring order.
+        size_t tail = start + count - new_capacity;
+        memcpy(base, base + new_capacity * size, tail * size);
+        return start;
+    }
+    memmove(base, base + start * size, count * size);
+    return 0;
+}
+
+// The storage of a queue: either a pointer to a heap allocated array,
+// or the inline elements. Queues without inline storage just have the
+// pointer, so that no code for the inline case is generated for them.
+template<typename T, size_t InlineCapacity>
+union storage {
+    T* inline_array() const {
+        return (T*) inline_e_;
+    }
+
+    T* e_;
+    uint8_t inline_e_[sizeof(T) * InlineCapacity];
+};
+
+template<typename T>
+union storage<T, 0> {
+    T* inline_array() const {
+        return NULL;
+    }
+
+    T* e_;
+};
+
+// True if Allocator has a "T* reallocate(T* p, size_t old_n,
+// size_t new_n)" member function (see inline_deque_allocator.h).
+template<typename Allocator, typename T>
+struct has_reallocate {
+    template<typename A>
+    static auto test(int) -> decltype(
+        std::declval<A&>().reallocate(static_cast<T*>(nullptr),
+                                      size_t(), size_t()),
+        std::true_type());
+    template<typename A>
+    static std::false_type test(...);
+
+    static const bool value = decltype(test<Allocator>(0))::value;
+};
+
+// The index based random access iterator of the deques built on top
+// of inline_deque. RB is the queue type, and VT the element type, both
+// const for a const_iterator. Only the index is stored, so the
+// iterator stays valid across growth of the queue.
+template<typename RB, typename VT>
+struct index_iterator {
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef typename std::remove_const<VT>::type value_type;
+    typedef ptrdiff_t difference_type;
+    typedef VT* pointer;
+    typedef VT& reference;
+
+    index_iterator(RB* q, size_t index)
+        : q_(q), i_(index) {
+    }
+
+    // An iterator converts to a const_iterator, not the other way.
+    template<typename ORB, typename OVT,
+             typename = typename std::enable_if<
+                 std::is_convertible<ORB*, RB*>::value>::type>
+    index_iterator(const index_iterator<ORB, OVT>& other)
+        : q_(other.q_), i_(other.i_) {
+    }
+
+    bool operator==(const index_iterator& other) const {
+        return q_ == other.q_ && i_ == other.i_;
+    }
+    bool operator!=(const index_iterator& other) const {
+        return q_ != other.q_ || i_ != other.i_;
+    }
+    bool operator<(const index_iterator& other) const {
+        return i_ < other.i_;
+    }
+    bool operator>(const index_iterator& other) const {
+        return i_ > other.i_;
+    }
+    bool operator<=(const index_iterator& other) const {
+        return i_ <= other.i_;
+    }
+    bool operator>=(const index_iterator& other) const {
+        return i_ >= other.i_;
+    }
+
+    index_iterator operator+(size_t i) const {
+        return index_iterator(q_, i_ + i);
+    }
+    friend index_iterator operator+(size_t i, const index_iterator& it) {
+        return it + i;
+    }
+    index_iterator& operator+=(size_t i) {
+        i_ += i;
+        return *this;
+    }
+    index_iterator& operator++() {
+        return *this += 1;
+    }
+    index_iterator operator++(int) {
+        index_iterator ret = *this;
+        ++*this;
+        return ret;
+    }
+
+    index_iterator operator-(size_t i) const {
+        return index_iterator(q_, i_ - i);
+    }
+    difference_type operator-(const index_iterator& other) const {
+        return i_ - other.i_;
+    }
+    index_iterator& operator-=(size_t i) {
+        i_ -= i;
+        return *this;
+    }
+    index_iterator& operator--() {
+        return *this -= 1;
+    }
+    index_iterator operator--(int) {
+        index_iterator ret = *this;
+        --*this;
+        return ret;
+    }
+
+    VT& operator*() const {
+        return (*q_)[i_];
+    }
+
+    VT* operator->() const {
+        return &(*q_)[i_];
+    }
+
+    VT& operator[](size_t i) const {
+        return (*q_)[i_ + i];
+    }
+
+private:
+    template<typename ORB, typename OVT>
+    friend struct index_iterator;
+
+    RB* q_;
+    ptrdiff_t i_;
+};
+
+struct no_policy {
+};
+
+// The read and write indices of a ring buffer, together with its
+// allocator and overflow policy. A dummy struct just used for empty
+// base class optimization.
+template<class Allocator, typename CapacityType, class Policy = no_policy>
+struct ring_ptrs : Allocator, Policy {
+    ring_ptrs(const Allocator& alloc, const Policy& policy = Policy())
+        : Allocator(alloc),
+          Policy(policy) {
+    }
+
+    CapacityType read_ = 0;
+    CapacityType write_ = 0;
+};
+
+}  // namespace inline_deque_detail
+
+// What to do when adding an element to a full queue; see the
+// "Overflow policies" section of the documentation above. Also the
+// Policy parameter of static_deque (see static_deque.h).
+enum class inline_deque_overflow {
+    grow,
+    reject,
+    drop_newest,
+    overwrite_oldest,
+    abort,
+};
+
+// The default overflow policy: always grow.
+struct inline_deque_unbounded {
+    inline_deque_overflow on_overflow(size_t capacity) const {
+        return inline_deque_overflow::grow;
+    }
+
+    void on_drop() {
+    }
+
+    bool allow_shrink() const {
+        return true;
+    }
+
+    void after_push(size_t size) {
+    }
+
+    void after_pop(size_t size) {
+    }
+
+    void on_moved_from() {
+    }
+};
+
+// Grow until the capacity reaches max_capacity (rounded up to a power
+// of two), and after that handle overflows with "mode". Counts the
+// dropped elements.
+class inline_deque_bounded {
+public:
+    inline_deque_bounded(size_t max_capacity = SIZE_MAX,
+                         inline_deque_overflow mode =
+                         inline_deque_overflow::reject)
+        : mode_(mode) {
+        set_max_capacity(max_capacity);
+    }
+
+    inline_deque_overflow on_overflow(size_t capacity) const {
+        return capacity < max_capacity_ ? inline_deque_overflow::grow :
+            mode_;
+    }
+
+    void on_drop() {
+        ++drops_;
+    }
+
+    size_t max_capacity() const {
+        return max_capacity_;
+    }
+
+    void set_max_capacity(size_t max_capacity) {
+        max_capacity_ = 1;
+        while (max_capacity_ < max_capacity && max_capacity_ <= SIZE_MAX / 2) {
+            max_capacity_ *= 2;
+        }
+    }
+
+    inline_deque_overflow mode() const {
+        return mode_;
+    }
+
+    void set_mode(inline_deque_overflow mode) {
+        mode_ = mode;
+    }
+
+    // The number of elements dropped by drop_newest or
+    // overwrite_oldest.
+    uint64_t drops() const {
+        return drops_;
+    }
+
+    void reset_drops() {
+        drops_ = 0;
+    }
+
+    bool allow_shrink() const {
+        return true;
+    }
+
+    void after_push(size_t size) {
+    }
+
+    void after_pop(size_t size) {
+    }
+
+    void on_moved_from() {
+    }
+
+private:
+    size_t max_capacity_;
+    inline_deque_overflow mode_;
+    uint64_t drops_ = 0;
+};
+
+// Policy, plus high / low watermarks with a callback.
+template<typename Policy = inline_deque_unbounded>
+class inline_deque_watermarks : public Policy {
+public:
+    typedef std::function<void(bool above)> callback;
+
+    inline_deque_watermarks(size_t high = SIZE_MAX, size_t low = 0,
+                            const callback& cb = callback(),
+                            const Policy& policy = Policy())
+        : Policy(policy), high_(high), low_(low), callback_(cb) {
+    }
+
+    void after_push(size_t size) {
+        if (size >= high_ && !above_) {
+            cross(true);
+        }
+        Policy::after_push(size);
+    }
+
+    void after_pop(size_t size) {
+        if (size <= low_ && above_) {
+            cross(false);
+        }
+        Policy::after_pop(size);
+    }
+
+    // The queue is now empty, but the crossing was inherited by the
+    // queue it was moved to. Don't report it twice.
+    void on_moved_from() {
+        above_ = false;
+        Policy::on_moved_from();
+    }
+
+    bool above_high_watermark() const {
+        return above_;
+    }
+
+    size_t high_watermark() const {
+        return high_;
+    }
+
+    size_t low_watermark() const {
+        return low_;
+    }
+
+    void set_watermarks(size_t high, size_t low) {
+        high_ = high;
+        low_ = low;
+    }
+
+private:
+    INLINE_DEQUE_COLD void cross(bool above) {
+        above_ = above;
+        if (callback_) {
+            callback_(above);
+        }
+    }
+
+    size_t high_;
+    size_t low_;
+    bool above_ = false;
+    callback callback_;
+};
+
+// Policy, except that the queue never shrinks automatically.
+template<typename Policy = inline_deque_unbounded>
+struct inline_deque_no_shrink : Policy {
+    inline_deque_no_shrink(const Policy& policy = Policy())
+        : Policy(policy) {
+    }
+
+    bool allow_shrink() const {
+        return false;
+    }
+};
+
 // The internal implementation of this class is a ring buffer
 // with an array of elements, a capacity, and read/write indices.
 //
@@ -195,17 +832,29 @@
 template<typename T,
          size_t InlineCapacity = 1,
          typename CapacityType = uint32_t,
-         class Allocator = std::allocator<T>>
+         class Allocator = std::allocator<T>,
+         class OverflowPolicy = inline_deque_unbounded>
 class inline_deque {
 public:
     static_assert(InlineCapacity == 0 ||
                   (InlineCapacity & (InlineCapacity - 1)) == 0,
                   "InlineCapacity must be a power of two");
 
+    typedef T value_type;
+    typedef Allocator allocator_type;
+    typedef CapacityType size_type;
+    typedef ptrdiff_t difference_type;
+    typedef T& reference;
+    typedef const T& const_reference;
+
     explicit inline_deque(size_t initial_capacity = InlineCapacity,
-                          const Allocator& alloc = Allocator())
-        : ptr_(alloc) {
+                          const Allocator& alloc = Allocator(),
+                          const OverflowPolicy& policy = OverflowPolicy())
+        : ptr_(alloc, policy) {
         if (initial_capacity > InlineCapacity) {
+            if (initial_capacity > max_size()) {
+                inline_deque_detail::throw_length_error();
+            }
             capacity_ = 1;
             while (capacity_ < initial_capacity) {
                 capacity_ *= 2;
@@ -213,6 +862,9 @@ public:
             e_.e_ = ptr_.allocate(capacity_);
         } else {
             capacity_ = InlineCapacity;
+            if (!use_inline()) {
+                e_.e_ = NULL;
+            }
         }
     }
 
@@ -230,56 +882,68 @@ public:
 
     // Adding new elements at front / back of queue.
 
-    void push_front(const T& e) {
+    bool push_front(const T& e) {
         if (full()) {
-            overflow();
+            return overflow_emplace(false, e);
         }
         ptr_.read_--;
         ptr_.construct(&slot(ptr_read()), e);
+        ptr_.after_push(size());
+        return true;
     }
 
-    void push_back(const T& e) {
+    bool push_back(const T& e) {
         if (full()) {
-            overflow();
+            return overflow_emplace(true, e);
         }
         ptr_.construct(&slot(ptr_write()), e);
         ptr_.write_++;
+        ptr_.after_push(size());
+        return true;
     }
 
-    void push_front(T&& e) {
+    bool push_front(T&& e) {
         if (full()) {
-            overflow();
+            return overflow_emplace(false, std::move(e));
         }
         ptr_.read_--;
         ptr_.construct(&slot(ptr_read()), std::move(e));
+        ptr_.after_push(size());
+        return true;
     }
 
-    void push_back(T&& e) {
+    bool push_back(T&& e) {
         if (full()) {
-            overflow();
+            return overflow_emplace(true, std::move(e));
         }
         ptr_.construct(&slot(ptr_write()), std::move(e));
         ptr_.write_++;
+        ptr_.after_push(size());
+        return true;
     }
 
     template<typename... Args>
-    void emplace_front(Args&&... args) {
+    bool emplace_front(Args&&... args) {
         if (full()) {
-            overflow();
+            return overflow_emplace(false, std::forward<Args>(args)...);
         }
         ptr_.read_--;
         ptr_.construct(&slot(ptr_read()),
                        std::forward<Args>(args)...);
+        ptr_.after_push(size());
+        return true;
     }
 
     template<typename... Args>
-    void emplace_back(Args&&... args) {
+    bool emplace_back(Args&&... args) {
         if (full()) {
-            overflow();
+            return overflow_emplace(true, std::forward<Args>(args)...);
         }
         ptr_.construct(&slot(ptr_write()),
                        std::forward<Args>(args)...);
         ptr_.write_++;
+        ptr_.after_push(size());
+        return true;
     }
 
     // Accessing items (front, back, random access, pop).
@@ -314,14 +978,14 @@ public:
 
     T& at(size_t i) {
         if (i >= size()) {
-            throw std::out_of_range("index too large");
+            inline_deque_detail::throw_out_of_range();
         }
         return slot(ptr_read(i));
     }
 
     const T& at(size_t i) const {
         if (i >= size()) {
-            throw std::out_of_range("index too large");
+            inline_deque_detail::throw_out_of_range();
         }
         return slot(ptr_read(i));
     }
@@ -331,6 +995,7 @@ public:
         ptr_.destroy(&slot(ptr_read()));
         ptr_.read_++;
         shrink();
+        ptr_.after_pop(size());
     }
 
     void pop_back() {
@@ -338,6 +1003,7 @@ public:
         ptr_.write_--;
         ptr_.destroy(&slot(ptr_write()));
         shrink();
+        ptr_.after_pop(size());
     }
 
     // Size of queue
@@ -359,15 +1025,16 @@ public:
     }
 
     void clear() {
-        while (!empty()) {
-            pop_front();
-        }
+        destroy_all();
+        ptr_.after_pop(0);
     }
 
     void shrink_to_fit() {
         CapacityType new_capacity = capacity_;
+        // (Not "new_capacity > size() * 2", which overflows for a
+        // queue of max_size() elements.)
         while (new_capacity &&
-               new_capacity > size() * 2) {
+               new_capacity - size() > size()) {
             new_capacity /= 2;
         }
         if (new_capacity < capacity_) {
@@ -375,6 +1042,17 @@ public:
         }
     }
 
+    void reserve(size_t n) {
+        if (n <= capacity_) {
+            return;
+        }
+        if (n > max_size()) {
+            inline_deque_detail::throw_length_error();
+        }
+        resize(inline_deque_detail::grow_capacity<CapacityType>(
+                   capacity_, 0, n));
+    }
+
     // Copying / assignment
 
     inline_deque(const inline_deque& other)
@@ -410,6 +1088,25 @@ public:
 
     // TODO: swap? assign?
 
+    // A contiguous range of elements in the queue's storage (see
+    // segments()).
+    template<typename VT>
+    struct segment_base {
+        VT* begin() const {
+            return data;
+        }
+
+        VT* end() const {
+            return data + size;
+        }
+
+        VT* data;
+        size_t size;
+    };
+
+    typedef segment_base<T> segment;
+    typedef segment_base<const T> const_segment;
+
     // Iterators
 
     // Iterators are implemented as a queue + index pair. This means
@@ -420,6 +1117,11 @@ public:
     template<typename RB, typename VT>
     struct iterator_base {
         typedef std::random_access_iterator_tag iterator_category;
+        typedef typename std::remove_const<VT>::type value_type;
+        typedef ptrdiff_t difference_type;
+        typedef VT* pointer;
+        typedef VT& reference;
+        typedef segment_base<VT> segment_type;
 
         iterator_base(RB* q, size_t index)
             : q_(q), i_(index) {
@@ -456,6 +1158,9 @@ public:
         iterator_base operator-(size_t i) const {
             return iterator_base(q_, i_ - i);
         }
+        difference_type operator-(const iterator_base& other) const {
+            return i_ - other.i_;
+        }
         iterator_base& operator-=(size_t i) {
             i_ -= i;
             return *this;
@@ -494,18 +1199,28 @@ public:
             return q_ >= other.q_;
         }
 
-        VT& operator*() {
+        VT& operator*() const {
             return (*q_)[i_];
         }
 
-        VT* operator->() {
+        VT* operator->() const {
             return &(*q_)[i_];
         }
 
+        VT& operator[](size_t i) const {
+            return (*q_)[i_ + i];
+        }
+
         operator iterator_base<const inline_deque, const T> const() {
             return iterator_base<const inline_deque, const T>(q_, i_);
         }
 
+        // Store the contiguous storage segments holding the elements
+        // [*this, last) in "out". Return the number of segments.
+        int segments(const iterator_base& last, segment_type out[2]) const {
+            return q_->segments(i_, last.i_, out);
+        }
+
     private:
         friend inline_deque;
 
@@ -559,6 +1274,7 @@ public:
             for (CapacityType i = 0; i < count; ++i) {
                 ptr_.destroy(&slot(ptr_write(i)));
             }
+            ptr_.after_pop(size());
         }
 
         return iterator(this, first.i_);
@@ -572,6 +1288,7 @@ public:
     iterator insert(const_iterator pos, const T& val) {
         iterator it = make_space(pos, 1);
         ptr_.construct(&slot(ptr_read(it.i_)), val);
+        ptr_.after_push(size());
         return it;
     }
 
@@ -581,6 +1298,7 @@ public:
         iterator it = make_space(pos, 1);
         ptr_.construct(&slot(ptr_read(it.i_)),
                        std::forward<Args>(args)...);
+        ptr_.after_push(size());
         return it;
     }
 
@@ -588,50 +1306,209 @@ public:
     iterator insert(const_iterator pos, T&& val) {
         iterator it = make_space(pos, 1);
         ptr_.construct(&slot(ptr_read(it.i_)), std::move(val));
+        ptr_.after_push(size());
         return it;
     }
 
     // Fill a range
-    iterator insert(const_iterator pos, CapacityType n,
+    iterator insert(const_iterator pos, size_t n,
                     const T& val) {
         iterator it = make_space(pos, n);
-        for (CapacityType i = 0; i < n; ++i) {
+        for (size_t i = 0; i < n; ++i) {
             ptr_.construct(&slot(ptr_read(it.i_ + i)), val);
         }
+        ptr_.after_push(size());
         return it;
     }
 
+    // Contiguous storage
+
+    int segments(segment out[2]) {
+        return segments(0, size(), out);
+    }
+
+    int segments(const_segment out[2]) const {
+        return segments(0, size(), out);
+    }
+
+    int segments(size_t first, size_t last, segment out[2]) {
+        return segments_impl(storage(), first, last, out);
+    }
+
+    int segments(size_t first, size_t last, const_segment out[2]) const {
+        return segments_impl<const T>(storage(), first, last, out);
+    }
+
+    segment make_contiguous() {
+        T* array = storage();
+        CapacityType current_size = size();
+        CapacityType start = ptr_read() & (capacity_ - 1);
+        if (current_size == 0 || start + current_size <= capacity_) {
+            segment ret = { array + (current_size ? start : 0),
+                            current_size };
+            return ret;
+        }
+
+        // The storage looks like [B free A], where A is the part from
+        // the read pointer to the end of storage and B the part that
+        // wrapped around.
+        CapacityType a = capacity_ - start;
+        CapacityType b = current_size - a;
+        CapacityType free = capacity_ - current_size;
+        CapacityType new_start;
+        if (free >= b) {
+            // Slide A down by |B|, then move B to the end.
+            relocate_range(array + start - b, array + start, a);
+            relocate_range(array + capacity_ - b, array, b);
+            new_start = start - b;
+        } else if (free >= a) {
+            // Slide B up by |A|, then move A to the start.
+            relocate_range(array + a, array, b);
+            relocate_range(array, array + start, a);
+            new_start = 0;
+        } else {
+            // Not enough space for a simple solution. Slide A down to
+            // close the gap, which gives [B A free], and then rotate
+            // to [A B free].
+            relocate_range(array + b, array + start, a);
+            std::rotate(array, array + b, array + current_size);
+            new_start = 0;
+        }
+
+        ptr_.read_ = new_start;
+        ptr_.write_ = new_start + current_size;
+        segment ret = { array + new_start, current_size };
+        return ret;
+    }
+
+    int reserve_back(size_t n, segment out[2]) {
+        if (capacity_ - size() < n) {
+            if (n > max_size() - size()) {
+                inline_deque_detail::throw_length_error();
+            }
+            reserve(size() + n);
+        }
+        return segments_impl(storage(), size(), size() + n, out);
+    }
+
+    void commit_back(size_t k) {
+        if (k > capacity_ - size()) {
+            inline_deque_detail::throw_out_of_range();
+        }
+        ptr_.write_ += k;
+        ptr_.after_push(size());
+    }
+
+    int peek_front(size_t n, segment out[2]) {
+        return segments(0, std::min<size_t>(n, size()), out);
+    }
+
+    int peek_front(size_t n, const_segment out[2]) const {
+        return segments(0, std::min<size_t>(n, size()), out);
+    }
+
+    void consume_front(size_t k) {
+        if (k > size()) {
+            inline_deque_detail::throw_out_of_range();
+        }
+        destroy_front(k, std::is_trivially_destructible<T>());
+        ptr_.read_ += k;
+        shrink();
+        ptr_.after_pop(size());
+    }
+
     // Misc
 
     Allocator get_allocator() const {
         return ptr_;
     }
 
+    OverflowPolicy& overflow_policy() {
+        return ptr_;
+    }
+
+    const OverflowPolicy& overflow_policy() const {
+        return ptr_;
+    }
+
 protected:
-    bool full() {
+    bool full() const {
         return size() == capacity();
     }
 
-    void overflow() {
-        CapacityType new_capacity = capacity_ * 2;
-        if (new_capacity == 0) {
-            if (capacity_ == 0) {
-                new_capacity = 1;
-            } else {
-                throw std::length_error("max_size exceeded");
-            }
+    // Called when adding an element to a full queue. Make space for
+    // the element as the overflow policy says, and add it unless the
+    // policy rejects it. With overwrite_oldest the new element is
+    // constructed before the oldest one is destroyed, since the
+    // arguments might refer to it.
+    template<typename... Args>
+    INLINE_DEQUE_COLD bool overflow_emplace(bool at_back, Args&&... args) {
+        inline_deque_overflow action = ptr_.on_overflow(capacity_);
+        if (action == inline_deque_overflow::overwrite_oldest) {
+            T tmp(std::forward<Args>(args)...);
+            drop_oldest(at_back);
+            return at_back ? emplace_back(std::move(tmp)) :
+                emplace_front(std::move(tmp));
+        }
+        if (!overflow(action)) {
+            return false;
+        }
+        return at_back ? emplace_back(std::forward<Args>(args)...) :
+            emplace_front(std::forward<Args>(args)...);
+    }
+
+    // Handle the other overflow actions, returning true if the
+    // element should be added.
+    INLINE_DEQUE_COLD bool overflow(inline_deque_overflow action) {
+        switch (action) {
+        case inline_deque_overflow::grow:
+            resize(inline_deque_detail::grow_capacity<CapacityType>(
+                       capacity_, size(), 1));
+            return true;
+        case inline_deque_overflow::drop_newest:
+            ptr_.on_drop();
+            return false;
+        case inline_deque_overflow::abort:
+            std::abort();
+        case inline_deque_overflow::reject:
+        case inline_deque_overflow::overwrite_oldest:
+            break;
         }
-        resize(new_capacity);
+        return false;
+    }
+
+    // Remove the element at the other end of the queue from where
+    // one is being added.
+    void drop_oldest(bool at_back) {
+        if (at_back) {
+            ptr_.destroy(&slot(ptr_read()));
+            ptr_.read_++;
+        } else {
+            ptr_.write_--;
+            ptr_.destroy(&slot(ptr_write()));
+        }
+        ptr_.on_drop();
     }
 
     void shrink() {
-        if (ptr_read() == 0 && capacity_ > size() * 2) {
+        if (ptr_read() == 0 && capacity_ - size() > size() &&
+            ptr_.allow_shrink()) {
             shrink_to_fit();
         }
     }
 
+    // True if the elements are stored inline. Always false without
+    // inline storage, so that the compiler can remove the inline
+    // code paths.
     bool use_inline() const {
-        return capacity_ == InlineCapacity;
+        return InlineCapacity != 0 && capacity_ == InlineCapacity;
+    }
+
+    // True if the storage is a heap allocation. Differs from
+    // !use_inline() only for queues without inline storage, which
+    // don't allocate until the first element is added.
+    bool heap_allocated() const {
+        return capacity_ != InlineCapacity;
     }
 
     void resize(CapacityType new_capacity) {
@@ -642,17 +1519,121 @@ protected:
             return;
         }
 
-        T* old_e = (use_inline() ? (T*) &e_.inline_e_ : e_.e_);
+        typedef std::integral_constant<
+            bool,
+            std::is_trivially_copyable<T>::value &&
+            inline_deque_detail::has_reallocate<Allocator, T>::value>
+            realloc_ok;
+        if (new_capacity > capacity_ && heap_allocated()) {
+            if (grow_in_place(new_capacity, realloc_ok())) {
+                return;
+            }
+        } else if (new_capacity < capacity_ &&
+                   new_capacity > InlineCapacity) {
+            if (shrink_in_place(new_capacity, realloc_ok())) {
+                return;
+            }
+        }
+
         T* new_e;
 
         if (new_capacity == InlineCapacity) {
-            new_e = (T*) &e_.inline_e_;
+            new_e = e_.inline_array();
         } else {
             new_e = ptr_.allocate(new_capacity);
         }
 
+        // The heap and inline cases are kept apart, so that the
+        // compiler can see that deallocate() is never called on the
+        // inline storage.
         CapacityType current_size = size();
-        for (CapacityType i = 0; i < current_size; ++i) {
+        if (heap_allocated()) {
+            T* old_e = e_.e_;
+            relocate(new_e, old_e, current_size,
+                     std::is_trivially_copyable<T>());
+            ptr_.deallocate(old_e, capacity_);
+        } else {
+            relocate(new_e, storage(), current_size,
+                     std::is_trivially_copyable<T>());
+        }
+
+        capacity_ = new_capacity;
+
+        if (!use_inline()) {
+            e_.e_ = new_e;
+        }
+
+        ptr_.read_ = 0;
+        ptr_.write_ = current_size;
+    }
+
+    // Grow heap storage by reallocating it, rather than moving all
+    // elements to a new allocation. Return false if not supported
+    // for this element type and allocator.
+    bool grow_in_place(CapacityType new_capacity,
+                       std::false_type supported) {
+        return false;
+    }
+
+    // (A member template, so that explicit instantiations of the
+    // class don't instantiate it for allocators without reallocate().)
+    template<typename Supported>
+    bool grow_in_place(CapacityType new_capacity, Supported supported,
+                       typename std::enable_if<Supported::value>::type* = 0) {
+        CapacityType current_size = size();
+        e_.e_ = ptr_.reallocate(e_.e_, capacity_, new_capacity);
+        CapacityType start = inline_deque_detail::unwrap_grown(
+            e_.e_, sizeof(T), capacity_, new_capacity, ptr_read(),
+            current_size);
+        capacity_ = new_capacity;
+        ptr_.read_ = start;
+        ptr_.write_ = start + current_size;
+        return true;
+    }
+
+    // Shrink heap storage to a smaller heap allocation by compacting
+    // the elements to its start and reallocating it. Return false if
+    // not supported for this element type and allocator.
+    bool shrink_in_place(CapacityType new_capacity,
+                         std::false_type supported) {
+        return false;
+    }
+
+    template<typename Supported>
+    bool shrink_in_place(CapacityType new_capacity, Supported supported,
+                         typename std::enable_if<Supported::value>::type* = 0) {
+        CapacityType current_size = size();
+        CapacityType start = inline_deque_detail::compact_shrunk(
+            e_.e_, sizeof(T), capacity_, new_capacity, ptr_read(),
+            current_size);
+        // The compaction only wrote to free slots, so if the
+        // reallocation fails the queue is still intact, and just
+        // keeps its current storage.
+        try {
+            e_.e_ = ptr_.reallocate(e_.e_, capacity_, new_capacity);
+        } catch (const std::bad_alloc&) {
+            return true;
+        }
+        capacity_ = new_capacity;
+        ptr_.read_ = start;
+        ptr_.write_ = start + current_size;
+        return true;
+    }
+
+    void destroy_front(size_t count, std::true_type trivially_destructible) {
+    }
+
+    void destroy_front(size_t count, std::false_type trivially_destructible) {
+        for (size_t i = 0; i < count; ++i) {
+            ptr_.destroy(&slot(ptr_read(i)));
+        }
+    }
+
+    // Move "count" elements starting from the read pointer in old_e
+    // to the start of new_e.
+    void relocate(T* new_e, T* old_e, CapacityType count,
+                  std::false_type trivially_copyable) {
+        for (CapacityType i = 0; i < count; ++i) {
             // Note: we have to use slot_impl() with a precomputed array
             // pointer instead of slot() here. The reason is that if the
             // new array is inline-allocated, writes to it will clobber
@@ -661,19 +1642,40 @@ protected:
                            std::move(slot_impl(ptr_read(i), old_e)));
             ptr_.destroy(&slot_impl(ptr_read(i), old_e));
         }
+    }
 
-        if (!use_inline()) {
-            ptr_.deallocate(old_e, capacity_);
-        }
+    void relocate(T* new_e, T* old_e, CapacityType count,
+                  std::true_type trivially_copyable) {
+        inline_deque_detail::relocate_trivial(new_e, old_e, sizeof(T),
+                                              capacity_, ptr_read(),
+                                              count);
+    }
 
-        capacity_ = new_capacity;
+    // Move "count" elements from src to dst within the same storage.
+    // The ranges may overlap, and dst must be uninitialized where it
+    // does not overlap src.
+    void relocate_range(T* dst, T* src, size_t count) {
+        relocate_range(dst, src, count, std::is_trivially_copyable<T>());
+    }
 
-        if (!use_inline()) {
-            e_.e_ = new_e;
+    void relocate_range(T* dst, T* src, size_t count,
+                        std::false_type trivially_copyable) {
+        if (dst < src) {
+            for (size_t i = 0; i < count; ++i) {
+                ptr_.construct(dst + i, std::move(src[i]));
+                ptr_.destroy(src + i);
+            }
+        } else if (dst > src) {
+            for (size_t i = count; i > 0; --i) {
+                ptr_.construct(dst + i - 1, std::move(src[i - 1]));
+                ptr_.destroy(src + i - 1);
+            }
         }
+    }
 
-        ptr_.read_ = 0;
-        ptr_.write_ = current_size;
+    void relocate_range(T* dst, T* src, size_t count,
+                        std::true_type trivially_copyable) {
+        memmove(static_cast<void*>(dst), src, count * sizeof(T));
     }
 
     void move_from(inline_deque& other) {
@@ -691,13 +1693,16 @@ protected:
         }
         other.capacity_ = InlineCapacity;
         other.ptr_.read_ = other.ptr_.write_;
+        other.ptr_.on_moved_from();
     }
 
     void clone_from(const inline_deque& other) {
         ptr_ = other.ptr_;
         capacity_ = other.capacity_;
-        if (!use_inline()) {
+        if (heap_allocated()) {
             e_.e_ = ptr_.allocate(capacity_);
+        } else if (!use_inline()) {
+            e_.e_ = NULL;
         }
         for (size_t i = 0; i < size(); ++i) {
             ptr_.construct(&slot(ptr_read(i)),
@@ -705,23 +1710,41 @@ protected:
         }
     }
 
+    // Destroy all elements. Unlike clear(), doesn't call the
+    // after_pop() hook, since the queue is going away or being
+    // replaced.
+    void destroy_all() {
+        // Don't use pop_front(), since that might decide to shrink
+        // the queue, moving elements that are about to be destroyed.
+        while (!empty()) {
+            ptr_.destroy(&slot(ptr_read()));
+            ptr_.read_++;
+        }
+    }
+
     void reset() {
-        clear();
-        if (!use_inline()) {
+        destroy_all();
+        if (heap_allocated()) {
             ptr_.deallocate(e_.e_, capacity_);
         }
     }
 
     void require_nonempty() const {
         if (empty()) {
-            throw std::out_of_range("empty queue");
+            inline_deque_detail::throw_empty();
         }
     }
 
-    iterator make_space(const_iterator pos, CapacityType count) {
-        if (!count) {
+    iterator make_space(const_iterator pos, size_t n) {
+        if (!n) {
             return iterator(this, pos.i_);
         }
+        // Check before narrowing to CapacityType, so that an
+        // oversized count can't wrap around to a small one.
+        if (n > max_size() - size()) {
+            inline_deque_detail::throw_length_error();
+        }
+        CapacityType count = n;
 
         // It might be a good idea to special-case making space at
         // start / end here. But right now we don't.
@@ -730,17 +1753,12 @@ protected:
         CapacityType last = size() - 1;
 
         // Make sure we have enough capacity
-        CapacityType needed_capacity = size() + count;
-        if (needed_capacity > capacity_) {
-            CapacityType new_capacity = std::max(static_cast<CapacityType>(1),
-                                                 capacity_) * 2;
-            while (new_capacity < needed_capacity) {
-                new_capacity *= 2;
-                if (new_capacity == 0) {
-                    throw std::length_error("max_size exceeded");
-                }
+        if (count > capacity_ - size()) {
+            if (ptr_.on_overflow(capacity_) != inline_deque_overflow::grow) {
+                inline_deque_detail::throw_length_error();
             }
-            resize(new_capacity);
+            resize(inline_deque_detail::grow_capacity<CapacityType>(
+                       capacity_, size(), count));
         }
 
         // Move write pointer forward.
@@ -766,9 +1784,36 @@ protected:
         return (ptr_.write_ + offset);
     }
 
+    T* storage() const {
+        if (use_inline()) {
+            return e_.inline_array();
+        } else {
+            return e_.e_;
+        }
+    }
+
+    template<typename VT>
+    int segments_impl(VT* array, size_t first, size_t last,
+                      segment_base<VT>* out) const {
+        if (first >= last) {
+            return 0;
+        }
+        size_t start = ptr_read(first) & (capacity_ - 1);
+        size_t count = last - first;
+        size_t head = std::min<size_t>(count, capacity_ - start);
+        out[0].data = array + start;
+        out[0].size = head;
+        if (head == count) {
+            return 1;
+        }
+        out[1].data = array;
+        out[1].size = count - head;
+        return 2;
+    }
+
     T& slot(CapacityType index) {
         if (use_inline()) {
-            return slot_impl(index, (T*) e_.inline_e_);
+            return slot_impl(index, e_.inline_array());
         } else {
             return slot_impl(index, e_.e_);
         }
@@ -776,7 +1821,7 @@ protected:
 
     const T& slot(CapacityType index) const {
         if (use_inline()) {
-            return slot_impl(index, (T*) e_.inline_e_);
+            return slot_impl(index, e_.inline_array());
         } else {
             return slot_impl(index, e_.e_);
         }
@@ -792,33 +1837,11 @@ protected:
         return array[actual_index];
     }
 
-    union {
-        T* e_;
-        uint8_t inline_e_[sizeof(T) * InlineCapacity];
-    } e_;
+    inline_deque_detail::storage<T, InlineCapacity> e_;
     CapacityType capacity_;
 
-    // A dummy struct just used for empty base class optimization.
-    struct ptrs : Allocator {
-        ptrs(const Allocator& alloc) : Allocator(alloc) {
-        }
-
-        ptrs(const struct ptrs& other)
-            : Allocator(other),
-              read_(other.read_),
-              write_(other.write_) {
-        }
-
-        struct ptrs operator=(const struct ptrs& other) {
-            Allocator::operator=(other);
-            read_ = other.read_;
-            write_ = other.write_;
-            return *this;
-        }
-
-        CapacityType read_ = 0;
-        CapacityType write_ = 0;
-    } ptr_;
+    inline_deque_detail::ring_ptrs<Allocator, CapacityType,
+                                   OverflowPolicy> ptr_;
 };
 
 #endif // INLINE_DEQUE_H
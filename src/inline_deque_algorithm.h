@@ -0,0 +1,281 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+//
+// Segmented versions of some standard algorithms. When given
+// inline_deque iterators, these run a plain pointer loop over each
+// contiguous segment of the queue's storage instead of going through
+// the iterators (which need to compute the storage location of every
+// element separately). Other iterators are passed through to the
+// standard algorithm, so these can be used as drop-in replacements.
+//
+// All functions are in the "segmented" namespace, and have the same
+// signatures and semantics as their std counterparts:
+//
+// * Fun for_each(InputIt first, InputIt last, Fun f)
+// * InputIt find_if(InputIt first, InputIt last, Pred pred)
+// * InputIt find(InputIt first, InputIt last, const T& value)
+// * T accumulate(InputIt first, InputIt last, T init)
+// * T accumulate(InputIt first, InputIt last, T init, BinaryOp op)
+// * OutputIt copy(InputIt first, InputIt last, OutputIt out)
+// * OutputIt transform(InputIt first, InputIt last, OutputIt out, UnaryOp op)
+// * bool equal(InputIt1 first1, InputIt1 last1, InputIt2 first2)
+//
+// For copy(), transform() and equal() the output / second input
+// iterator is also handled segment by segment if it is an
+// inline_deque iterator.
+//
+// Whether an iterator is segmented is determined by
+// segmented::is_segmented<It>, which is true for any iterator type
+// that defines a segment_type and a segments() member (see
+// inline_deque.h).
+
+#ifndef INLINE_DEQUE_ALGORITHM_H
+#define INLINE_DEQUE_ALGORITHM_H
+
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+
+#include "inline_deque.h"
+
+namespace segmented {
+
+namespace detail {
+
+template<typename T>
+struct void_type {
+    typedef void type;
+};
+
+}  // namespace detail
+
+template<typename It, typename = void>
+struct is_segmented : std::false_type {
+};
+
+template<typename It>
+struct is_segmented<It, typename detail::void_type<
+                            typename It::segment_type>::type>
+    : std::true_type {
+};
+
+namespace detail {
+
+// Call fun(p, n, &out) for each contiguous chunk of n elements
+// starting at p in the range [first, last). out is the position in
+// the output corresponding to p: a pointer if OutIt is segmented,
+// otherwise an OutIt. fun must advance out past the chunk, and
+// return false to stop the iteration early. On return, *out has
+// been advanced past all the visited chunks.
+
+template<typename InputIt, typename OutIt, typename Fun>
+bool for_each_chunk(typename InputIt::pointer p, size_t n,
+                    OutIt* out, Fun& fun, std::false_type) {
+    return fun(p, n, out);
+}
+
+template<typename InputIt, typename OutIt, typename Fun>
+bool for_each_chunk(typename InputIt::pointer p, size_t n,
+                    OutIt* out, Fun& fun, std::true_type) {
+    typename OutIt::segment_type out_seg[2];
+    int count = out->segments(*out + n, out_seg);
+    for (int i = 0; i < count; ++i) {
+        auto chunk_out = out_seg[i].data;
+        if (!fun(p, out_seg[i].size, &chunk_out)) {
+            return false;
+        }
+        p += out_seg[i].size;
+    }
+    *out = *out + n;
+    return true;
+}
+
+template<typename InputIt, typename OutIt, typename Fun>
+void for_each_chunk(InputIt first, InputIt last, OutIt* out, Fun fun) {
+    typename InputIt::segment_type seg[2];
+    int count = first.segments(last, seg);
+    for (int i = 0; i < count; ++i) {
+        if (!for_each_chunk<InputIt>(seg[i].data, seg[i].size, out, fun,
+                                     is_segmented<OutIt>())) {
+            return;
+        }
+    }
+}
+
+struct copy_chunk {
+    template<typename P, typename O>
+    bool operator()(P p, size_t n, O* out) const {
+        *out = std::copy(p, p + n, *out);
+        return true;
+    }
+};
+
+template<typename UnaryOp>
+struct transform_chunk {
+    template<typename P, typename O>
+    bool operator()(P p, size_t n, O* out) const {
+        *out = std::transform(p, p + n, *out, *op);
+        return true;
+    }
+
+    UnaryOp* op;
+};
+
+struct equal_chunk {
+    template<typename P, typename O>
+    bool operator()(P p, size_t n, O* out) const {
+        auto mismatch = std::mismatch(p, p + n, *out);
+        *out = mismatch.second;
+        *equal = mismatch.first == p + n;
+        return *equal;
+    }
+
+    bool* equal;
+};
+
+template<typename InputIt, typename Fun>
+Fun for_each(InputIt first, InputIt last, Fun f, std::true_type) {
+    typename InputIt::segment_type seg[2];
+    int count = first.segments(last, seg);
+    for (int i = 0; i < count; ++i) {
+        for (auto& e : seg[i]) {
+            f(e);
+        }
+    }
+    return f;
+}
+
+template<typename InputIt, typename Fun>
+Fun for_each(InputIt first, InputIt last, Fun f, std::false_type) {
+    return std::for_each(first, last, f);
+}
+
+template<typename InputIt, typename Pred>
+InputIt find_if(InputIt first, InputIt last, Pred pred, std::true_type) {
+    typename InputIt::segment_type seg[2];
+    int count = first.segments(last, seg);
+    size_t offset = 0;
+    for (int i = 0; i < count; ++i) {
+        auto it = std::find_if(seg[i].begin(), seg[i].end(), pred);
+        if (it != seg[i].end()) {
+            return first + (offset + (it - seg[i].begin()));
+        }
+        offset += seg[i].size;
+    }
+    return last;
+}
+
+template<typename InputIt, typename Pred>
+InputIt find_if(InputIt first, InputIt last, Pred pred, std::false_type) {
+    return std::find_if(first, last, pred);
+}
+
+template<typename InputIt, typename T, typename BinaryOp>
+T accumulate(InputIt first, InputIt last, T init, BinaryOp op,
+             std::true_type) {
+    typename InputIt::segment_type seg[2];
+    int count = first.segments(last, seg);
+    for (int i = 0; i < count; ++i) {
+        init = std::accumulate(seg[i].begin(), seg[i].end(), init, op);
+    }
+    return init;
+}
+
+template<typename InputIt, typename T, typename BinaryOp>
+T accumulate(InputIt first, InputIt last, T init, BinaryOp op,
+             std::false_type) {
+    return std::accumulate(first, last, init, op);
+}
+
+template<typename InputIt, typename OutputIt>
+OutputIt copy(InputIt first, InputIt last, OutputIt out, std::true_type) {
+    for_each_chunk(first, last, &out, copy_chunk());
+    return out;
+}
+
+template<typename InputIt, typename OutputIt>
+OutputIt copy(InputIt first, InputIt last, OutputIt out, std::false_type) {
+    return std::copy(first, last, out);
+}
+
+template<typename InputIt, typename OutputIt, typename UnaryOp>
+OutputIt transform(InputIt first, InputIt last, OutputIt out, UnaryOp op,
+                   std::true_type) {
+    for_each_chunk(first, last, &out, transform_chunk<UnaryOp> { &op });
+    return out;
+}
+
+template<typename InputIt, typename OutputIt, typename UnaryOp>
+OutputIt transform(InputIt first, InputIt last, OutputIt out, UnaryOp op,
+                   std::false_type) {
+    return std::transform(first, last, out, op);
+}
+
+template<typename InputIt1, typename InputIt2>
+bool equal(InputIt1 first1, InputIt1 last1, InputIt2 first2,
+           std::true_type) {
+    bool equal = true;
+    for_each_chunk(first1, last1, &first2, equal_chunk { &equal });
+    return equal;
+}
+
+template<typename InputIt1, typename InputIt2>
+bool equal(InputIt1 first1, InputIt1 last1, InputIt2 first2,
+           std::false_type) {
+    return std::equal(first1, last1, first2);
+}
+
+}  // namespace detail
+
+template<typename InputIt, typename Fun>
+Fun for_each(InputIt first, InputIt last, Fun f) {
+    return detail::for_each(first, last, f, is_segmented<InputIt>());
+}
+
+template<typename InputIt, typename Pred>
+InputIt find_if(InputIt first, InputIt last, Pred pred) {
+    return detail::find_if(first, last, pred, is_segmented<InputIt>());
+}
+
+template<typename InputIt, typename T>
+InputIt find(InputIt first, InputIt last, const T& value) {
+    return detail::find_if(first, last,
+                           [&value](const typename std::iterator_traits<
+                                       InputIt>::value_type& e) {
+                               return e == value;
+                           },
+                           is_segmented<InputIt>());
+}
+
+template<typename InputIt, typename T>
+T accumulate(InputIt first, InputIt last, T init) {
+    return detail::accumulate(first, last, init, std::plus<T>(),
+                              is_segmented<InputIt>());
+}
+
+template<typename InputIt, typename T, typename BinaryOp>
+T accumulate(InputIt first, InputIt last, T init, BinaryOp op) {
+    return detail::accumulate(first, last, init, op,
+                              is_segmented<InputIt>());
+}
+
+template<typename InputIt, typename OutputIt>
+OutputIt copy(InputIt first, InputIt last, OutputIt out) {
+    return detail::copy(first, last, out, is_segmented<InputIt>());
+}
+
+template<typename InputIt, typename OutputIt, typename UnaryOp>
+OutputIt transform(InputIt first, InputIt last, OutputIt out, UnaryOp op) {
+    return detail::transform(first, last, out, op, is_segmented<InputIt>());
+}
+
+template<typename InputIt1, typename InputIt2>
+bool equal(InputIt1 first1, InputIt1 last1, InputIt2 first2) {
+    return detail::equal(first1, last1, first2, is_segmented<InputIt1>());
+}
+
+}  // namespace segmented
+
+#endif // INLINE_DEQUE_ALGORITHM_H
@@ -0,0 +1,400 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+//
+// Allocators for use with inline_deque.
+//
+// In addition to the standard allocator interface, an allocator may
+// provide a member function:
+//
+//   T* reallocate(T* p, size_t old_n, size_t new_n)
+//
+// which resizes the allocation "p" of "old_n" elements to "new_n"
+// elements, preserving the contents of the first min(old_n, new_n)
+// elements, and returns the (possibly moved) allocation. Raises
+// std::bad_alloc on failure, in which case "p" remains valid. If
+// reallocating to a smaller size fails, the queue keeps its current
+// storage.
+//
+// When the allocator has reallocate() and the elements are trivially
+// copyable, inline_deque grows a heap allocated queue in place: the
+// storage is reallocated, and only the shorter of the two segments
+// of a wrapped queue is moved to its new position. For large queues
+// this avoids most of the copying, and when the allocator can extend
+// the allocation or remap its pages, the copying of the allocation
+// itself. Likewise a heap allocated queue is shrunk in place: the
+// elements are compacted into the start of the storage, moving at
+// most one segment, and the storage is then reallocated to the
+// smaller size, which for mmap()ed storage just unmaps the rest.
+//
+// * realloc_allocator<T>
+//   An allocator using malloc(), realloc() and free(). Large
+//   allocations from glibc are mmap()ed, and reallocated with
+//   mremap() without copying any data, and shrunk in place.
+// * hugepage_allocator<T, Threshold, UseHugeTLB>
+//   An allocator placing allocations of at least Threshold bytes
+//   (default 2MB) on huge pages, to reduce TLB misses when scanning
+//   large queues. Such allocations are rounded up to a multiple of
+//   2MB, mapped with mmap() at a 2MB aligned address, and marked with
+//   madvise(MADV_HUGEPAGE) for transparent huge pages. With
+//   UseHugeTLB, they're first mapped from the explicitly reserved
+//   huge page pool (MAP_HUGETLB), falling back to transparent huge
+//   pages if the pool is empty. Smaller allocations use malloc().
+//   Huge page allocations are shrunk in place by unmapping their
+//   tail; growing them, or shrinking them below Threshold, copies
+//   them to a new allocation.
+//   Since the queue capacities are powers of two, large buffers are
+//   a whole number of huge pages.
+// * prefault_allocator<T, Lock, Threshold>
+//   An allocator that faults in all pages of an allocation when it's
+//   made, so that the first write to each page doesn't take a page
+//   fault later on. Allocations of at least Threshold bytes (default
+//   64kB) are mapped with mmap(MAP_POPULATE), and with Lock also
+//   locked into memory with mlock(). Locking is best effort: if it
+//   fails (e.g. due to RLIMIT_MEMLOCK), the pages are just faulted
+//   in. Smaller allocations use malloc(), and are touched but never
+//   locked.
+
+#ifndef INLINE_DEQUE_ALLOCATOR_H
+#define INLINE_DEQUE_ALLOCATOR_H
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+
+template<typename T>
+class realloc_allocator {
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template<typename U>
+    struct rebind {
+        typedef realloc_allocator<U> other;
+    };
+
+    realloc_allocator() {
+    }
+
+    template<typename U>
+    realloc_allocator(const realloc_allocator<U>&) {
+    }
+
+    T* allocate(size_t n) {
+        void* p = malloc(n * sizeof(T));
+        if (!p && n) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, size_t) {
+        free(p);
+    }
+
+    T* reallocate(T* p, size_t old_n, size_t new_n) {
+        void* new_p = realloc(p, new_n * sizeof(T));
+        if (!new_p && new_n) {
+            if (new_n <= old_n) {
+                // The old allocation is still valid, and big enough.
+                return p;
+            }
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(new_p);
+    }
+
+    template<typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        new (p) U(std::forward<Args>(args)...);
+    }
+
+    template<typename U>
+    void destroy(U* p) {
+        p->~U();
+    }
+
+    size_t max_size() const {
+        return size_t(-1) / sizeof(T);
+    }
+};
+
+template<typename T, typename U>
+bool operator==(const realloc_allocator<T>&, const realloc_allocator<U>&) {
+    return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const realloc_allocator<T>&, const realloc_allocator<U>&) {
+    return false;
+}
+
+template<typename T,
+         size_t Threshold = 2 * 1024 * 1024,
+         bool UseHugeTLB = false>
+class hugepage_allocator {
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    static const size_t kHugePageSize = 2 * 1024 * 1024;
+
+    template<typename U>
+    struct rebind {
+        typedef hugepage_allocator<U, Threshold, UseHugeTLB> other;
+    };
+
+    hugepage_allocator() {
+    }
+
+    template<typename U>
+    hugepage_allocator(const hugepage_allocator<U, Threshold,
+                                                UseHugeTLB>&) {
+    }
+
+    T* allocate(size_t n) {
+        size_t bytes = n * sizeof(T);
+        if (!use_huge_pages(bytes)) {
+            void* p = malloc(bytes);
+            if (!p && n) {
+                throw std::bad_alloc();
+            }
+            return static_cast<T*>(p);
+        }
+        return static_cast<T*>(map_huge(mapping_size(bytes)));
+    }
+
+    void deallocate(T* p, size_t n) {
+        size_t bytes = n * sizeof(T);
+        if (!use_huge_pages(bytes)) {
+            free(p);
+        } else {
+            munmap(p, mapping_size(bytes));
+        }
+    }
+
+    T* reallocate(T* p, size_t old_n, size_t new_n) {
+        size_t old_bytes = old_n * sizeof(T);
+        size_t new_bytes = new_n * sizeof(T);
+        if (!use_huge_pages(old_bytes) && !use_huge_pages(new_bytes)) {
+            void* new_p = realloc(p, new_bytes);
+            if (!new_p && new_n) {
+                if (new_n <= old_n) {
+                    return p;
+                }
+                throw std::bad_alloc();
+            }
+            return static_cast<T*>(new_p);
+        }
+        if (use_huge_pages(old_bytes) && use_huge_pages(new_bytes) &&
+            new_bytes <= old_bytes) {
+            size_t keep = mapping_size(new_bytes);
+            size_t old_size = mapping_size(old_bytes);
+            if (keep < old_size) {
+                munmap(reinterpret_cast<char*>(p) + keep, old_size - keep);
+            }
+            return p;
+        }
+        T* new_p = allocate(new_n);
+        memcpy(static_cast<void*>(new_p), p,
+               std::min(old_bytes, new_bytes));
+        deallocate(p, old_n);
+        return new_p;
+    }
+
+    template<typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        new (p) U(std::forward<Args>(args)...);
+    }
+
+    template<typename U>
+    void destroy(U* p) {
+        p->~U();
+    }
+
+    size_t max_size() const {
+        return size_t(-1) / sizeof(T);
+    }
+
+    // True if an allocation of "bytes" bytes will be placed on huge
+    // pages.
+    static bool use_huge_pages(size_t bytes) {
+        return bytes >= Threshold;
+    }
+
+private:
+    static size_t mapping_size(size_t bytes) {
+        return (bytes + kHugePageSize - 1) & ~(kHugePageSize - 1);
+    }
+
+    static void* map_huge(size_t size) {
+#ifdef MAP_HUGETLB
+        if (UseHugeTLB) {
+            void* p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                           -1, 0);
+            if (p != MAP_FAILED) {
+                return p;
+            }
+        }
+#endif
+        // Over-allocate by a huge page, and unmap the unaligned
+        // parts at both ends.
+        size_t padded = size + kHugePageSize;
+        void* raw = mmap(NULL, padded, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+        uintptr_t aligned = (start + kHugePageSize - 1) &
+            ~uintptr_t(kHugePageSize - 1);
+        if (aligned != start) {
+            munmap(raw, aligned - start);
+        }
+        size_t tail = start + padded - (aligned + size);
+        if (tail) {
+            munmap(reinterpret_cast<void*>(aligned + size), tail);
+        }
+        void* p = reinterpret_cast<void*>(aligned);
+#ifdef MADV_HUGEPAGE
+        madvise(p, size, MADV_HUGEPAGE);
+#endif
+        return p;
+    }
+};
+
+template<typename T, typename U, size_t Threshold, bool UseHugeTLB>
+bool operator==(const hugepage_allocator<T, Threshold, UseHugeTLB>&,
+                const hugepage_allocator<U, Threshold, UseHugeTLB>&) {
+    return true;
+}
+
+template<typename T, typename U, size_t Threshold, bool UseHugeTLB>
+bool operator!=(const hugepage_allocator<T, Threshold, UseHugeTLB>&,
+                const hugepage_allocator<U, Threshold, UseHugeTLB>&) {
+    return false;
+}
+
+template<typename T,
+         bool Lock = false,
+         size_t Threshold = 64 * 1024>
+class prefault_allocator {
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    static const size_t kPageSize = 4096;
+
+    template<typename U>
+    struct rebind {
+        typedef prefault_allocator<U, Lock, Threshold> other;
+    };
+
+    prefault_allocator() {
+    }
+
+    template<typename U>
+    prefault_allocator(const prefault_allocator<U, Lock, Threshold>&) {
+    }
+
+    T* allocate(size_t n) {
+        size_t bytes = n * sizeof(T);
+        if (!use_mmap(bytes)) {
+            void* p = malloc(bytes);
+            if (!p && n) {
+                throw std::bad_alloc();
+            }
+            touch(p, bytes);
+            return static_cast<T*>(p);
+        }
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_POPULATE
+        flags |= MAP_POPULATE;
+#endif
+        void* p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (p == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+#ifndef MAP_POPULATE
+        touch(p, bytes);
+#endif
+        if (Lock) {
+            mlock(p, bytes);
+        }
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, size_t n) {
+        size_t bytes = n * sizeof(T);
+        if (!use_mmap(bytes)) {
+            free(p);
+        } else {
+            munmap(p, bytes);
+        }
+    }
+
+    template<typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        new (p) U(std::forward<Args>(args)...);
+    }
+
+    template<typename U>
+    void destroy(U* p) {
+        p->~U();
+    }
+
+    size_t max_size() const {
+        return size_t(-1) / sizeof(T);
+    }
+
+    // True if an allocation of "bytes" bytes will be mapped with
+    // mmap() (and locked, with Lock).
+    static bool use_mmap(size_t bytes) {
+        return bytes >= Threshold;
+    }
+
+private:
+    static void touch(void* p, size_t bytes) {
+        volatile char* c = static_cast<volatile char*>(p);
+        for (size_t i = 0; i < bytes; i += kPageSize) {
+            c[i] = 0;
+        }
+    }
+};
+
+template<typename T, typename U, bool Lock, size_t Threshold>
+bool operator==(const prefault_allocator<T, Lock, Threshold>&,
+                const prefault_allocator<U, Lock, Threshold>&) {
+    return true;
+}
+
+template<typename T, typename U, bool Lock, size_t Threshold>
+bool operator!=(const prefault_allocator<T, Lock, Threshold>&,
+                const prefault_allocator<U, Lock, Threshold>&) {
+    return false;
+}
+
+#endif // INLINE_DEQUE_ALLOCATOR_H
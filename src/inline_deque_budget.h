@@ -0,0 +1,324 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+//
+// A memory budget shared by many queues, and an allocator that
+// charges the allocations of a queue against it.
+//
+// inline_deque_budget tracks the number of bytes allocated by all
+// participating queues, in total and per account. An account is an
+// arbitrary 64 bit number chosen by the user (e.g. a client id); the
+// queues of an account are charged together. Allocation beyond the
+// hard limit fails, and crossing the soft limit triggers a callback.
+// The largest accounts can be listed, e.g. to choose which clients to
+// evict.
+//
+// Only the storage allocated on the heap is charged, i.e. a queue
+// that fits in its inline storage is free. Since queues allocate
+// only when they're resized, none of this is on the fast path of a
+// push or pop. While a queue is being resized both the old and the
+// new storage are charged, unless the allocator can reallocate in
+// place.
+//
+// inline_deque_budget is not thread safe: all queues sharing a budget
+// must be used from the same thread (or the caller must serialize
+// all operations on them).
+//
+// * inline_deque_budget(size_t soft_limit = SIZE_MAX,
+//                       size_t hard_limit = SIZE_MAX)
+//   Construct a budget with the given limits, in bytes. Not copyable.
+// * size_t used() const
+//   Return the number of bytes currently charged to the budget.
+// * size_t used(uint64_t account) const
+//   Return the number of bytes currently charged to the account.
+// * size_t accounts() const
+//   Return the number of accounts with memory charged to them.
+// * std::vector<std::pair<uint64_t, size_t>> largest(size_t k) const
+//   Return the (at most) k accounts with the most memory charged to
+//   them, and their usage, largest first.
+// * size_t soft_limit() const, void set_soft_limit(size_t bytes)
+// * size_t hard_limit() const, void set_hard_limit(size_t bytes)
+//   Get / set the limits. Lowering a limit below the current usage
+//   doesn't free anything or trigger any callbacks.
+// * bool over_soft_limit() const
+//   Return true if the usage is above the soft limit.
+// * void on_soft_limit(callback cb)
+//   Call cb(budget, true) when the usage goes above the soft limit,
+//   and cb(budget, false) when it drops back to the limit or below.
+// * void on_hard_limit(hard_limit_callback cb)
+//   Call cb(budget, bytes) when an allocation of "bytes" bytes would
+//   take the usage above the hard limit. The callback may release
+//   memory, e.g. by clearing other queues; the allocation is retried
+//   once after it returns, and fails with std::bad_alloc if still
+//   over the limit.
+// * void charge(uint64_t account, size_t bytes)
+// * void release(uint64_t account, size_t bytes)
+//   Charge / release memory by hand. Used by budget_allocator.
+//   Releasing more than is charged to the account raises
+//   std::out_of_range, and leaves the budget unchanged.
+//
+// The callbacks are called from within an allocation of a queue. They
+// must not modify that queue.
+//
+// budget_allocator<T, Base = std::allocator<T>> allocates with Base,
+// charging the allocations to an account of a budget:
+//
+// * budget_allocator()
+//   No budget; allocations aren't charged anywhere.
+// * budget_allocator(inline_deque_budget* budget, uint64_t account,
+//                    const Base& base = Base())
+//   Charge allocations to "account" of "budget".
+//
+// Copies of the allocator charge the same account, including the
+// allocator of a queue copied from one using a budget_allocator. If
+// Base has reallocate() (see inline_deque_allocator.h), so does
+// budget_allocator.
+//
+// Example:
+//
+//   inline_deque_budget budget(512 << 20, 1 << 30);
+//   budget.on_soft_limit([](inline_deque_budget& b, bool above) { ... });
+//   typedef budget_allocator<Message> alloc;
+//   inline_deque<Message, 4, uint32_t, alloc> q(4, alloc(&budget, id));
+
+#ifndef INLINE_DEQUE_BUDGET_H
+#define INLINE_DEQUE_BUDGET_H
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class inline_deque_budget {
+public:
+    typedef std::function<void(inline_deque_budget& budget,
+                               bool above)> callback;
+    typedef std::function<void(inline_deque_budget& budget,
+                               size_t bytes)> hard_limit_callback;
+
+    explicit inline_deque_budget(size_t soft_limit = SIZE_MAX,
+                                 size_t hard_limit = SIZE_MAX)
+        : soft_limit_(soft_limit), hard_limit_(hard_limit) {
+    }
+
+    inline_deque_budget(const inline_deque_budget&) = delete;
+    inline_deque_budget& operator=(const inline_deque_budget&) = delete;
+
+    size_t used() const {
+        return used_;
+    }
+
+    size_t used(uint64_t account) const {
+        auto it = accounts_.find(account);
+        return it == accounts_.end() ? 0 : it->second;
+    }
+
+    size_t accounts() const {
+        return accounts_.size();
+    }
+
+    std::vector<std::pair<uint64_t, size_t>> largest(size_t k) const {
+        std::vector<std::pair<uint64_t, size_t>> ret(accounts_.begin(),
+                                                     accounts_.end());
+        k = std::min(k, ret.size());
+        std::partial_sort(ret.begin(), ret.begin() + k, ret.end(),
+                          [](const std::pair<uint64_t, size_t>& a,
+                             const std::pair<uint64_t, size_t>& b) {
+                              return a.second > b.second;
+                          });
+        ret.resize(k);
+        return ret;
+    }
+
+    size_t soft_limit() const {
+        return soft_limit_;
+    }
+
+    void set_soft_limit(size_t bytes) {
+        soft_limit_ = bytes;
+    }
+
+    size_t hard_limit() const {
+        return hard_limit_;
+    }
+
+    void set_hard_limit(size_t bytes) {
+        hard_limit_ = bytes;
+    }
+
+    bool over_soft_limit() const {
+        return used_ > soft_limit_;
+    }
+
+    void on_soft_limit(callback cb) {
+        on_soft_limit_ = cb;
+    }
+
+    void on_hard_limit(hard_limit_callback cb) {
+        on_hard_limit_ = cb;
+    }
+
+    void charge(uint64_t account, size_t bytes) {
+        if (!bytes) {
+            return;
+        }
+        if (over_hard_limit(bytes)) {
+            if (on_hard_limit_) {
+                on_hard_limit_(*this, bytes);
+            }
+            if (over_hard_limit(bytes)) {
+                throw std::bad_alloc();
+            }
+        }
+        used_ += bytes;
+        accounts_[account] += bytes;
+        if (!above_soft_limit_ && over_soft_limit()) {
+            above_soft_limit_ = true;
+            if (on_soft_limit_) {
+                on_soft_limit_(*this, true);
+            }
+        }
+    }
+
+    void release(uint64_t account, size_t bytes) {
+        if (!bytes) {
+            return;
+        }
+        auto it = accounts_.find(account);
+        if (it == accounts_.end() || it->second < bytes) {
+            throw std::out_of_range("released more than was charged");
+        }
+        used_ -= bytes;
+        it->second -= bytes;
+        if (!it->second) {
+            accounts_.erase(it);
+        }
+        if (above_soft_limit_ && !over_soft_limit()) {
+            above_soft_limit_ = false;
+            if (on_soft_limit_) {
+                on_soft_limit_(*this, false);
+            }
+        }
+    }
+
+private:
+    bool over_hard_limit(size_t bytes) const {
+        return bytes > hard_limit_ || used_ > hard_limit_ - bytes;
+    }
+
+    size_t used_ = 0;
+    size_t soft_limit_;
+    size_t hard_limit_;
+    bool above_soft_limit_ = false;
+    std::unordered_map<uint64_t, size_t> accounts_;
+    callback on_soft_limit_;
+    hard_limit_callback on_hard_limit_;
+};
+
+template<typename T, class Base = std::allocator<T>>
+class budget_allocator : public Base {
+public:
+    template<typename U>
+    struct rebind {
+        typedef budget_allocator<
+            U, typename std::allocator_traits<Base>::template
+            rebind_alloc<U>> other;
+    };
+
+    budget_allocator() {
+    }
+
+    budget_allocator(inline_deque_budget* budget, uint64_t account,
+                     const Base& base = Base())
+        : Base(base), budget_(budget), account_(account) {
+    }
+
+    template<typename U, class UBase>
+    budget_allocator(const budget_allocator<U, UBase>& other)
+        : Base(other.base()), budget_(other.budget()),
+          account_(other.account()) {
+    }
+
+    T* allocate(size_t n) {
+        charge(n);
+        try {
+            return Base::allocate(n);
+        } catch (...) {
+            release(n);
+            throw;
+        }
+    }
+
+    void deallocate(T* p, size_t n) {
+        Base::deallocate(p, n);
+        release(n);
+    }
+
+    // Only defined if Base has reallocate().
+    template<class B = Base>
+    auto reallocate(T* p, size_t old_n, size_t new_n)
+        -> decltype(std::declval<B&>().reallocate(p, old_n, new_n)) {
+        if (new_n > old_n) {
+            charge(new_n - old_n);
+            try {
+                p = B::reallocate(p, old_n, new_n);
+            } catch (...) {
+                release(new_n - old_n);
+                throw;
+            }
+        } else {
+            p = B::reallocate(p, old_n, new_n);
+            release(old_n - new_n);
+        }
+        return p;
+    }
+
+    const Base& base() const {
+        return *this;
+    }
+
+    inline_deque_budget* budget() const {
+        return budget_;
+    }
+
+    uint64_t account() const {
+        return account_;
+    }
+
+private:
+    void charge(size_t n) {
+        if (budget_) {
+            budget_->charge(account_, n * sizeof(T));
+        }
+    }
+
+    void release(size_t n) {
+        if (budget_) {
+            budget_->release(account_, n * sizeof(T));
+        }
+    }
+
+    inline_deque_budget* budget_ = NULL;
+    uint64_t account_ = 0;
+};
+
+template<typename T, class TBase, typename U, class UBase>
+bool operator==(const budget_allocator<T, TBase>& a,
+                const budget_allocator<U, UBase>& b) {
+    return a.budget() == b.budget() && a.account() == b.account() &&
+        a.base() == b.base();
+}
+
+template<typename T, class TBase, typename U, class UBase>
+bool operator!=(const budget_allocator<T, TBase>& a,
+                const budget_allocator<U, UBase>& b) {
+    return !(a == b);
+}
+
+#endif // INLINE_DEQUE_BUDGET_H
@@ -0,0 +1,11 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+
+#include "inline_deque_instances.h"
+
+#define INLINE_DEQUE_INSTANCE(T, N)             \
+    template class inline_deque<T, N>;
+
+INLINE_DEQUE_INSTANCES(INLINE_DEQUE_INSTANCE)
@@ -0,0 +1,53 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+//
+// Explicit instantiations of inline_deque for common element types
+// and inline capacities. Including this header instead of
+// inline_deque.h declares those instantiations as extern templates,
+// so that translation units using them don't need to compile the
+// non-inlined member functions, and the linker doesn't need to
+// discard the duplicate copies. The definitions are in the
+// inline_deque_instances library, which must be linked in.
+//
+// Other instantiations work as usual, and are compiled in each
+// translation unit that uses them.
+
+#ifndef INLINE_DEQUE_INSTANCES_H
+#define INLINE_DEQUE_INSTANCES_H
+
+#include <string>
+#include <utility>
+
+#include "inline_deque.h"
+
+// Calls X(T, InlineCapacity) for each of the instantiations in the
+// library. All of them use the default CapacityType and Allocator.
+#define INLINE_DEQUE_INSTANCES_FOR_TYPE(X, T)   \
+    X(T, 1)                                     \
+    X(T, 4)                                     \
+    X(T, 16)
+
+#define INLINE_DEQUE_INSTANCES(X)                                       \
+    INLINE_DEQUE_INSTANCES_FOR_TYPE(X, int32_t)                         \
+    INLINE_DEQUE_INSTANCES_FOR_TYPE(X, uint32_t)                        \
+    INLINE_DEQUE_INSTANCES_FOR_TYPE(X, int64_t)                         \
+    INLINE_DEQUE_INSTANCES_FOR_TYPE(X, uint64_t)                        \
+    INLINE_DEQUE_INSTANCES_FOR_TYPE(X, void*)                           \
+    INLINE_DEQUE_INSTANCES_FOR_TYPE(X, std::string)                     \
+    INLINE_DEQUE_INSTANCES_FOR_TYPE(X, inline_deque_pair32)             \
+    INLINE_DEQUE_INSTANCES_FOR_TYPE(X, inline_deque_pair64)
+
+// Small POD element types.
+typedef std::pair<uint32_t, uint32_t> inline_deque_pair32;
+typedef std::pair<uint64_t, uint64_t> inline_deque_pair64;
+
+#define INLINE_DEQUE_EXTERN_INSTANCE(T, N)      \
+    extern template class inline_deque<T, N>;
+
+INLINE_DEQUE_INSTANCES(INLINE_DEQUE_EXTERN_INSTANCE)
+
+#undef INLINE_DEQUE_EXTERN_INSTANCE
+
+#endif // INLINE_DEQUE_INSTANCES_H
@@ -0,0 +1,587 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+//
+// Search and reduction functions for queues of arithmetic types.
+// These work directly on the (at most two) contiguous segments of
+// the queue's storage rather than through iterators, and use SSE2 or
+// AVX2 where available. The instruction set is chosen at runtime,
+// with a scalar fallback for other element types and architectures.
+//
+// All functions are in the inline_deque_simd namespace, and accept
+// any inline_deque with an arithmetic element type. The value
+// arguments are converted to the element type, so e.g.
+// count(q, 1) works for a queue of uint32_t.
+//
+// * size_t find(const inline_deque& q, T value)
+//   Return the index of the first element equal to value, or
+//   q.size() if there is no such element.
+// * size_t count(const inline_deque& q, T value)
+//   Return the number of elements equal to value.
+// * bool contains(const inline_deque& q, T value)
+//   Return true if any element is equal to value.
+// * T min(const inline_deque& q)
+// * T max(const inline_deque& q)
+//   Return the smallest / largest element. Raises an exception if
+//   the queue is empty.
+// * sum_type<T>::type sum(const inline_deque& q)
+//   Return the sum of all elements. Integers are summed as 64 bit
+//   integers of the same signedness, floating point numbers as
+//   doubles.
+// * bool equal(const inline_deque& a, const inline_deque& b)
+//   Return true if the queues have the same size, and all elements
+//   compare equal. The queues may have different template parameters
+//   as long as the element types are the same.
+//
+// Comparisons use the normal semantics of ==, e.g. NaN is not equal
+// to anything.
+
+#ifndef INLINE_DEQUE_SIMD_H
+#define INLINE_DEQUE_SIMD_H
+
+#include "inline_deque.h"
+
+#if defined(__GNUC__) && defined(__SSE2__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define INLINE_DEQUE_SIMD_X86 1
+#include <immintrin.h>
+#define INLINE_DEQUE_AVX2 __attribute__((target("avx2")))
+#endif
+
+#if defined(__GNUC__)
+#define INLINE_DEQUE_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define INLINE_DEQUE_ALWAYS_INLINE inline
+#endif
+
+namespace inline_deque_simd {
+
+template<typename T,
+         bool Float = std::is_floating_point<T>::value,
+         bool Signed = std::is_signed<T>::value>
+struct sum_type {
+    typedef uint64_t type;
+};
+
+template<typename T>
+struct sum_type<T, false, true> {
+    typedef int64_t type;
+};
+
+template<typename T, bool Signed>
+struct sum_type<T, true, Signed> {
+    typedef double type;
+};
+
+namespace detail {
+
+// Scalar kernels. These are used for the types and architectures
+// with no vectorized version, and for the tails of the arrays that
+// don't fill a whole vector.
+
+template<typename T>
+size_t find_scalar(const T* p, size_t n, T value) {
+    for (size_t i = 0; i < n; ++i) {
+        if (p[i] == value) {
+            return i;
+        }
+    }
+    return n;
+}
+
+template<typename T>
+size_t count_scalar(const T* p, size_t n, T value) {
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        count += p[i] == value;
+    }
+    return count;
+}
+
+template<typename T>
+bool equal_scalar(const T* a, const T* b, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        if (!(a[i] == b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The reductions are plain loops that the compiler can vectorize.
+// They get compiled once for the baseline instruction set, and once
+// for AVX2.
+
+template<typename T>
+INLINE_DEQUE_ALWAYS_INLINE T min_loop(const T* p, size_t n, T acc) {
+    for (size_t i = 0; i < n; ++i) {
+        acc = p[i] < acc ? p[i] : acc;
+    }
+    return acc;
+}
+
+template<typename T>
+INLINE_DEQUE_ALWAYS_INLINE T max_loop(const T* p, size_t n, T acc) {
+    for (size_t i = 0; i < n; ++i) {
+        acc = p[i] > acc ? p[i] : acc;
+    }
+    return acc;
+}
+
+template<typename T, typename Acc>
+INLINE_DEQUE_ALWAYS_INLINE Acc sum_loop(const T* p, size_t n, Acc acc) {
+    for (size_t i = 0; i < n; ++i) {
+        acc += p[i];
+    }
+    return acc;
+}
+
+#ifdef INLINE_DEQUE_SIMD_X86
+
+inline bool has_avx2() {
+    static const bool avx2 = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+    }();
+    return avx2;
+}
+
+// Lane-wise equality comparisons for each supported element type.
+// eq() sets all bits of a lane when the lanes compare equal, so the
+// results of _mm_movemask_epi8 have sizeof(T) bits set for each
+// matching element, whatever the type.
+template<typename T,
+         size_t Size = sizeof(T),
+         bool Float = std::is_floating_point<T>::value>
+struct lanes {
+    static const bool supported = false;
+};
+
+template<typename T>
+struct lanes<T, 1, false> {
+    static const bool supported = true;
+    static __m128i splat(T v) { return _mm_set1_epi8(v); }
+    static __m128i eq(__m128i a, __m128i b) { return _mm_cmpeq_epi8(a, b); }
+    INLINE_DEQUE_AVX2 static __m256i splat256(T v) {
+        return _mm256_set1_epi8(v);
+    }
+    INLINE_DEQUE_AVX2 static __m256i eq256(__m256i a, __m256i b) {
+        return _mm256_cmpeq_epi8(a, b);
+    }
+};
+
+template<typename T>
+struct lanes<T, 2, false> {
+    static const bool supported = true;
+    static __m128i splat(T v) { return _mm_set1_epi16(v); }
+    static __m128i eq(__m128i a, __m128i b) { return _mm_cmpeq_epi16(a, b); }
+    INLINE_DEQUE_AVX2 static __m256i splat256(T v) {
+        return _mm256_set1_epi16(v);
+    }
+    INLINE_DEQUE_AVX2 static __m256i eq256(__m256i a, __m256i b) {
+        return _mm256_cmpeq_epi16(a, b);
+    }
+};
+
+template<typename T>
+struct lanes<T, 4, false> {
+    static const bool supported = true;
+    static __m128i splat(T v) { return _mm_set1_epi32(v); }
+    static __m128i eq(__m128i a, __m128i b) { return _mm_cmpeq_epi32(a, b); }
+    INLINE_DEQUE_AVX2 static __m256i splat256(T v) {
+        return _mm256_set1_epi32(v);
+    }
+    INLINE_DEQUE_AVX2 static __m256i eq256(__m256i a, __m256i b) {
+        return _mm256_cmpeq_epi32(a, b);
+    }
+};
+
+template<typename T>
+struct lanes<T, 8, false> {
+    static const bool supported = true;
+    static __m128i splat(T v) { return _mm_set1_epi64x(v); }
+    // SSE2 has no 64 bit comparison; both 32 bit halves must match.
+    static __m128i eq(__m128i a, __m128i b) {
+        __m128i eq32 = _mm_cmpeq_epi32(a, b);
+        return _mm_and_si128(eq32,
+                             _mm_shuffle_epi32(eq32, _MM_SHUFFLE(2, 3, 0, 1)));
+    }
+    INLINE_DEQUE_AVX2 static __m256i splat256(T v) {
+        return _mm256_set1_epi64x(v);
+    }
+    INLINE_DEQUE_AVX2 static __m256i eq256(__m256i a, __m256i b) {
+        return _mm256_cmpeq_epi64(a, b);
+    }
+};
+
+template<>
+struct lanes<float, 4, true> {
+    static const bool supported = true;
+    static __m128i splat(float v) {
+        return _mm_castps_si128(_mm_set1_ps(v));
+    }
+    static __m128i eq(__m128i a, __m128i b) {
+        return _mm_castps_si128(_mm_cmpeq_ps(_mm_castsi128_ps(a),
+                                             _mm_castsi128_ps(b)));
+    }
+    INLINE_DEQUE_AVX2 static __m256i splat256(float v) {
+        return _mm256_castps_si256(_mm256_set1_ps(v));
+    }
+    INLINE_DEQUE_AVX2 static __m256i eq256(__m256i a, __m256i b) {
+        return _mm256_castps_si256(_mm256_cmp_ps(_mm256_castsi256_ps(a),
+                                                 _mm256_castsi256_ps(b),
+                                                 _CMP_EQ_OQ));
+    }
+};
+
+template<>
+struct lanes<double, 8, true> {
+    static const bool supported = true;
+    static __m128i splat(double v) {
+        return _mm_castpd_si128(_mm_set1_pd(v));
+    }
+    static __m128i eq(__m128i a, __m128i b) {
+        return _mm_castpd_si128(_mm_cmpeq_pd(_mm_castsi128_pd(a),
+                                             _mm_castsi128_pd(b)));
+    }
+    INLINE_DEQUE_AVX2 static __m256i splat256(double v) {
+        return _mm256_castpd_si256(_mm256_set1_pd(v));
+    }
+    INLINE_DEQUE_AVX2 static __m256i eq256(__m256i a, __m256i b) {
+        return _mm256_castpd_si256(_mm256_cmp_pd(_mm256_castsi256_pd(a),
+                                                 _mm256_castsi256_pd(b),
+                                                 _CMP_EQ_OQ));
+    }
+};
+
+inline __m128i load128(const void* p) {
+    return _mm_loadu_si128(static_cast<const __m128i*>(p));
+}
+
+INLINE_DEQUE_AVX2 inline __m256i load256(const void* p) {
+    return _mm256_loadu_si256(static_cast<const __m256i*>(p));
+}
+
+// SSE2 kernels
+
+template<typename T>
+size_t find_sse2(const T* p, size_t n, T value) {
+    typedef lanes<T> L;
+    const size_t kLanes = 16 / sizeof(T);
+    __m128i v = L::splat(value);
+    size_t i = 0;
+    for (; i + kLanes <= n; i += kLanes) {
+        unsigned mask = _mm_movemask_epi8(L::eq(load128(p + i), v));
+        if (mask) {
+            return i + __builtin_ctz(mask) / sizeof(T);
+        }
+    }
+    return i + find_scalar(p + i, n - i, value);
+}
+
+template<typename T>
+size_t count_sse2(const T* p, size_t n, T value) {
+    typedef lanes<T> L;
+    const size_t kLanes = 16 / sizeof(T);
+    __m128i v = L::splat(value);
+    size_t bits = 0;
+    size_t i = 0;
+    for (; i + kLanes <= n; i += kLanes) {
+        unsigned mask = _mm_movemask_epi8(L::eq(load128(p + i), v));
+        bits += __builtin_popcount(mask);
+    }
+    return bits / sizeof(T) + count_scalar(p + i, n - i, value);
+}
+
+template<typename T>
+bool equal_sse2(const T* a, const T* b, size_t n) {
+    typedef lanes<T> L;
+    const size_t kLanes = 16 / sizeof(T);
+    size_t i = 0;
+    for (; i + kLanes <= n; i += kLanes) {
+        unsigned mask = _mm_movemask_epi8(L::eq(load128(a + i),
+                                                load128(b + i)));
+        if (mask != 0xffff) {
+            return false;
+        }
+    }
+    return equal_scalar(a + i, b + i, n - i);
+}
+
+// AVX2 kernels
+
+template<typename T>
+INLINE_DEQUE_AVX2 size_t find_avx2(const T* p, size_t n, T value) {
+    typedef lanes<T> L;
+    const size_t kLanes = 32 / sizeof(T);
+    __m256i v = L::splat256(value);
+    size_t i = 0;
+    for (; i + kLanes <= n; i += kLanes) {
+        unsigned mask = _mm256_movemask_epi8(L::eq256(load256(p + i), v));
+        if (mask) {
+            return i + __builtin_ctz(mask) / sizeof(T);
+        }
+    }
+    return i + find_scalar(p + i, n - i, value);
+}
+
+template<typename T>
+INLINE_DEQUE_AVX2 size_t count_avx2(const T* p, size_t n, T value) {
+    typedef lanes<T> L;
+    const size_t kLanes = 32 / sizeof(T);
+    __m256i v = L::splat256(value);
+    size_t bits = 0;
+    size_t i = 0;
+    for (; i + kLanes <= n; i += kLanes) {
+        unsigned mask = _mm256_movemask_epi8(L::eq256(load256(p + i), v));
+        bits += __builtin_popcount(mask);
+    }
+    return bits / sizeof(T) + count_scalar(p + i, n - i, value);
+}
+
+template<typename T>
+INLINE_DEQUE_AVX2 bool equal_avx2(const T* a, const T* b, size_t n) {
+    typedef lanes<T> L;
+    const size_t kLanes = 32 / sizeof(T);
+    size_t i = 0;
+    for (; i + kLanes <= n; i += kLanes) {
+        unsigned mask = _mm256_movemask_epi8(L::eq256(load256(a + i),
+                                                      load256(b + i)));
+        if (mask != 0xffffffff) {
+            return false;
+        }
+    }
+    return equal_scalar(a + i, b + i, n - i);
+}
+
+template<typename T>
+INLINE_DEQUE_AVX2 T min_avx2(const T* p, size_t n, T acc) {
+    return min_loop(p, n, acc);
+}
+
+template<typename T>
+INLINE_DEQUE_AVX2 T max_avx2(const T* p, size_t n, T acc) {
+    return max_loop(p, n, acc);
+}
+
+template<typename T, typename Acc>
+INLINE_DEQUE_AVX2 Acc sum_avx2(const T* p, size_t n, Acc acc) {
+    return sum_loop(p, n, acc);
+}
+
+// Dispatch to the best available kernel.
+
+template<typename T>
+size_t find(const T* p, size_t n, T value, std::true_type) {
+    if (has_avx2()) {
+        return find_avx2(p, n, value);
+    }
+    return find_sse2(p, n, value);
+}
+
+template<typename T>
+size_t count(const T* p, size_t n, T value, std::true_type) {
+    if (has_avx2()) {
+        return count_avx2(p, n, value);
+    }
+    return count_sse2(p, n, value);
+}
+
+template<typename T>
+bool equal(const T* a, const T* b, size_t n, std::true_type) {
+    if (has_avx2()) {
+        return equal_avx2(a, b, n);
+    }
+    return equal_sse2(a, b, n);
+}
+
+template<typename T>
+T min(const T* p, size_t n, T acc) {
+    if (has_avx2()) {
+        return min_avx2(p, n, acc);
+    }
+    return min_loop(p, n, acc);
+}
+
+template<typename T>
+T max(const T* p, size_t n, T acc) {
+    if (has_avx2()) {
+        return max_avx2(p, n, acc);
+    }
+    return max_loop(p, n, acc);
+}
+
+template<typename T, typename Acc>
+Acc sum(const T* p, size_t n, Acc acc) {
+    if (has_avx2()) {
+        return sum_avx2(p, n, acc);
+    }
+    return sum_loop(p, n, acc);
+}
+
+#else // INLINE_DEQUE_SIMD_X86
+
+template<typename T>
+struct lanes {
+    static const bool supported = false;
+};
+
+template<typename T>
+T min(const T* p, size_t n, T acc) {
+    return min_loop(p, n, acc);
+}
+
+template<typename T>
+T max(const T* p, size_t n, T acc) {
+    return max_loop(p, n, acc);
+}
+
+template<typename T, typename Acc>
+Acc sum(const T* p, size_t n, Acc acc) {
+    return sum_loop(p, n, acc);
+}
+
+#endif // INLINE_DEQUE_SIMD_X86
+
+template<typename T>
+size_t find(const T* p, size_t n, T value, std::false_type) {
+    return find_scalar(p, n, value);
+}
+
+template<typename T>
+size_t count(const T* p, size_t n, T value, std::false_type) {
+    return count_scalar(p, n, value);
+}
+
+template<typename T>
+bool equal(const T* a, const T* b, size_t n, std::false_type) {
+    return equal_scalar(a, b, n);
+}
+
+template<typename T>
+struct has_kernels
+    : std::integral_constant<bool, lanes<T>::supported> {
+};
+
+}  // namespace detail
+
+template<typename T, size_t N, typename C, class A, class P>
+size_t find(const inline_deque<T, N, C, A, P>& q,
+            typename inline_deque<T, N, C, A, P>::value_type value) {
+    static_assert(std::is_arithmetic<T>::value,
+                  "inline_deque_simd requires an arithmetic type");
+    typename inline_deque<T, N, C, A, P>::const_segment seg[2];
+    int n = q.segments(seg);
+    size_t offset = 0;
+    for (int i = 0; i < n; ++i) {
+        size_t at = detail::find(seg[i].data, seg[i].size, value,
+                                 detail::has_kernels<T>());
+        if (at < seg[i].size) {
+            return offset + at;
+        }
+        offset += seg[i].size;
+    }
+    return offset;
+}
+
+template<typename T, size_t N, typename C, class A, class P>
+size_t count(const inline_deque<T, N, C, A, P>& q,
+             typename inline_deque<T, N, C, A, P>::value_type value) {
+    static_assert(std::is_arithmetic<T>::value,
+                  "inline_deque_simd requires an arithmetic type");
+    typename inline_deque<T, N, C, A, P>::const_segment seg[2];
+    int n = q.segments(seg);
+    size_t count = 0;
+    for (int i = 0; i < n; ++i) {
+        count += detail::count(seg[i].data, seg[i].size, value,
+                               detail::has_kernels<T>());
+    }
+    return count;
+}
+
+template<typename T, size_t N, typename C, class A, class P>
+bool contains(const inline_deque<T, N, C, A, P>& q,
+              typename inline_deque<T, N, C, A, P>::value_type value) {
+    return find(q, value) != q.size();
+}
+
+template<typename T, size_t N, typename C, class A, class P>
+T min(const inline_deque<T, N, C, A, P>& q) {
+    static_assert(std::is_arithmetic<T>::value,
+                  "inline_deque_simd requires an arithmetic type");
+    T acc = q.front();
+    typename inline_deque<T, N, C, A, P>::const_segment seg[2];
+    int n = q.segments(seg);
+    for (int i = 0; i < n; ++i) {
+        acc = detail::min(seg[i].data, seg[i].size, acc);
+    }
+    return acc;
+}
+
+template<typename T, size_t N, typename C, class A, class P>
+T max(const inline_deque<T, N, C, A, P>& q) {
+    static_assert(std::is_arithmetic<T>::value,
+                  "inline_deque_simd requires an arithmetic type");
+    T acc = q.front();
+    typename inline_deque<T, N, C, A, P>::const_segment seg[2];
+    int n = q.segments(seg);
+    for (int i = 0; i < n; ++i) {
+        acc = detail::max(seg[i].data, seg[i].size, acc);
+    }
+    return acc;
+}
+
+template<typename T, size_t N, typename C, class A, class P>
+typename sum_type<T>::type sum(const inline_deque<T, N, C, A, P>& q) {
+    static_assert(std::is_arithmetic<T>::value,
+                  "inline_deque_simd requires an arithmetic type");
+    typename sum_type<T>::type acc = 0;
+    typename inline_deque<T, N, C, A, P>::const_segment seg[2];
+    int n = q.segments(seg);
+    for (int i = 0; i < n; ++i) {
+        acc = detail::sum(seg[i].data, seg[i].size, acc);
+    }
+    return acc;
+}
+
+template<typename T, size_t N1, typename C1, class A1, class P1,
+         size_t N2, typename C2, class A2, class P2>
+bool equal(const inline_deque<T, N1, C1, A1, P1>& a,
+           const inline_deque<T, N2, C2, A2, P2>& b) {
+    static_assert(std::is_arithmetic<T>::value,
+                  "inline_deque_simd requires an arithmetic type");
+    if (a.size() != b.size()) {
+        return false;
+    }
+    typename inline_deque<T, N1, C1, A1, P1>::const_segment seg_a[2];
+    typename inline_deque<T, N2, C2, A2, P2>::const_segment seg_b[2];
+    int count_a = a.segments(seg_a);
+    int count_b = b.segments(seg_b);
+    // The segments of the two queues don't line up, so compare in
+    // chunks that are contiguous in both.
+    int i = 0, j = 0;
+    size_t off_a = 0, off_b = 0;
+    while (i < count_a && j < count_b) {
+        size_t n = std::min(seg_a[i].size - off_a, seg_b[j].size - off_b);
+        if (!detail::equal(seg_a[i].data + off_a, seg_b[j].data + off_b, n,
+                           detail::has_kernels<T>())) {
+            return false;
+        }
+        off_a += n;
+        off_b += n;
+        if (off_a == seg_a[i].size) {
+            ++i;
+            off_a = 0;
+        }
+        if (off_b == seg_b[j].size) {
+            ++j;
+            off_b = 0;
+        }
+    }
+    return true;
+}
+
+}  // namespace inline_deque_simd
+
+#endif // INLINE_DEQUE_SIMD_H
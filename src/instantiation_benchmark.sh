@@ -0,0 +1,81 @@
+#!/bin/sh
+#
+# Copyright 2016 Juho Snellman, released under a MIT license (see
+# LICENSE).
+#
+# Measure the compile time and code size cost of instantiating
+# inline_deque. Every combination of template parameters below is
+# explicitly instantiated (i.e. every member function is compiled) in
+# a translation unit of its own. The compile time and .text size are
+# reported relative to a translation unit that just includes the
+# header. Finally all the combinations are instantiated in a single
+# translation unit, which shows how much code the instantiations share.
+#
+# Usage: instantiation_benchmark.sh [compiler] [flags...]
+
+CXX=${1:-${CXX:-c++}}
+[ $# -gt 0 ] && shift
+FLAGS=${*:--std=c++11 -O3}
+SRC=$(cd "$(dirname "$0")" && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+COMBINATIONS="
+uint8_t,1,uint32_t
+uint32_t,0,uint32_t
+uint32_t,1,uint32_t
+uint32_t,16,uint32_t
+uint32_t,16,uint16_t
+uint64_t,1,uint32_t
+uint64_t,8,uint64_t
+void*,4,uint32_t
+double,4,uint32_t
+Pod,4,uint32_t
+Pod,16,uint16_t
+std::string,0,uint32_t
+std::string,1,uint32_t
+std::string,4,uint32_t
+"
+
+prologue() {
+    cat <<EOF
+#include <string>
+#include "$SRC/inline_deque.h"
+struct Pod { uint32_t a, b, c; };
+EOF
+}
+
+now_ms() {
+    echo $(($(date +%s%N) / 1000000))
+}
+
+# Print "<compile ms> <text bytes>" for a translation unit.
+measure() {
+    start=$(now_ms)
+    $CXX $FLAGS -c "$1" -o "$1.o" || exit 1
+    end=$(now_ms)
+    text=$(size -A "$1.o" | awk '$1 ~ /^\.text/ { sum += $2 } END { print sum + 0 }')
+    echo "$((end - start)) $text"
+}
+
+prologue > "$TMP/base.cc"
+set -- $(measure "$TMP/base.cc")
+BASE_MS=$1
+BASE_TEXT=$2
+
+printf "%-36s %10s %10s\n" "instantiation" "compile ms" ".text"
+prologue > "$TMP/all.cc"
+n=0
+for c in $COMBINATIONS; do
+    prologue > "$TMP/one.cc"
+    echo "template class inline_deque<$c>;" >> "$TMP/one.cc"
+    echo "template class inline_deque<$c>;" >> "$TMP/all.cc"
+    set -- $(measure "$TMP/one.cc")
+    printf "%-36s %10d %10d\n" "inline_deque<$c>" \
+        $(($1 - BASE_MS)) $(($2 - BASE_TEXT))
+    n=$((n + 1))
+done
+
+set -- $(measure "$TMP/all.cc")
+printf "%-36s %10d %10d\n" "all $n in one translation unit" \
+    $(($1 - BASE_MS)) $(($2 - BASE_TEXT))
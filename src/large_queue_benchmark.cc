@@ -0,0 +1,77 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+//
+// Measure queues with a very large number of one byte elements, to
+// see what 64 bit indices cost compared to 32 bit ones, and to
+// exercise queues beyond 2^32 elements (which need 64 bit indices).
+//
+// * fill: push_back the given number of elements.
+// * scan: sum all elements with operator[].
+// * drain: pop_front all elements.
+//
+// The queues use realloc_allocator, so that a queue needs little
+// more memory than its elements while growing. The 32 bit variant is
+// skipped if the count doesn't fit in its max_size().
+//
+// Usage: large_queue_benchmark [elements, default 256M]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+
+#include "inline_deque.h"
+#include "inline_deque_allocator.h"
+
+template<typename Q>
+void bench(const char* label, uint64_t count) {
+    typedef std::chrono::steady_clock clock;
+    uint64_t max_size =
+        (std::numeric_limits<typename Q::size_type>::max() >> 1) + 1;
+    if (count > max_size) {
+        printf("%-16s skipped, max_size %lu\n", label, max_size);
+        return;
+    }
+
+    Q q;
+
+    auto start = clock::now();
+    for (uint64_t i = 0; i < count; ++i) {
+        q.push_back(i);
+    }
+    auto filled = clock::now();
+    uint64_t csum = 0;
+    for (uint64_t i = 0; i < count; ++i) {
+        csum += q[i];
+    }
+    auto scanned = clock::now();
+    while (!q.empty()) {
+        csum += q.front();
+        q.pop_front();
+    }
+    auto drained = clock::now();
+
+    typedef std::chrono::duration<double, std::milli> ms;
+    printf("%-16s fill %9.1f ms  scan %9.1f ms  drain %9.1f ms  (%lu)\n",
+           label, ms(filled - start).count(), ms(scanned - filled).count(),
+           ms(drained - scanned).count(), csum);
+}
+
+int main(int argc, char** argv) {
+    uint64_t count = uint64_t(1) << 28;
+    if (argc > 1) {
+        count = strtoull(argv[1], NULL, 10);
+    }
+
+    printf("%lu elements\n", count);
+    bench<inline_deque<uint8_t, 1, uint32_t,
+                       realloc_allocator<uint8_t>>>("uint32_t indices",
+                                                    count);
+    bench<inline_deque<uint8_t, 1, uint64_t,
+                       realloc_allocator<uint8_t>>>("uint64_t indices",
+                                                    count);
+
+    return 0;
+}
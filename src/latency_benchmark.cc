@@ -0,0 +1,158 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+//
+// Measure the distribution of per-operation latencies, rather than
+// the average throughput. A queue is grown to the given size with
+// three pushes for every pop, so that it gets resized many times,
+// and each push and pop is timed individually. The latencies are
+// collected in a histogram with power-of-two buckets, and reported
+// as percentiles.
+//
+// The total time is measured in a separate run without the per-op
+// timing, which would otherwise dominate it.
+//
+// The "reserve" variants reserve space for all elements up front.
+// With the default allocator the pages of the buffer are then still
+// faulted in by the pushes that first touch them; with
+// prefault_allocator they're faulted in (and optionally locked) by
+// reserve().
+//
+// Usage: latency_benchmark [elements, default 10M]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+
+#include "hybrid_deque.h"
+#include "incremental_deque.h"
+#include "inline_deque.h"
+#include "inline_deque_allocator.h"
+
+class Histogram {
+public:
+    void add(uint64_t ns) {
+        int bucket = 0;
+        while (ns >> bucket && bucket < kBuckets - 1) {
+            ++bucket;
+        }
+        ++counts_[bucket];
+        ++total_;
+        if (ns > max_) {
+            max_ = ns;
+        }
+    }
+
+    // Return the upper bound of the bucket containing the given
+    // quantile.
+    uint64_t percentile(double p) const {
+        uint64_t target = total_ * p / 100;
+        uint64_t seen = 0;
+        for (int i = 0; i < kBuckets; ++i) {
+            seen += counts_[i];
+            if (seen > target) {
+                return 1ull << i;
+            }
+        }
+        return max_;
+    }
+
+    uint64_t max() const {
+        return max_;
+    }
+
+private:
+    static const int kBuckets = 64;
+    uint64_t counts_[kBuckets] = { 0 };
+    uint64_t total_ = 0;
+    uint64_t max_ = 0;
+};
+
+// The capacity reserved by reserved<Q> queues.
+static size_t reserve_count = 0;
+
+template<typename Q>
+struct reserved : Q {
+    reserved() {
+        this->reserve(reserve_count);
+    }
+};
+
+template<typename Q, bool Timed>
+uint64_t run(size_t count, Histogram* histogram) {
+    typedef std::chrono::steady_clock clock;
+    uint64_t csum = 0;
+    Q q;
+    uint64_t i = 0;
+    while (q.size() < count) {
+        clock::time_point start;
+        if (Timed) {
+            start = clock::now();
+        }
+        if (i % 4 == 3) {
+            csum += q.front();
+            q.pop_front();
+        } else {
+            q.push_back(i);
+        }
+        if (Timed) {
+            histogram->add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               clock::now() - start).count());
+        }
+        ++i;
+    }
+    return csum + q.size();
+}
+
+template<typename Q>
+void bench(const char* label, size_t count) {
+    Histogram histogram;
+    auto start = std::chrono::steady_clock::now();
+    uint64_t csum = run<Q, false>(count, NULL);
+    auto end = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    run<Q, true>(count, &histogram);
+
+    printf("%-32s %8.1f ms  p50 %6lu  p99 %6lu  p99.9 %6lu  "
+           "p99.99 %8lu  max %10lu ns  (%lu)\n",
+           label, ms,
+           histogram.percentile(50), histogram.percentile(99),
+           histogram.percentile(99.9), histogram.percentile(99.99),
+           histogram.max(), csum);
+}
+
+int main(int argc, char** argv) {
+    size_t count = 10000000;
+    if (argc > 1) {
+        count = strtoull(argv[1], NULL, 10);
+    }
+
+    bench<std::deque<uint64_t>>("std::deque", count);
+    bench<inline_deque<uint64_t>>("inline_deque", count);
+    bench<inline_deque<uint64_t, 1, uint32_t,
+                       realloc_allocator<uint64_t>>>(
+        "inline_deque (realloc)", count);
+    bench<incremental_deque<uint64_t>>("incremental_deque", count);
+    bench<incremental_deque<uint64_t, uint32_t,
+                            std::allocator<uint64_t>, 1>>(
+        "incremental_deque<1>", count);
+    bench<hybrid_deque<uint64_t>>("hybrid_deque", count);
+
+    typedef inline_deque<uint64_t, 1, uint32_t, std::allocator<uint64_t>,
+                         inline_deque_no_shrink<>> no_shrink_queue;
+    typedef inline_deque<uint64_t, 1, uint32_t,
+                         prefault_allocator<uint64_t>,
+                         inline_deque_no_shrink<>> prefault_queue;
+    typedef inline_deque<uint64_t, 1, uint32_t,
+                         prefault_allocator<uint64_t, true>,
+                         inline_deque_no_shrink<>> locked_queue;
+    reserve_count = count;
+    bench<reserved<no_shrink_queue>>("inline_deque (reserve)", count);
+    bench<reserved<prefault_queue>>("inline_deque (reserve+prefault)",
+                                    count);
+    bench<reserved<locked_queue>>("inline_deque (reserve+mlock)", count);
+
+    return 0;
+}
@@ -0,0 +1,137 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+//
+// Compare queues of variable-size messages: record_deque (all
+// messages back to back in one byte ring) against an inline_deque of
+// std::string or std::vector<char> (one allocation per message,
+// except for short strings).
+//
+// The message sizes are 8 bytes to 4KB, mostly small: three quarters
+// are at most 64 bytes. A queue of the given depth is first filled,
+// and then messages are pushed at the back and popped from the front
+// in steady state. Each popped message is read in full.
+//
+// The memory column is the size of the queue storage plus the
+// per-message heap buffers, excluding allocator overhead, at the end
+// of the run.
+//
+// Usage: record_benchmark [messages, default 10M]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "inline_deque.h"
+#include "record_deque.h"
+
+static std::vector<uint32_t> make_sizes(size_t count) {
+    std::mt19937 rand(1);
+    std::vector<uint32_t> sizes(count);
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t r = rand();
+        sizes[i] = 8 + (r >> 8) % (r % 4 ? 57 : 4089);
+    }
+    return sizes;
+}
+
+static uint64_t read_message(const char* data, size_t size) {
+    uint64_t csum = size;
+    for (size_t i = 0; i < size; i += 8) {
+        csum += data[i];
+    }
+    return csum;
+}
+
+struct record_adapter {
+    typedef record_deque<4096> queue;
+
+    void push(const char* data, size_t size) {
+        q.push_back(data, size);
+    }
+    uint64_t pop() {
+        queue::segment record = q.front();
+        uint64_t csum = read_message(record.data, record.size);
+        q.pop_front();
+        return csum;
+    }
+    size_t memory() const {
+        return q.capacity();
+    }
+
+    queue q;
+};
+
+template<typename Message>
+struct object_adapter {
+    typedef inline_deque<Message, 1> queue;
+
+    void push(const char* data, size_t size) {
+        q.emplace_back(data, data + size);
+    }
+    uint64_t pop() {
+        const Message& m = q.front();
+        uint64_t csum = read_message(m.data(), m.size());
+        q.pop_front();
+        return csum;
+    }
+    size_t memory() const {
+        size_t bytes = q.capacity() * sizeof(Message);
+        for (const Message& m : q) {
+            if (m.data() < reinterpret_cast<const char*>(&m) ||
+                m.data() >= reinterpret_cast<const char*>(&m + 1)) {
+                bytes += m.capacity();
+            }
+        }
+        return bytes;
+    }
+
+    queue q;
+};
+
+template<typename A>
+void bench(const char* label, size_t depth,
+           const std::vector<uint32_t>& sizes, const char* payload) {
+    typedef std::chrono::steady_clock clock;
+    uint64_t csum = 0;
+    A a;
+    auto start = clock::now();
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        a.push(payload, sizes[i]);
+        if (i >= depth) {
+            csum += a.pop();
+        }
+    }
+    auto end = clock::now();
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    printf("%-8zu %-20s %10.1f ms  %8.1f MB  (%lu)\n",
+           depth, label, ms, a.memory() / 1048576.0, csum);
+}
+
+int main(int argc, char** argv) {
+    size_t count = 10000000;
+    if (argc > 1) {
+        count = strtoull(argv[1], NULL, 10);
+    }
+
+    std::vector<uint32_t> sizes = make_sizes(count);
+    std::vector<char> payload(4096);
+    for (size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = i;
+    }
+
+    for (size_t depth = 16; depth <= 65536 && depth < count; depth *= 16) {
+        bench<record_adapter>("record_deque", depth, sizes, payload.data());
+        bench<object_adapter<std::string>>(
+            "std::string", depth, sizes, payload.data());
+        bench<object_adapter<std::vector<char>>>(
+            "std::vector<char>", depth, sizes, payload.data());
+    }
+
+    return 0;
+}
@@ -0,0 +1,287 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+//
+// record_deque is a queue of variable-size byte records (e.g.
+// messages), stored back to back in a single byte ring rather than
+// allocated one by one.
+//
+// Each record is stored as a LengthType length prefix followed by the
+// payload, in the storage of a bip_buffer (see bip_buffer.h). A record
+// never wraps around the end of the storage, so it can always be
+// accessed as a single contiguous span. The cost of that is some
+// padding at the end of the storage whenever a record doesn't fit
+// there. Small queues are stored inline, as for inline_deque.
+//
+// Template parameters:
+//
+// * size_t InlineCapacity, typename CapacityType, class Allocator
+//   As for inline_deque, in bytes (including the length prefixes).
+// * typename LengthType
+//   The type of the length prefix. Limits the size of a record.
+//
+// The queue is FIFO, with records added at the back and removed from
+// the front:
+//
+// * record_deque(size_t initial_capacity = InlineCapacity,
+//                const Allocator& alloc = Allocator())
+// * void push_back(const void* data, size_t size)
+// * void push_back(const_segment record)
+//   Add a copy of the record at the back of the queue. Raises
+//   std::length_error if size doesn't fit in LengthType.
+// * char* emplace_back(size_t size)
+//   Add a record of the given size at the back of the queue, and
+//   return a pointer to its (uninitialized) payload, to be filled in
+//   by the caller. Valid until the queue is next modified.
+// * segment front(), const_segment front() const
+//   The record at the front of the queue. Raises std::out_of_range if
+//   the queue is empty.
+// * void pop_front()
+//   Remove the record at the front of the queue. Raises
+//   std::out_of_range if the queue is empty.
+// * void pop_front(size_t count)
+//   Remove the count first records. Raises std::out_of_range if the
+//   queue has fewer than count records.
+// * begin(), end(), cbegin(), cend()
+//   Forward iterators over the records, front to back. Dereferencing
+//   an iterator returns a const_segment. For processing a batch of
+//   records, iterate over the batch and then pop_front(count).
+// * bool empty() const
+// * CapacityType size() const
+//   The number of records.
+// * CapacityType bytes() const
+//   The number of bytes used by the records, including the length
+//   prefixes but not any padding.
+// * capacity(), clear(), get_allocator()
+//   As for inline_deque, with the capacity in bytes.
+//
+// Copying and moving are as for inline_deque.
+//
+// Invalidation: Pushing records invalidates all spans and iterators,
+// popping records invalidates the ones pointing to the popped records.
+
+#ifndef RECORD_DEQUE_H
+#define RECORD_DEQUE_H
+
+#include <cstring>
+#include <iterator>
+
+#include "bip_buffer.h"
+
+template<size_t InlineCapacity = 256,
+         typename CapacityType = uint32_t,
+         class Allocator = std::allocator<char>,
+         typename LengthType = uint32_t>
+class record_deque
+    : protected bip_buffer<InlineCapacity, CapacityType, Allocator> {
+public:
+    typedef bip_buffer<InlineCapacity, CapacityType, Allocator> buffer_type;
+    typedef typename buffer_type::segment segment;
+    typedef typename buffer_type::const_segment const_segment;
+    typedef CapacityType size_type;
+
+    static const size_t kHeaderSize = sizeof(LengthType);
+
+    explicit record_deque(size_t initial_capacity = InlineCapacity,
+                          const Allocator& alloc = Allocator())
+        : buffer_type(initial_capacity, alloc) {
+    }
+
+    // Adding / removing records
+
+    void push_back(const void* data, size_t size) {
+        memcpy(emplace_back(size), data, size);
+    }
+
+    void push_back(const_segment record) {
+        push_back(record.data, record.size);
+    }
+
+    char* emplace_back(size_t size) {
+        if (size > std::numeric_limits<LengthType>::max()) {
+            inline_deque_detail::throw_length_error();
+        }
+        LengthType length = size;
+        char* p = this->reserve_contiguous(kHeaderSize + size);
+        memcpy(p, &length, kHeaderSize);
+        buffer_type::commit_back(kHeaderSize + size);
+        ++count_;
+        return p + kHeaderSize;
+    }
+
+    segment front() {
+        require_nonempty();
+        return record_at(this->ptr_read());
+    }
+
+    const_segment front() const {
+        require_nonempty();
+        segment record = record_at(this->ptr_read());
+        const_segment ret = { record.data, record.size };
+        return ret;
+    }
+
+    void pop_front() {
+        require_nonempty();
+        buffer_type::consume_front(kHeaderSize + length_at(this->ptr_read()));
+        --count_;
+    }
+
+    void pop_front(size_t count) {
+        if (count > count_) {
+            inline_deque_detail::throw_out_of_range();
+        }
+        for (size_t i = 0; i < count; ++i) {
+            pop_front();
+        }
+    }
+
+    // Size
+
+    bool empty() const {
+        return count_ == 0;
+    }
+
+    CapacityType size() const {
+        return count_;
+    }
+
+    CapacityType bytes() const {
+        return buffer_type::size();
+    }
+
+    CapacityType capacity() const {
+        return buffer_type::capacity();
+    }
+
+    void clear() {
+        buffer_type::clear();
+        count_ = 0;
+    }
+
+    Allocator get_allocator() const {
+        return buffer_type::get_allocator();
+    }
+
+    // Copying / assignment
+
+    record_deque(const record_deque& other) = default;
+
+    record_deque(record_deque&& other)
+        : buffer_type(std::move(other)), count_(other.count_) {
+        other.count_ = 0;
+    }
+
+    record_deque& operator=(const record_deque& other) = default;
+
+    record_deque& operator=(record_deque&& other) {
+        if (&other != this) {
+            buffer_type::operator=(std::move(other));
+            count_ = other.count_;
+            other.count_ = 0;
+        }
+        return *this;
+    }
+
+    // Iterators
+
+    class const_iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef const_segment value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const const_segment* pointer;
+        typedef const_segment reference;
+
+        const_iterator(const record_deque* q, CapacityType index,
+                       CapacityType remaining)
+            : q_(q), index_(index), remaining_(remaining) {
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return q_ == other.q_ && remaining_ == other.remaining_;
+        }
+        bool operator!=(const const_iterator& other) const {
+            return !(*this == other);
+        }
+
+        const_segment operator*() const {
+            segment record = q_->record_at(index_);
+            const_segment ret = { record.data, record.size };
+            return ret;
+        }
+
+        const_iterator& operator++() {
+            index_ = q_->next_index(index_);
+            --remaining_;
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator ret = *this;
+            ++*this;
+            return ret;
+        }
+
+    private:
+        const record_deque* q_;
+        // The buffer index of the length prefix of the record.
+        CapacityType index_;
+        // The number of records from this one to the end.
+        CapacityType remaining_;
+    };
+
+    typedef const_iterator iterator;
+
+    const_iterator begin() const {
+        return const_iterator(this, this->ptr_read(), count_);
+    }
+
+    const_iterator end() const {
+        return const_iterator(this, this->ptr_write(), 0);
+    }
+
+    const_iterator cbegin() const {
+        return begin();
+    }
+
+    const_iterator cend() const {
+        return end();
+    }
+
+protected:
+    void require_nonempty() const {
+        if (empty()) {
+            inline_deque_detail::throw_empty();
+        }
+    }
+
+    char* at_index(CapacityType index) const {
+        return this->storage() + (index & (this->capacity_ - 1));
+    }
+
+    LengthType length_at(CapacityType index) const {
+        LengthType length;
+        memcpy(&length, at_index(index), kHeaderSize);
+        return length;
+    }
+
+    segment record_at(CapacityType index) const {
+        segment ret = { at_index(index) + kHeaderSize, length_at(index) };
+        return ret;
+    }
+
+    // The buffer index of the record after the one at "index", skipping
+    // the padding.
+    CapacityType next_index(CapacityType index) const {
+        index += kHeaderSize + length_at(index);
+        if (this->pad_ && index == this->pad_at_) {
+            index += this->pad_;
+        }
+        return index;
+    }
+
+    CapacityType count_ = 0;
+};
+
+#endif // RECORD_DEQUE_H
@@ -0,0 +1,102 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+//
+// Compare scanning a wrapped 4K-element queue through iterators with
+// the segment-based kernels in inline_deque_simd.h.
+//
+// Usage: simd_benchmark [iterations]
+
+#include <chrono>
+#include <cstdio>
+
+#include "inline_deque.h"
+#include "inline_deque_simd.h"
+
+template<class Fun>
+void run(const char* type, const char* label, int iterations, Fun fun) {
+    uint64_t csum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        csum += fun(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    printf("%-10s %-16s %10.1f ns/scan  (%lu)\n", type, label,
+           ns / iterations, csum);
+}
+
+template<typename T>
+void bench(const char* type, int iterations) {
+    static const int kSize = 4096;
+    inline_deque<T, 1> q;
+    // Leave the queue wrapped around in the middle.
+    for (int i = 0; i < kSize / 2; ++i) {
+        q.push_back(0);
+    }
+    for (int i = 0; i < kSize; ++i) {
+        q.push_back(static_cast<T>(i));
+        q.pop_front();
+    }
+
+    run(type, "find (iterator)", iterations, [&](int i) {
+            T value = static_cast<T>(kSize - 1 - i % 16);
+            size_t n = 0;
+            for (auto it = q.begin(); it != q.end(); ++it, ++n) {
+                if (*it == value) {
+                    break;
+                }
+            }
+            return n;
+        });
+    run(type, "find (simd)", iterations, [&](int i) {
+            T value = static_cast<T>(kSize - 1 - i % 16);
+            return inline_deque_simd::find(q, value);
+        });
+    run(type, "count (iterator)", iterations, [&](int i) {
+            T value = static_cast<T>(i % kSize);
+            size_t n = 0;
+            for (auto it = q.begin(); it != q.end(); ++it) {
+                n += *it == value;
+            }
+            return n;
+        });
+    run(type, "count (simd)", iterations, [&](int i) {
+            return inline_deque_simd::count(q, static_cast<T>(i % kSize));
+        });
+    run(type, "sum (iterator)", iterations, [&](int i) {
+            typename inline_deque_simd::sum_type<T>::type sum = 0;
+            for (auto it = q.begin(); it != q.end(); ++it) {
+                sum += *it;
+            }
+            return static_cast<uint64_t>(sum);
+        });
+    run(type, "sum (simd)", iterations, [&](int i) {
+            return static_cast<uint64_t>(inline_deque_simd::sum(q));
+        });
+    run(type, "max (iterator)", iterations, [&](int i) {
+            T max = q.front();
+            for (auto it = q.begin(); it != q.end(); ++it) {
+                max = std::max(max, *it);
+            }
+            return static_cast<uint64_t>(max);
+        });
+    run(type, "max (simd)", iterations, [&](int i) {
+            return static_cast<uint64_t>(inline_deque_simd::max(q));
+        });
+}
+
+int main(int argc, char** argv) {
+    int iterations = 100000;
+    if (argc > 1) {
+        sscanf(argv[1], "%d", &iterations);
+    }
+
+    bench<uint16_t>("uint16_t", iterations);
+    bench<uint32_t>("uint32_t", iterations);
+    bench<uint64_t>("uint64_t", iterations);
+    bench<double>("double", iterations);
+
+    return 0;
+}
@@ -0,0 +1,370 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+//
+// static_deque is a fixed capacity double-ended queue that stores all
+// its elements inline, and never allocates memory. It's the same ring
+// buffer as inline_deque (see inline_deque.h) with only the inline
+// storage: there are no growth paths at all, the capacity is a
+// compile time constant, and accessing an element is just masking
+// the index with a constant.
+//
+// Since the queue can't grow, what happens when adding an element to
+// a full queue is determined by a policy, using the same values as
+// the inline_deque overflow policies:
+//
+// * inline_deque_overflow::reject, inline_deque_overflow::drop_newest
+//   The element is not added, and the push returns false. (There's
+//   no drop counter, so the two are the same.)
+// * inline_deque_overflow::abort
+//   A full queue is a programming error, and the program is aborted.
+//   (In both debug and release builds.)
+// * inline_deque_overflow::overwrite_oldest
+//   The element at the other end of the queue is destroyed to make
+//   space for the new one, i.e. push_back() drops the front element
+//   and push_front() the back element.
+//
+// inline_deque_overflow::grow is not allowed.
+//
+// Template parameters:
+//
+// * typename T
+//   The type of the elements
+// * size_t Capacity
+//   The number of elements the queue can hold. Must be a power of two.
+// * inline_deque_overflow Policy
+//   What to do when adding an element to a full queue (see above).
+// * typename CapacityType
+//   The type of the indices
+//
+// The API is a subset of the inline_deque one. The differences are
+// that the push and emplace functions return a bool, and that there
+// is a full() function:
+//
+// * bool push_front(const T& e), bool push_back(const T& e)
+// * bool push_front(T&& e), bool push_back(T&& e)
+// * template<typename... Args> bool emplace_front(Args&&... args)
+// * template<typename... Args> bool emplace_back(Args&&... args)
+//   Add an element at the head/tail of the queue. Return false if
+//   the queue was full and the element was not added (only with
+//   inline_deque_overflow::reject or drop_newest).
+// * pop_front(), pop_back()
+// * front(), back(), operator[], at()
+// * empty(), size(), max_size(), capacity(), clear()
+// * bool full() const
+//   Return true if the queue contains Capacity elements.
+// * begin(), end(), cbegin(), cend() (random access iterators)
+// * copy and move construction / assignment
+//
+// Invalidation: References to elements are never invalidated, except
+// by removing the element (including by an overwriting push).
+
+#ifndef STATIC_DEQUE_H
+#define STATIC_DEQUE_H
+
+#include <cstdlib>
+#include <new>
+
+#include "inline_deque.h"
+
+template<typename T,
+         size_t Capacity,
+         inline_deque_overflow Policy = inline_deque_overflow::reject,
+         typename CapacityType = uint32_t>
+class static_deque {
+public:
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                  "Capacity must be a power of two");
+    static_assert(Capacity - 1 <=
+                  (std::numeric_limits<CapacityType>::max() >> 1),
+                  "Capacity too large for CapacityType");
+    static_assert(Policy != inline_deque_overflow::grow,
+                  "static_deque can't grow");
+
+    typedef T value_type;
+    typedef CapacityType size_type;
+    typedef ptrdiff_t difference_type;
+    typedef T& reference;
+    typedef const T& const_reference;
+
+    static_deque() {
+    }
+
+    ~static_deque() {
+        clear();
+    }
+
+    // Adding new elements at front / back of queue.
+
+    bool push_front(const T& e) {
+        return emplace_front(e);
+    }
+
+    bool push_back(const T& e) {
+        return emplace_back(e);
+    }
+
+    bool push_front(T&& e) {
+        return emplace_front(std::move(e));
+    }
+
+    bool push_back(T&& e) {
+        return emplace_back(std::move(e));
+    }
+
+    template<typename... Args>
+    bool emplace_front(Args&&... args) {
+        if (full()) {
+            return overflow_front(policy(), std::forward<Args>(args)...);
+        }
+        new (&slot(read_ - 1)) T(std::forward<Args>(args)...);
+        read_--;
+        return true;
+    }
+
+    template<typename... Args>
+    bool emplace_back(Args&&... args) {
+        if (full()) {
+            return overflow_back(policy(), std::forward<Args>(args)...);
+        }
+        new (&slot(write_)) T(std::forward<Args>(args)...);
+        write_++;
+        return true;
+    }
+
+    // Accessing items (front, back, random access, pop).
+
+    const T& front() const {
+        require_nonempty();
+        return slot(read_);
+    }
+
+    const T& back() const {
+        require_nonempty();
+        return slot(write_ - 1);
+    }
+
+    T& front() {
+        require_nonempty();
+        return slot(read_);
+    }
+
+    T& back() {
+        require_nonempty();
+        return slot(write_ - 1);
+    }
+
+    T& operator[] (size_t i) {
+        return slot(read_ + i);
+    }
+
+    const T& operator[] (size_t i) const {
+        return slot(read_ + i);
+    }
+
+    T& at(size_t i) {
+        if (i >= size()) {
+            inline_deque_detail::throw_out_of_range();
+        }
+        return slot(read_ + i);
+    }
+
+    const T& at(size_t i) const {
+        if (i >= size()) {
+            inline_deque_detail::throw_out_of_range();
+        }
+        return slot(read_ + i);
+    }
+
+    void pop_front() {
+        require_nonempty();
+        slot(read_).~T();
+        read_++;
+    }
+
+    void pop_back() {
+        require_nonempty();
+        write_--;
+        slot(write_).~T();
+    }
+
+    // Size of queue
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    bool full() const {
+        return size() == Capacity;
+    }
+
+    CapacityType size() const {
+        return write_ - read_;
+    }
+
+    CapacityType max_size() const {
+        return Capacity;
+    }
+
+    CapacityType capacity() const {
+        return Capacity;
+    }
+
+    void clear() {
+        while (!empty()) {
+            slot(read_).~T();
+            read_++;
+        }
+    }
+
+    // Copying / assignment
+
+    static_deque(const static_deque& other) {
+        for (CapacityType i = 0; i < other.size(); ++i) {
+            emplace_back(other[i]);
+        }
+    }
+
+    static_deque(static_deque&& other) {
+        for (CapacityType i = 0; i < other.size(); ++i) {
+            emplace_back(std::move(other[i]));
+        }
+        other.clear();
+    }
+
+    static_deque& operator=(const static_deque& other) {
+        if (&other != this) {
+            clear();
+            for (CapacityType i = 0; i < other.size(); ++i) {
+                emplace_back(other[i]);
+            }
+        }
+        return *this;
+    }
+
+    static_deque& operator=(static_deque&& other) {
+        if (&other != this) {
+            clear();
+            for (CapacityType i = 0; i < other.size(); ++i) {
+                emplace_back(std::move(other[i]));
+            }
+            other.clear();
+        }
+        return *this;
+    }
+
+    // Iterators
+
+    typedef inline_deque_detail::index_iterator<
+        static_deque, T> iterator;
+    typedef inline_deque_detail::index_iterator<
+        const static_deque, const T> const_iterator;
+
+    iterator begin() {
+        return iterator(this, 0);
+    }
+
+    iterator end() {
+        return iterator(this, size());
+    }
+
+    const_iterator begin() const {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const {
+        return const_iterator(this, size());
+    }
+
+    const_iterator cbegin() const {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator cend() const {
+        return const_iterator(this, size());
+    }
+
+protected:
+    typedef std::integral_constant<inline_deque_overflow, Policy> policy;
+    typedef std::integral_constant<inline_deque_overflow,
+                                   inline_deque_overflow::reject>
+        policy_reject;
+    typedef std::integral_constant<inline_deque_overflow,
+                                   inline_deque_overflow::drop_newest>
+        policy_drop_newest;
+    typedef std::integral_constant<inline_deque_overflow,
+                                   inline_deque_overflow::abort>
+        policy_abort;
+    typedef std::integral_constant<inline_deque_overflow,
+                                   inline_deque_overflow::overwrite_oldest>
+        policy_overwrite_oldest;
+
+    // Handling of pushes to a full queue, depending on the policy.
+
+    template<typename... Args>
+    bool overflow_front(policy_reject, Args&&... args) {
+        return false;
+    }
+
+    template<typename... Args>
+    bool overflow_back(policy_reject, Args&&... args) {
+        return false;
+    }
+
+    template<typename... Args>
+    bool overflow_front(policy_drop_newest, Args&&... args) {
+        return false;
+    }
+
+    template<typename... Args>
+    bool overflow_back(policy_drop_newest, Args&&... args) {
+        return false;
+    }
+
+    template<typename... Args>
+    INLINE_DEQUE_COLD bool overflow_front(policy_abort, Args&&... args) {
+        std::abort();
+    }
+
+    template<typename... Args>
+    INLINE_DEQUE_COLD bool overflow_back(policy_abort, Args&&... args) {
+        std::abort();
+    }
+
+    // The new element is constructed before the old one is destroyed,
+    // since the arguments might refer to the element being dropped.
+    template<typename... Args>
+    bool overflow_front(policy_overwrite_oldest, Args&&... args) {
+        T tmp(std::forward<Args>(args)...);
+        pop_back();
+        return emplace_front(std::move(tmp));
+    }
+
+    template<typename... Args>
+    bool overflow_back(policy_overwrite_oldest, Args&&... args) {
+        T tmp(std::forward<Args>(args)...);
+        pop_front();
+        return emplace_back(std::move(tmp));
+    }
+
+    void require_nonempty() const {
+        if (empty()) {
+            inline_deque_detail::throw_empty();
+        }
+    }
+
+    T& slot(CapacityType index) {
+        return reinterpret_cast<T*>(e_)[index & (Capacity - 1)];
+    }
+
+    const T& slot(CapacityType index) const {
+        return reinterpret_cast<const T*>(e_)[index & (Capacity - 1)];
+    }
+
+    alignas(T) uint8_t e_[sizeof(T) * Capacity];
+    CapacityType read_ = 0;
+    CapacityType write_ = 0;
+};
+
+#endif // STATIC_DEQUE_H
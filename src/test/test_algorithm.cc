@@ -0,0 +1,200 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "../inline_deque.h"
+#include "../inline_deque_algorithm.h"
+
+#include "util_test.h"
+
+static_assert(segmented::is_segmented<inline_deque<int>::iterator>::value,
+              "inline_deque iterators are segmented");
+static_assert(segmented::is_segmented<
+                  inline_deque<int>::const_iterator>::value,
+              "inline_deque iterators are segmented");
+static_assert(!segmented::is_segmented<std::vector<int>::iterator>::value,
+              "vector iterators are not segmented");
+static_assert(!segmented::is_segmented<int*>::value,
+              "pointers are not segmented");
+
+// A queue containing 0..size-1, wrapped around after "offset"
+// elements.
+inline_deque<int, 8> make_queue(int size, int offset) {
+    inline_deque<int, 8> q;
+    for (int i = 0; i < offset; ++i) {
+        q.push_back(-1);
+        q.pop_front();
+    }
+    for (int i = 0; i < size; ++i) {
+        q.push_back(i);
+    }
+    return q;
+}
+
+bool test_segments() {
+    inline_deque<int, 8> q = make_queue(6, 3);
+    inline_deque<int, 8>::segment seg[2];
+
+    EXPECT_INTEQ(q.segments(seg), 2);
+    EXPECT_INTEQ(seg[0].size + seg[1].size, 6);
+    EXPECT_INTEQ(seg[0].data[0], 0);
+    EXPECT_INTEQ(seg[1].data[seg[1].size - 1], 5);
+
+    EXPECT_INTEQ(q.segments(1, 1, seg), 0);
+    EXPECT_INTEQ(q.begin().segments(q.begin() + 2, seg), 1);
+    EXPECT_INTEQ(seg[0].size, 2);
+    EXPECT_INTEQ(seg[0].data[1], 1);
+
+    return true;
+}
+
+bool test_algorithms() {
+    for (int size = 0; size <= 8; ++size) {
+        for (int offset = 0; offset < 8; ++offset) {
+            inline_deque<int, 8> q = make_queue(size, offset);
+            const inline_deque<int, 8>& cq = q;
+
+            int sum = 0;
+            segmented::for_each(q.begin() + 1, q.end(),
+                                [&sum](int& e) { sum += e; });
+            EXPECT_INTEQ(sum, (size ? size * (size - 1) / 2 : 0));
+            EXPECT_INTEQ(segmented::accumulate(cq.begin(), cq.end(), 0),
+                         sum);
+            EXPECT_INTEQ(segmented::accumulate(q.begin(), q.end(), 1,
+                                               [](int a, int b) {
+                                                   return a + 2 * b;
+                                               }),
+                         (1 + 2 * sum));
+
+            for (int i = 0; i <= size; ++i) {
+                auto it = segmented::find(q.begin(), q.end(), i);
+                EXPECT_INTEQ((it - q.begin()), i);
+                if (size) {
+                    auto cit = segmented::find_if(cq.begin() + 1, cq.end(),
+                                                  [i](int e) {
+                                                      return e >= i;
+                                                  });
+                    EXPECT_INTEQ((cit - cq.begin()),
+                                 std::min(std::max(i, 1), size));
+                }
+            }
+
+            std::vector<int> v;
+            segmented::copy(q.begin(), q.end(), std::back_inserter(v));
+            EXPECT_INTEQ(v.size(), size);
+            EXPECT(segmented::equal(q.begin(), q.end(), v.begin()));
+            EXPECT(segmented::equal(v.begin(), v.end(), q.begin()));
+
+            // Segmented input and output with different wraparound
+            // points.
+            inline_deque<int, 8> out = make_queue(size, 7 - offset);
+            segmented::transform(q.begin(), q.end(), out.begin(),
+                                 [](int e) { return e * 3; });
+            for (int i = 0; i < size; ++i) {
+                EXPECT_INTEQ(out[i], i * 3);
+            }
+            EXPECT(!segmented::equal(q.begin(), q.end(), out.begin()) ||
+                   size <= 1);
+            auto end = segmented::copy(q.begin(), q.end(), out.begin());
+            EXPECT(end == out.end());
+            EXPECT(segmented::equal(q.begin(), q.end(), out.begin()));
+            EXPECT(segmented::equal(out.begin(), out.end(), q.begin()));
+        }
+    }
+
+    return true;
+}
+
+bool test_algorithms_non_trivial() {
+    inline_deque<std::string, 2> q;
+    q.push_back("b");
+    q.push_back("c");
+    q.push_front("a");
+
+    EXPECT_STREQ(segmented::accumulate(q.begin(), q.end(), std::string()),
+                 "abc");
+    std::vector<std::string> v(3);
+    segmented::copy(q.begin(), q.end(), v.begin());
+    EXPECT_STREQ(v[2], "c");
+
+    return true;
+}
+
+bool test_std_algorithms() {
+    // The iterators should work with the standard algorithms too.
+    inline_deque<int, 8> q = make_queue(8, 5);
+
+    EXPECT_INTEQ(std::accumulate(q.begin(), q.end(), 0), 28);
+    EXPECT_INTEQ((std::find(q.begin(), q.end(), 3) - q.begin()), 3);
+    EXPECT_INTEQ(std::distance(q.begin(), q.end()), 8);
+
+    // Dereferencing doesn't modify the iterator, so works through a
+    // const iterator object too.
+    const inline_deque<int, 8>::iterator it = q.begin() + 2;
+    EXPECT_INTEQ(*it, 2);
+    EXPECT_INTEQ(it[3], 5);
+    it[3] = 10;
+    EXPECT_INTEQ(q[5], 10);
+    const inline_deque<int, 8>::const_iterator cit = q.cbegin();
+    EXPECT_INTEQ(cit[5], 10);
+
+    return true;
+}
+
+bool test_pass_through() {
+    // Non-segmented iterators, including plain pointers, are passed
+    // through to the standard algorithms.
+    int a[] = { 0, 1, 2, 3, 4 };
+    const int* p = a;
+
+    int sum = 0;
+    segmented::for_each(a, a + 5, [&sum](int& e) { sum += e; });
+    EXPECT_INTEQ(sum, 10);
+    EXPECT_INTEQ(segmented::accumulate(p, p + 5, 0), 10);
+    EXPECT_INTEQ(segmented::accumulate(p, p + 5, 1,
+                                       [](int x, int y) {
+                                           return x + 2 * y;
+                                       }),
+                 21);
+    EXPECT_INTEQ((segmented::find(a, a + 5, 3) - a), 3);
+    EXPECT_INTEQ((segmented::find(p, p + 5, 7) - p), 5);
+    EXPECT_INTEQ((segmented::find_if(p, p + 5,
+                                     [](int e) { return e > 1; }) - p),
+                 2);
+
+    int b[5];
+    EXPECT(segmented::copy(p, p + 5, b) == b + 5);
+    EXPECT(segmented::equal(p, p + 5, b));
+    EXPECT(segmented::transform(p, p + 5, b,
+                                [](int e) { return e * 3; }) == b + 5);
+    EXPECT_INTEQ(b[4], 12);
+    EXPECT(!segmented::equal(p, p + 5, b));
+
+    // Plain pointer input with a segmented output or second input.
+    inline_deque<int, 8> q = make_queue(5, 6);
+    EXPECT(segmented::equal(p, p + 5, q.begin()));
+    EXPECT(segmented::transform(p, p + 5, q.begin(),
+                                [](int e) { return e * 3; }) == q.end());
+    EXPECT(segmented::equal(q.begin(), q.end(), b));
+    EXPECT(segmented::copy(p, p + 5, q.begin()) == q.end());
+    EXPECT(segmented::equal(q.begin(), q.end(), p));
+
+    return true;
+}
+
+int main(void) {
+    bool ok = true;
+
+    TEST(test_segments);
+    TEST(test_algorithms);
+    TEST(test_algorithms_non_trivial);
+    TEST(test_std_algorithms);
+    TEST(test_pass_through);
+
+    return !ok;
+}
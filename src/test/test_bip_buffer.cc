@@ -0,0 +1,242 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+
+#include <cstring>
+#include <deque>
+#include <random>
+
+#include "../bip_buffer.h"
+#include "../inline_deque_allocator.h"
+
+#include "util_test.h"
+
+typedef bip_buffer<16> buffer;
+typedef bip_buffer<1, uint16_t, realloc_allocator<char>> realloc_buffer;
+typedef bip_buffer<0, uint16_t> heap_buffer;
+
+bool test_padding() {
+    buffer b;
+    EXPECT_INTEQ(b.capacity(), 16);
+
+    char* p = b.reserve_contiguous(10);
+    memcpy(p, "0123456789", 10);
+    b.commit_back(10);
+    b.consume_front(6);
+    EXPECT_INTEQ(b.size(), 4);
+
+    // 6 bytes left at the end of the storage, 6 at the start. An 8 byte
+    // reservation doesn't fit in either, so the buffer grows.
+    p = b.reserve_contiguous(8);
+    EXPECT_INTEQ(b.capacity(), 32);
+    b.commit_back(0);
+
+    // 4 bytes of data at the start of the storage; 28 after it. Fill
+    // up the end, free up the start, and make a reservation that
+    // only fits at the start.
+    p = b.reserve_contiguous(26);
+    memset(p, 'a', 26);
+    b.commit_back(26);
+    b.consume_front(8);
+    EXPECT_INTEQ(b.size(), 22);
+    p = b.reserve_contiguous(5);
+    EXPECT(p == b.peek_contiguous().data - 8);
+    EXPECT_INTEQ(b.capacity(), 32);
+    memcpy(p, "bcdef", 5);
+    b.commit_back(5);
+    // The 2 bytes at the end of the storage are padding.
+    EXPECT_INTEQ(b.size(), 27);
+
+    buffer::segment s = b.peek_contiguous();
+    EXPECT_INTEQ(s.size, 22);
+    b.consume_front(s.size);
+    s = b.peek_contiguous();
+    EXPECT_INTEQ(s.size, 5);
+    EXPECT(memcmp(s.data, "bcdef", 5) == 0);
+
+    // Consuming across the padding.
+    b.reserve_contiguous(10);
+    b.commit_back(10);
+    b.consume_front(1);
+    EXPECT_INTEQ(b.size(), 14);
+
+    EXPECT_THROW(b.consume_front(15), std::out_of_range);
+    b.reserve_contiguous(4);
+    EXPECT_THROW(b.commit_back(5), std::out_of_range);
+    b.commit_back(4);
+    EXPECT_THROW(b.commit_back(1), std::out_of_range);
+
+    b.clear();
+    EXPECT(b.empty());
+    EXPECT_INTEQ(b.peek_contiguous().size, 0);
+
+    return true;
+}
+
+bool test_empty_restart() {
+    buffer b;
+    b.reserve_contiguous(12);
+    b.commit_back(12);
+    b.consume_front(12);
+    // An empty buffer starts over at the start of the storage without
+    // padding or growing.
+    char* p = b.reserve_contiguous(16);
+    EXPECT_INTEQ(b.capacity(), 16);
+    memset(p, 'x', 16);
+    b.commit_back(16);
+    EXPECT_INTEQ(b.size(), 16);
+    EXPECT_INTEQ(b.peek_contiguous().size, 16);
+
+    return true;
+}
+
+// Random reservations and reads, checked against the stream of bytes
+// written. Each commit must be readable as a single region.
+template<class B>
+bool check_random(uint32_t seed) {
+    B b;
+    std::mt19937 rand(seed);
+    std::deque<size_t> commits;
+    uint32_t written = 0;
+    uint32_t read = 0;
+
+    for (int i = 0; i < 20000; ++i) {
+        uint32_t r = rand();
+        if (r % 2) {
+            size_t n = 1 + (r >> 8) % (r % 3 ? 20 : 200);
+            char* p = b.reserve_contiguous(n);
+            size_t k = (r >> 16) % (n + 1);
+            for (size_t j = 0; j < k; ++j) {
+                p[j] = written++;
+            }
+            b.commit_back(k);
+            if (k) {
+                commits.push_back(k);
+            }
+        } else if (!b.empty()) {
+            typename B::const_segment s =
+                static_cast<const B&>(b).peek_contiguous();
+            EXPECT(s.size >= commits.front());
+            size_t k = 1 + (r >> 8) % s.size;
+            for (size_t j = 0; j < k; ++j) {
+                EXPECT_INTEQ(uint8_t(s.data[j]), uint8_t(read++));
+            }
+            b.consume_front(k);
+            while (k) {
+                size_t c = std::min(k, commits.front());
+                k -= c;
+                commits.front() -= c;
+                if (!commits.front()) {
+                    commits.pop_front();
+                }
+            }
+        }
+        EXPECT_INTEQ(b.size(), (written - read));
+        EXPECT(b.capacity() <= 1024);
+    }
+
+    return true;
+}
+
+bool test_random() {
+    EXPECT(check_random<buffer>(1));
+    EXPECT(check_random<buffer>(2));
+    EXPECT(check_random<bip_buffer<0>>(3));
+    EXPECT(check_random<realloc_buffer>(4));
+
+    return true;
+}
+
+// Small random reservations and reads on a small buffer, checked
+// byte by byte against a model, over many seeds. Each run grows the
+// buffer while padding is pending, and wraps again afterwards.
+template<class B>
+bool check_model(uint32_t seed) {
+    B b;
+    std::deque<char> expect;
+    std::mt19937 rand(seed);
+    char next = 0;
+
+    for (int i = 0; i < 2000; ++i) {
+        uint32_t r = rand();
+        if (r % 2) {
+            size_t n = 1 + (r >> 8) % 12;
+            char* p = b.reserve_contiguous(n);
+            size_t k = (r >> 16) % (n + 1);
+            for (size_t j = 0; j < k; ++j) {
+                p[j] = next;
+                expect.push_back(next++);
+            }
+            b.commit_back(k);
+        } else if (!b.empty()) {
+            typename B::segment s = b.peek_contiguous();
+            EXPECT(s.size > 0);
+            EXPECT(s.size <= expect.size());
+            for (size_t j = 0; j < s.size; ++j) {
+                EXPECT_INTEQ(s.data[j], expect[j]);
+            }
+            size_t k = 1 + (r >> 8) % expect.size();
+            b.consume_front(k);
+            expect.erase(expect.begin(), expect.begin() + k);
+        }
+        EXPECT_INTEQ(b.size(), expect.size());
+        if (expect.size() > 40) {
+            size_t k = expect.size() - 8;
+            b.consume_front(k);
+            expect.erase(expect.begin(), expect.begin() + k);
+        }
+    }
+
+    return true;
+}
+
+bool test_model() {
+    for (uint32_t seed = 0; seed < 200; ++seed) {
+        EXPECT(check_model<buffer>(seed));
+        EXPECT(check_model<heap_buffer>(seed));
+        EXPECT(check_model<realloc_buffer>(seed));
+    }
+
+    return true;
+}
+
+bool test_move() {
+    buffer a;
+    a.reserve_contiguous(12);
+    a.commit_back(12);
+    a.consume_front(8);
+    char* p = a.reserve_contiguous(10);
+    memcpy(p, "0123456789", 10);
+    a.commit_back(10);
+    EXPECT_INTEQ(a.size(), 14);
+
+    buffer copy(a);
+    buffer b(std::move(a));
+    EXPECT(a.empty());
+    EXPECT_INTEQ(a.size(), 0);
+    for (buffer* q : { &b, &copy }) {
+        EXPECT_INTEQ(q->size(), 14);
+        q->consume_front(4);
+        buffer::segment s = q->peek_contiguous();
+        EXPECT_INTEQ(s.size, 10);
+        EXPECT(memcmp(s.data, "0123456789", 10) == 0);
+    }
+
+    a = std::move(b);
+    EXPECT_INTEQ(a.size(), 10);
+    EXPECT_INTEQ(b.size(), 0);
+
+    return true;
+}
+
+int main(void) {
+    bool ok = true;
+    TEST(test_padding);
+    TEST(test_empty_restart);
+    TEST(test_random);
+    TEST(test_model);
+    TEST(test_move);
+
+    return !ok;
+}
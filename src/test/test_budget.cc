@@ -0,0 +1,210 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+
+#include "../inline_deque.h"
+#include "../inline_deque_allocator.h"
+#include "../inline_deque_budget.h"
+
+#include "util_test.h"
+
+typedef budget_allocator<uint32_t> allocator;
+typedef inline_deque<uint32_t, 4, uint32_t, allocator> budget_queue;
+
+static budget_queue make_queue(inline_deque_budget* budget,
+                               uint64_t account) {
+    return budget_queue(4, allocator(budget, account));
+}
+
+bool test_accounting() {
+    inline_deque_budget budget;
+    {
+        budget_queue a = make_queue(&budget, 1);
+        budget_queue b = make_queue(&budget, 2);
+        budget_queue c = make_queue(&budget, 2);
+
+        // Inline storage is free.
+        for (uint32_t i = 0; i < 4; ++i) {
+            a.push_back(i);
+        }
+        EXPECT_INTEQ(budget.used(), 0);
+        EXPECT_INTEQ(budget.accounts(), 0);
+
+        a.push_back(4);
+        EXPECT_INTEQ(budget.used(), (8 * 4));
+        EXPECT_INTEQ(budget.used(1), (8 * 4));
+        for (uint32_t i = 0; i < 100; ++i) {
+            b.push_back(i);
+            c.push_back(i);
+        }
+        EXPECT_INTEQ(budget.used(2), (2 * 128 * 4));
+        EXPECT_INTEQ(budget.used(), (8 * 4 + 2 * 128 * 4));
+        EXPECT_INTEQ(budget.accounts(), 2);
+
+        // A copy charges the same account.
+        budget_queue d(a);
+        EXPECT_INTEQ(budget.used(1), (2 * 8 * 4));
+
+        std::vector<std::pair<uint64_t, size_t>> top = budget.largest(1);
+        EXPECT_INTEQ(top.size(), 1);
+        EXPECT_INTEQ(top[0].first, 2);
+        EXPECT_INTEQ(top[0].second, (2 * 128 * 4));
+        top = budget.largest(10);
+        EXPECT_INTEQ(top.size(), 2);
+        EXPECT_INTEQ(top[1].first, 1);
+
+        b.clear();
+        b.shrink_to_fit();
+        EXPECT_INTEQ(budget.used(2), (128 * 4));
+    }
+    EXPECT_INTEQ(budget.used(), 0);
+    EXPECT_INTEQ(budget.accounts(), 0);
+
+    // Without a budget, nothing is charged anywhere.
+    budget_queue q;
+    for (uint32_t i = 0; i < 100; ++i) {
+        q.push_back(i);
+    }
+    EXPECT_INTEQ(q.size(), 100);
+
+    return true;
+}
+
+bool test_hard_limit() {
+    // While a queue is resized, both the old and the new storage are
+    // charged.
+    inline_deque_budget budget(SIZE_MAX, 1024 + 512);
+    budget_queue q = make_queue(&budget, 1);
+    for (uint32_t i = 0; i < 256; ++i) {
+        q.push_back(i);
+    }
+    EXPECT_INTEQ(budget.used(), 1024);
+    EXPECT_THROW(q.push_back(256), std::bad_alloc);
+
+    // The queue is unchanged.
+    EXPECT_INTEQ(q.size(), 256);
+    EXPECT_INTEQ(q.capacity(), 256);
+    EXPECT_INTEQ(budget.used(), 1024);
+    for (uint32_t i = 0; i < 256; ++i) {
+        EXPECT_INTEQ(q[i], i);
+    }
+
+    // The callback can free memory from other queues.
+    budget.set_hard_limit(4096);
+    budget_queue victim = make_queue(&budget, 2);
+    for (uint32_t i = 0; i < 512; ++i) {
+        victim.push_back(i);
+    }
+    EXPECT_INTEQ(budget.used(), 3072);
+    size_t requested = 0;
+    uint64_t evicted = 0;
+    budget.on_hard_limit([&](inline_deque_budget& b, size_t bytes) {
+            requested = bytes;
+            evicted = b.largest(1)[0].first;
+            victim = budget_queue(4, allocator(&budget, 2));
+        });
+    q.push_back(256);
+    EXPECT_INTEQ(requested, 2048);
+    EXPECT_INTEQ(evicted, 2);
+    EXPECT_INTEQ(budget.used(), 2048);
+    EXPECT(victim.empty());
+    EXPECT_INTEQ(q.back(), 256);
+
+    return true;
+}
+
+bool test_soft_limit() {
+    inline_deque_budget budget(2000);
+    std::vector<bool> events;
+    budget.on_soft_limit([&](inline_deque_budget& b, bool above) {
+            events.push_back(above == b.over_soft_limit());
+            events.push_back(above);
+        });
+    budget_queue q = make_queue(&budget, 1);
+    for (uint32_t i = 0; i < 200; ++i) {
+        q.push_back(i);
+    }
+    EXPECT_INTEQ(events.size(), 0);
+    for (uint32_t i = 200; i < 300; ++i) {
+        q.push_back(i);
+    }
+    EXPECT(budget.over_soft_limit());
+    EXPECT_INTEQ(events.size(), 2);
+    EXPECT(events[0]);
+    EXPECT(events[1]);
+    for (uint32_t i = 300; i < 1000; ++i) {
+        q.push_back(i);
+    }
+    EXPECT_INTEQ(events.size(), 2);
+    while (q.size() > 10) {
+        q.pop_back();
+    }
+    EXPECT(!budget.over_soft_limit());
+    EXPECT_INTEQ(events.size(), 4);
+    EXPECT(events[2]);
+    EXPECT(!events[3]);
+
+    return true;
+}
+
+bool test_reallocate() {
+    typedef budget_allocator<uint64_t, realloc_allocator<uint64_t>>
+        realloc_budget_allocator;
+    static_assert(inline_deque_detail::has_reallocate<
+                      realloc_budget_allocator, uint64_t>::value,
+                  "reallocate() with a Base that has it");
+    static_assert(!inline_deque_detail::has_reallocate<
+                      budget_allocator<uint64_t>, uint64_t>::value,
+                  "No reallocate() with a Base that doesn't");
+
+    inline_deque_budget budget;
+    {
+        inline_deque<uint64_t, 1, uint32_t, realloc_budget_allocator> q(
+            1, realloc_budget_allocator(&budget, 7));
+        for (uint64_t i = 0; i < 1000; ++i) {
+            q.push_back(i);
+        }
+        EXPECT_INTEQ(budget.used(7), (1024 * 8));
+        while (q.size() > 100) {
+            q.pop_back();
+        }
+        EXPECT_INTEQ(budget.used(7), (q.capacity() * 8));
+    }
+    EXPECT_INTEQ(budget.used(), 0);
+
+    return true;
+}
+
+bool test_release_by_hand() {
+    inline_deque_budget budget;
+    budget.charge(1, 100);
+    // Releasing from an account with nothing (or not enough) charged
+    // is an error, and changes nothing.
+    EXPECT_THROW(budget.release(2, 10), std::out_of_range);
+    EXPECT_THROW(budget.release(1, 101), std::out_of_range);
+    EXPECT_INTEQ(budget.used(), 100);
+    EXPECT_INTEQ(budget.used(1), 100);
+    EXPECT_INTEQ(budget.accounts(), 1);
+
+    budget.release(1, 40);
+    EXPECT_INTEQ(budget.used(1), 60);
+    budget.release(1, 60);
+    EXPECT_INTEQ(budget.used(), 0);
+    EXPECT_INTEQ(budget.accounts(), 0);
+    EXPECT_THROW(budget.release(1, 1), std::out_of_range);
+    budget.release(3, 0);
+
+    return true;
+}
+
+int main(void) {
+    bool ok = true;
+    TEST(test_accounting);
+    TEST(test_hard_limit);
+    TEST(test_soft_limit);
+    TEST(test_reallocate);
+    TEST(test_release_by_hand);
+
+    return !ok;
+}
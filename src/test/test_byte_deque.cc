@@ -0,0 +1,177 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "../inline_byte_deque.h"
+
+#include "util_test.h"
+
+typedef inline_byte_deque<16> byte_queue;
+
+static std::string contents(const byte_queue& q) {
+    return std::string(q.begin(), q.end());
+}
+
+// Place the read and write pointers of an empty queue at "offset".
+static void rotate(byte_queue* q, int offset) {
+    for (int i = 0; i < offset; ++i) {
+        q->push_back('x');
+        q->pop_front();
+    }
+}
+
+bool test_pipe() {
+    int fds[2];
+    EXPECT(pipe(fds) == 0);
+
+    // Read into the inline storage, with the free space wrapping
+    // around the end of the storage.
+    for (int offset = 0; offset < 16; ++offset) {
+        byte_queue q;
+        rotate(&q, offset);
+        q.push_back('a');
+        EXPECT_INTEQ(write(fds[1], "bcdefghij", 9), 9);
+        EXPECT_INTEQ(q.read_from(fds[0], 9), 9);
+        EXPECT_INTEQ(q.capacity(), 16);
+        EXPECT(contents(q) == "abcdefghij");
+
+        // Partial read: less available than asked for.
+        EXPECT_INTEQ(write(fds[1], "klm", 3), 3);
+        EXPECT_INTEQ(q.read_from(fds[0], 6), 3);
+        EXPECT(contents(q) == "abcdefghijklm");
+        EXPECT_INTEQ(q.capacity(), 16);
+
+        // Write out of the two live segments.
+        EXPECT_INTEQ(q.write_to(fds[1], 4), 4);
+        EXPECT(contents(q) == "efghijklm");
+        EXPECT_INTEQ(q.write_to(fds[1]), 9);
+        EXPECT(q.empty());
+        EXPECT_INTEQ(q.write_to(fds[1]), 0);
+
+        char buf[32];
+        EXPECT_INTEQ(read(fds[0], buf, sizeof(buf)), 13);
+        EXPECT(std::string(buf, 13) == "abcdefghijklm");
+    }
+
+    // A read is limited to the free space, and only a full queue is
+    // grown.
+    {
+        byte_queue q;
+        rotate(&q, 5);
+        EXPECT_INTEQ(write(fds[1], "0123456789abcdefghij", 20), 20);
+        EXPECT_INTEQ(q.read_from(fds[0], 100), 16);
+        EXPECT_INTEQ(q.capacity(), 16);
+        EXPECT_INTEQ(q.read_from(fds[0], 100), 4);
+        EXPECT_INTEQ(q.capacity(), 128);
+        EXPECT(contents(q) == "0123456789abcdefghij");
+    }
+
+    // Reading more than fits grows the queue.
+    byte_queue q;
+    rotate(&q, 5);
+    std::string data;
+    for (int i = 0; i < 1000; ++i) {
+        data.push_back('0' + i % 10);
+    }
+    EXPECT_INTEQ(write(fds[1], data.data(), data.size()), 1000);
+    ssize_t total = 0;
+    while (total < 1000) {
+        ssize_t ret = q.read_from(fds[0], 100);
+        EXPECT(ret > 0);
+        total += ret;
+    }
+    EXPECT_INTEQ(q.capacity(), 1024);
+    EXPECT(contents(q) == data);
+
+    // End of file.
+    close(fds[1]);
+    EXPECT_INTEQ(q.read_from(fds[0]), 0);
+    EXPECT_INTEQ(q.size(), 1000);
+    close(fds[0]);
+
+    // Errors leave the contents unchanged, and a queue that isn't
+    // full keeps its capacity.
+    EXPECT_INTEQ(q.read_from(fds[0]), -1);
+    EXPECT_INTEQ(errno, EBADF);
+    EXPECT_INTEQ(q.write_to(fds[1]), -1);
+    EXPECT_INTEQ(errno, EBADF);
+    EXPECT(contents(q) == data);
+    EXPECT_INTEQ(q.capacity(), 1024);
+
+    // A full queue is grown before the read, even if it fails.
+    while (q.size() < q.capacity()) {
+        q.push_back('x');
+    }
+    EXPECT_INTEQ(q.read_from(fds[0]), -1);
+    EXPECT_INTEQ(q.size(), 1024);
+    EXPECT_INTEQ(q.capacity(), 8192);
+
+    return true;
+}
+
+bool test_socketpair_partial_write() {
+    int fds[2];
+    EXPECT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    EXPECT(fcntl(fds[0], F_SETFL, O_NONBLOCK) == 0);
+    EXPECT(fcntl(fds[1], F_SETFL, O_NONBLOCK) == 0);
+
+    // Nothing to read yet.
+    byte_queue in;
+    EXPECT_INTEQ(in.read_from(fds[1]), -1);
+    EXPECT_INTEQ(errno, EAGAIN);
+    EXPECT(in.empty());
+
+    // Write more than the socket buffer can take, so that writes are
+    // partial; every written byte must be removed exactly once.
+    byte_queue out;
+    rotate(&out, 7);
+    std::string data;
+    for (int i = 0; i < 4 * 1024 * 1024; ++i) {
+        data.push_back(i * 7 + i / 4096);
+    }
+    for (char c : data) {
+        out.push_back(c);
+    }
+    std::string received;
+    bool partial = false;
+    while (!out.empty() || received.size() < data.size()) {
+        size_t before = out.size();
+        ssize_t ret = out.write_to(fds[0]);
+        if (ret < 0) {
+            EXPECT_INTEQ(errno, EAGAIN);
+        } else {
+            EXPECT_INTEQ(out.size(), (before - ret));
+            if (ret > 0 && size_t(ret) < before) {
+                partial = true;
+            }
+        }
+        while ((ret = in.read_from(fds[1], 65536)) > 0) {
+        }
+        EXPECT(ret == -1 && errno == EAGAIN);
+        received.append(in.begin(), in.end());
+        in.clear();
+    }
+    EXPECT(partial);
+    EXPECT(received == data);
+
+    close(fds[0]);
+    close(fds[1]);
+
+    return true;
+}
+
+int main(void) {
+    bool ok = true;
+    TEST(test_pipe);
+    TEST(test_socketpair_partial_write);
+
+    return !ok;
+}
@@ -0,0 +1,158 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../frame_reader.h"
+#include "../inline_byte_deque.h"
+
+#include "util_test.h"
+
+typedef inline_byte_deque<16> byte_queue;
+typedef frame_reader<byte_queue> reader_type;
+
+static std::string encode(const std::string& payload, size_t header = 4) {
+    std::string ret;
+    for (size_t i = 0; i < header; ++i) {
+        ret.push_back(payload.size() >> (8 * (header - 1 - i)));
+    }
+    return ret + payload;
+}
+
+static void push(byte_queue* q, const std::string& data) {
+    for (char c : data) {
+        q->push_back(c);
+    }
+}
+
+static std::string str(const reader_type::frame& f) {
+    std::string ret;
+    for (int i = 0; i < f.count; ++i) {
+        ret.append(f.segments[i].data, f.segments[i].size);
+    }
+    return ret;
+}
+
+bool test_split() {
+    // Every position of the frame relative to the end of the storage,
+    // including the length prefix being split.
+    for (int offset = 0; offset < 16; ++offset) {
+        byte_queue q;
+        reader_type reader;
+        reader_type::frame f;
+        for (int i = 0; i < offset; ++i) {
+            q.push_back('x');
+            q.pop_front();
+        }
+        std::string data = encode("abcdefghij");
+        for (size_t i = 0; i < data.size(); ++i) {
+            EXPECT(!reader.next(q, &f));
+            q.push_back(data[i]);
+        }
+        EXPECT_INTEQ(q.capacity(), 16);
+        EXPECT(reader.next(q, &f));
+        EXPECT_INTEQ(f.size, 10);
+        EXPECT(str(f) == "abcdefghij");
+        // The payload starts at (offset + 4) % 16, so it's split unless
+        // it's entirely in the first or second lap.
+        int start = (offset + 4) % 16;
+        int expect_count = (start == 0 || start + 10 <= 16) ? 1 : 2;
+        EXPECT_INTEQ(f.count, expect_count);
+
+        const char* p = reader.contiguous(f);
+        EXPECT(std::string(p, f.size) == "abcdefghij");
+        if (expect_count == 1) {
+            // No copy.
+            EXPECT(p == f.segments[0].data);
+        }
+
+        reader.pop(q, f);
+        EXPECT(q.empty());
+        EXPECT(!reader.next(q, &f));
+    }
+
+    return true;
+}
+
+bool test_limits() {
+    byte_queue q;
+    reader_type reader(100);
+    reader_type::frame f;
+
+    push(&q, encode(""));
+    EXPECT(reader.next(q, &f));
+    EXPECT_INTEQ(f.size, 0);
+    EXPECT_INTEQ(f.count, 0);
+    reader.contiguous(f);
+    reader.pop(q, f);
+
+    push(&q, encode(std::string(101, 'a')).substr(0, 8));
+    EXPECT_THROW(reader.next(q, &f), std::length_error);
+    q.clear();
+
+    typedef frame_reader<byte_queue, uint16_t> reader16;
+    reader16 short_reader;
+    reader16::frame f16;
+    std::string payload(300, 'b');
+    push(&q, encode(payload, 2));
+    EXPECT(short_reader.next(q, &f16));
+    EXPECT_INTEQ(f16.size, 300);
+    EXPECT(std::string(short_reader.contiguous(f16), f16.size) == payload);
+
+    return true;
+}
+
+// Frames of random sizes arriving in chunks of random sizes, with
+// the queue wrapping around.
+bool test_stream() {
+    std::mt19937 rand(1);
+    std::string input;
+    std::vector<std::string> frames;
+    for (int i = 0; i < 2000; ++i) {
+        uint32_t r = rand();
+        std::string payload(r % (r % 8 ? 20 : 500), 0);
+        for (size_t j = 0; j < payload.size(); ++j) {
+            payload[j] = 'a' + (i + j) % 26;
+        }
+        frames.push_back(payload);
+        input += encode(payload);
+    }
+
+    byte_queue q;
+    reader_type reader;
+    reader_type::frame f;
+    size_t pos = 0;
+    size_t next_frame = 0;
+    int split = 0;
+    while (pos < input.size()) {
+        size_t chunk = std::min<size_t>(1 + rand() % 64, input.size() - pos);
+        push(&q, input.substr(pos, chunk));
+        pos += chunk;
+        while (reader.next(q, &f)) {
+            EXPECT(str(f) == frames[next_frame]);
+            EXPECT(std::string(reader.contiguous(f), f.size) ==
+                   frames[next_frame]);
+            split += f.count == 2;
+            reader.pop(q, f);
+            ++next_frame;
+        }
+    }
+    EXPECT_INTEQ(next_frame, frames.size());
+    EXPECT(q.empty());
+    EXPECT(split > 0);
+
+    return true;
+}
+
+int main(void) {
+    bool ok = true;
+    TEST(test_split);
+    TEST(test_limits);
+    TEST(test_stream);
+
+    return !ok;
+}
@@ -0,0 +1,160 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+
+#include <deque>
+#include <random>
+
+#include "../inline_deque.h"
+
+#include "util_test.h"
+
+// Queues without inline storage (InlineCapacity == 0) are just a
+// pointer, a capacity and the indices.
+static_assert(sizeof(inline_deque<uint64_t, 0>) ==
+              sizeof(void*) + 3 * sizeof(uint32_t) + 4,
+              "No inline storage");
+static_assert(sizeof(inline_deque<char, 0, uint16_t>) ==
+              sizeof(void*) + 3 * sizeof(uint16_t) + 2,
+              "No inline storage");
+
+bool test_empty() {
+    inline_deque<Value, 0> q;
+    EXPECT(q.empty());
+    EXPECT_INTEQ(q.capacity(), 0);
+    EXPECT(q.begin() == q.end());
+    EXPECT_THROW(q.front(), std::out_of_range);
+    EXPECT_THROW(q.pop_back(), std::out_of_range);
+    inline_deque<Value, 0>::segment segs[2];
+    EXPECT_INTEQ(q.segments(segs), 0);
+    EXPECT_INTEQ(q.make_contiguous().size, 0);
+    q.shrink_to_fit();
+    EXPECT_INTEQ(q.capacity(), 0);
+
+    inline_deque<Value, 0> copy(q);
+    EXPECT_INTEQ(copy.capacity(), 0);
+    inline_deque<Value, 0> moved(std::move(copy));
+    EXPECT_INTEQ(moved.capacity(), 0);
+    q = moved;
+    q = std::move(moved);
+    EXPECT(q.empty());
+
+    return true;
+}
+
+bool test_grow_shrink() {
+    Value::live_ = 0;
+    {
+        inline_deque<Value, 0> q;
+        for (int round = 0; round < 3; ++round) {
+            for (uint32_t i = 0; i < 100; ++i) {
+                q.push_back(Value(i));
+            }
+            EXPECT_INTEQ(q.capacity(), 128);
+            for (uint32_t i = 0; i < 100; ++i) {
+                EXPECT_INTEQ(q.front(), i);
+                q.pop_front();
+            }
+            EXPECT(q.empty());
+            // Shrinks all the way back to no allocation.
+            q.shrink_to_fit();
+            EXPECT_INTEQ(q.capacity(), 0);
+        }
+
+        q.push_front(Value(1));
+        q.push_front(Value(0));
+        inline_deque<Value, 0> copy(q);
+        inline_deque<Value, 0> moved(std::move(q));
+        EXPECT_INTEQ(q.capacity(), 0);
+        EXPECT(q.empty());
+        q.push_back(Value(5));
+        EXPECT_INTEQ(q.front(), 5);
+        EXPECT_INTEQ(copy[0], 0);
+        EXPECT_INTEQ(copy[1], 1);
+        EXPECT_INTEQ(moved[0], 0);
+        EXPECT_INTEQ(moved[1], 1);
+        copy.clear();
+        copy.shrink_to_fit();
+        EXPECT_INTEQ(copy.capacity(), 0);
+        copy = moved;
+        EXPECT_INTEQ(copy.size(), 2);
+    }
+    EXPECT_INTEQ(Value::live_, 0);
+
+    return true;
+}
+
+// Trivially copyable elements are relocated with memcpy(), which must
+// not be passed the NULL array of an empty queue (checked with
+// -fsanitize=undefined).
+bool test_grow_shrink_trivial() {
+    inline_deque<int, 0> q;
+    q.push_back(1);
+    EXPECT_INTEQ(q.capacity(), 1);
+    EXPECT_INTEQ(q.front(), 1);
+    q.pop_front();
+    q.shrink_to_fit();
+    EXPECT_INTEQ(q.capacity(), 0);
+    q.push_front(2);
+    EXPECT_INTEQ(q.front(), 2);
+    q.clear();
+    q.shrink_to_fit();
+    EXPECT_INTEQ(q.capacity(), 0);
+
+    return true;
+}
+
+bool test_random() {
+    std::mt19937 rand(1);
+    Value::live_ = 0;
+    {
+        inline_deque<Value, 0, uint16_t> q;
+        std::deque<uint32_t> expect;
+        for (int i = 0; i < 100000; ++i) {
+            uint32_t r = rand();
+            switch (r % 6) {
+            case 0:
+            case 1:
+                q.push_back(Value(r));
+                expect.push_back(r);
+                break;
+            case 2:
+                q.emplace_front(r);
+                expect.push_front(r);
+                break;
+            case 3:
+            case 4:
+                if (!expect.empty()) {
+                    q.pop_front();
+                    expect.pop_front();
+                }
+                break;
+            case 5:
+                if (!expect.empty()) {
+                    q.pop_back();
+                    expect.pop_back();
+                }
+                break;
+            }
+            EXPECT_INTEQ(q.size(), expect.size());
+            if (!expect.empty()) {
+                size_t j = r % expect.size();
+                EXPECT_INTEQ(q[j], expect[j]);
+            }
+        }
+    }
+    EXPECT_INTEQ(Value::live_, 0);
+
+    return true;
+}
+
+int main(void) {
+    bool ok = true;
+    TEST(test_empty);
+    TEST(test_grow_shrink);
+    TEST(test_grow_shrink_trivial);
+    TEST(test_random);
+
+    return !ok;
+}
@@ -0,0 +1,77 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+
+#include "../inline_deque.h"
+#include "../inline_deque_allocator.h"
+
+#include "util_test.h"
+
+static bool huge_page_aligned(const void* p) {
+    return reinterpret_cast<uintptr_t>(p) % (2 * 1024 * 1024) == 0;
+}
+
+template<typename Q>
+bool check_large() {
+    Q q;
+    for (uint64_t i = 0; i < (1 << 20); ++i) {
+        q.push_back(i);
+    }
+    // The queue was never wrapped, so the first element is at the
+    // start of the buffer.
+    EXPECT(huge_page_aligned(&q[0]));
+    EXPECT_INTEQ(q.capacity(), (1 << 20));
+    for (uint64_t i = 0; i < (1 << 20); ++i) {
+        EXPECT_INTEQ(q[i], i);
+    }
+
+    return true;
+}
+
+bool test_large() {
+    EXPECT((check_large<inline_deque<uint64_t, 1, uint32_t,
+                                     hugepage_allocator<uint64_t>>>()));
+    EXPECT((check_large<inline_deque<uint64_t, 1, uint32_t,
+                                     hugepage_allocator<uint64_t,
+                                                        2 * 1024 * 1024,
+                                                        true>>>()));
+
+    return true;
+}
+
+// Grow a queue past the threshold and shrink it back, so that the
+// buffer moves between malloc() and mmap() in both directions.
+bool test_threshold() {
+    typedef hugepage_allocator<Value, 4096> allocator;
+    EXPECT(!allocator::use_huge_pages(4095));
+    EXPECT(allocator::use_huge_pages(4096));
+
+    Value::live_ = 0;
+    {
+        inline_deque<Value, 4, uint32_t, allocator> q;
+        for (int round = 0; round < 3; ++round) {
+            for (uint32_t i = 0; i < 10000; ++i) {
+                q.push_back(Value(i));
+            }
+            EXPECT(huge_page_aligned(&q[0]));
+            for (uint32_t i = 10000; i > 0; --i) {
+                EXPECT_INTEQ(q.back(), (i - 1));
+                q.pop_back();
+            }
+            EXPECT(q.empty());
+            EXPECT(q.capacity() < 4096 / sizeof(Value));
+        }
+    }
+    EXPECT_INTEQ(Value::live_, 0);
+
+    return true;
+}
+
+int main(void) {
+    bool ok = true;
+    TEST(test_large);
+    TEST(test_threshold);
+
+    return !ok;
+}
@@ -0,0 +1,315 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+
+#include <algorithm>
+#include <deque>
+#include <random>
+
+#include "../hybrid_deque.h"
+
+#include "util_test.h"
+
+// Small thresholds and blocks, so that the tests cover the mode
+// switches and block boundaries with small queues.
+typedef hybrid_deque<Value, 4, uint32_t, std::allocator<Value>, 64, 16>
+    small_hybrid;
+
+static_assert(hybrid_deque<uint32_t>::kBlockSize == 1024,
+              "4KB blocks for small elements");
+static_assert(hybrid_deque<char[1000]>::kBlockSize == 16,
+              "At least 16 elements per block");
+
+template<typename Q, typename E>
+bool check_equal(const Q& q, const E& expect) {
+    EXPECT_INTEQ(q.size(), expect.size());
+    for (size_t i = 0; i < expect.size(); ++i) {
+        EXPECT_INTEQ(q[i], expect[i]);
+    }
+    size_t i = 0;
+    for (auto it = q.begin(); it != q.end(); ++it, ++i) {
+        EXPECT_INTEQ(*it, expect[i]);
+    }
+    if (!expect.empty()) {
+        EXPECT_INTEQ(q.front(), expect.front());
+        EXPECT_INTEQ(q.back(), expect.back());
+    }
+    return true;
+}
+
+bool test_mode_switch() {
+    Value::live_ = 0;
+    {
+        small_hybrid q;
+        std::deque<uint32_t> expect;
+        for (uint32_t i = 0; i < 64; ++i) {
+            q.push_back(Value(i));
+            expect.push_back(i);
+            EXPECT(!q.chunked());
+        }
+        q.push_back(Value(64));
+        expect.push_back(64);
+        EXPECT(q.chunked());
+        EXPECT(check_equal(q, expect));
+
+        for (uint32_t i = 0; i < 100; ++i) {
+            q.push_front(Value(1000 + i));
+            expect.push_front(1000 + i);
+            q.push_back(Value(2000 + i));
+            expect.push_back(2000 + i);
+        }
+        EXPECT(check_equal(q, expect));
+
+        // Shrinking to just below the threshold doesn't switch back.
+        while (expect.size() > 16) {
+            EXPECT(q.chunked());
+            if (expect.size() % 3) {
+                q.pop_front();
+                expect.pop_front();
+            } else {
+                q.pop_back();
+                expect.pop_back();
+            }
+            EXPECT(check_equal(q, expect));
+        }
+        q.pop_back();
+        expect.pop_back();
+        EXPECT(!q.chunked());
+        EXPECT(check_equal(q, expect));
+
+        while (!expect.empty()) {
+            q.pop_front();
+            expect.pop_front();
+        }
+        EXPECT(q.empty());
+        EXPECT_THROW(q.pop_front(), std::out_of_range);
+        EXPECT_THROW(q.front(), std::out_of_range);
+    }
+    EXPECT_INTEQ(Value::live_, 0);
+
+    return true;
+}
+
+// In the chunked representation, pushes and pops at the ends don't
+// move other elements.
+bool test_stable_references() {
+    small_hybrid q;
+    for (uint32_t i = 0; i < 100; ++i) {
+        q.push_back(Value(i));
+    }
+    EXPECT(q.chunked());
+    Value* p = &q[50];
+    Value::Counts before = Value::counts_;
+    for (uint32_t i = 0; i < 1000; ++i) {
+        q.push_front(Value(i));
+        q.push_back(Value(i));
+    }
+    for (uint32_t i = 0; i < 1000; ++i) {
+        q.pop_front();
+        q.pop_back();
+    }
+    Value::Counts work = Value::counts_ - before;
+    // One move per push of a temporary, nothing else.
+    EXPECT_INTEQ(work.moves, 2000);
+    EXPECT(p == &q[50]);
+    EXPECT_INTEQ(*p, 50);
+
+    return true;
+}
+
+bool test_copy_move() {
+    Value::live_ = 0;
+    {
+        small_hybrid q;
+        std::deque<uint32_t> expect;
+        for (uint32_t i = 0; i < 100; ++i) {
+            q.push_back(Value(i));
+            expect.push_back(i);
+        }
+        small_hybrid copy(q);
+        EXPECT(copy.chunked());
+        EXPECT(check_equal(copy, expect));
+
+        small_hybrid moved(std::move(q));
+        EXPECT(moved.chunked());
+        EXPECT(check_equal(moved, expect));
+        EXPECT(q.empty());
+        EXPECT(!q.chunked());
+
+        small_hybrid small;
+        small.push_back(Value(1));
+        q = small;
+        EXPECT_INTEQ(q.size(), 1);
+        q = moved;
+        EXPECT(check_equal(q, expect));
+        small = std::move(moved);
+        EXPECT(check_equal(small, expect));
+        moved = std::move(copy);
+        EXPECT(check_equal(moved, expect));
+
+        q.clear();
+        EXPECT(q.empty());
+        EXPECT(!q.chunked());
+        q.push_back(Value(5));
+        EXPECT_INTEQ(q.front(), 5);
+    }
+    EXPECT_INTEQ(Value::live_, 0);
+
+    return true;
+}
+
+bool test_random() {
+    std::mt19937 rand(1);
+    Value::live_ = 0;
+    {
+        small_hybrid q;
+        std::deque<uint32_t> expect;
+        for (int i = 0; i < 200000; ++i) {
+            uint32_t r = rand();
+            // Drift up and down across the thresholds.
+            bool grow = (i / 1000) % 2 == 0;
+            switch (r % 5) {
+            case 0:
+            case 1:
+                if (grow || r % 3 == 0) {
+                    q.push_back(Value(r));
+                    expect.push_back(r);
+                }
+                break;
+            case 2:
+                if (grow) {
+                    q.emplace_front(r);
+                    expect.push_front(r);
+                }
+                break;
+            case 3:
+                if (!expect.empty()) {
+                    q.pop_front();
+                    expect.pop_front();
+                }
+                break;
+            case 4:
+                if (!expect.empty()) {
+                    q.pop_back();
+                    expect.pop_back();
+                }
+                break;
+            }
+            if (!expect.empty()) {
+                EXPECT_INTEQ(q.front(), expect.front());
+                EXPECT_INTEQ(q.back(), expect.back());
+                size_t j = r % expect.size();
+                EXPECT_INTEQ(q.at(j), expect[j]);
+            }
+            EXPECT_INTEQ(q.size(), expect.size());
+            EXPECT_INTEQ(Value::live_, expect.size());
+        }
+        EXPECT(check_equal(q, expect));
+    }
+    EXPECT_INTEQ(Value::live_, 0);
+
+    return true;
+}
+
+// A failed switch to the chunked representation leaves the queue as
+// it was, without leaking any blocks.
+bool test_chunk_failure() {
+    typedef hybrid_deque<Value, 4, uint32_t, failing_allocator<Value>, 64, 16>
+        failing_hybrid;
+    Value::live_ = 0;
+    // Switching 64 elements takes 4 blocks, and the push one more.
+    for (int budget = 0; budget <= 5; ++budget) {
+        {
+            failing_hybrid q;
+            for (uint32_t i = 0; i < 64; ++i) {
+                q.push_back(Value(i));
+            }
+            EXPECT(!q.chunked());
+            int allocations = live_allocations;
+            alloc_budget = budget;
+            if (budget < 4) {
+                EXPECT_THROW(q.push_back(Value(64)), std::bad_alloc);
+                EXPECT(!q.chunked());
+                EXPECT_INTEQ(live_allocations, allocations);
+            } else if (budget == 4) {
+                EXPECT_THROW(q.push_back(Value(64)), std::bad_alloc);
+                EXPECT(q.chunked());
+            } else {
+                q.push_back(Value(64));
+                EXPECT(q.chunked());
+            }
+            alloc_budget = -1;
+            EXPECT_INTEQ(q.size(), (budget < 5 ? 64 : 65));
+            for (uint32_t i = 0; i < q.size(); ++i) {
+                EXPECT_INTEQ(q[i], i);
+            }
+            q.push_front(Value(100));
+            EXPECT(q.chunked());
+            EXPECT_INTEQ(q.front(), 100);
+            for (uint32_t i = 1; i < q.size(); ++i) {
+                EXPECT_INTEQ(q[i], i - 1);
+            }
+        }
+        EXPECT_INTEQ(Value::live_, 0);
+        EXPECT_INTEQ(live_allocations, 0);
+    }
+
+    return true;
+}
+
+bool test_max_size() {
+    hybrid_deque<uint32_t, 1, uint8_t, std::allocator<uint32_t>, 16, 16> q;
+    for (uint32_t i = 0; i < q.max_size(); ++i) {
+        q.push_back(i);
+    }
+    EXPECT(q.chunked());
+    EXPECT_THROW(q.push_back(0), std::length_error);
+    EXPECT_THROW(q.push_front(0), std::length_error);
+    EXPECT_INTEQ(q.size(), 128);
+    EXPECT_INTEQ(q.back(), 127);
+
+    return true;
+}
+
+// The iterators are random access, with the full set of comparisons.
+bool test_iterators() {
+    typedef hybrid_deque<uint32_t, 4, uint32_t, std::allocator<uint32_t>,
+                         64, 16> small_hybrid32;
+    typedef small_hybrid32 queue;
+    queue q;
+    for (uint32_t i = 0; i < 300; ++i) {
+        q.push_back(i * 37 % 300);
+    }
+    std::sort(q.begin(), q.end());
+    for (uint32_t i = 0; i < 300; ++i) {
+        EXPECT_INTEQ(q[i], i);
+    }
+
+    queue::iterator a = q.begin() + 10;
+    queue::iterator b = 20 + q.begin();
+    EXPECT(a < b && b > a && a <= b && b >= a && a <= a && a >= a);
+    EXPECT(!(b < a) && !(a > b) && !(b <= a) && !(a >= b));
+    EXPECT(b - a == 10);
+    EXPECT_INTEQ(a[5], 15);
+
+    queue::const_iterator c = a;
+    EXPECT(c == q.cbegin() + 10);
+    EXPECT(q.cend() - c == 290);
+    EXPECT_INTEQ(*std::lower_bound(q.cbegin(), q.cend(), 42u), 42);
+
+    return true;
+}
+
+int main(void) {
+    bool ok = true;
+    TEST(test_mode_switch);
+    TEST(test_stable_references);
+    TEST(test_copy_move);
+    TEST(test_random);
+    TEST(test_chunk_failure);
+    TEST(test_max_size);
+    TEST(test_iterators);
+
+    return !ok;
+}
@@ -0,0 +1,334 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <deque>
+#include <random>
+
+#include "../incremental_deque.h"
+
+#include "util_test.h"
+
+template<typename Q, typename E>
+bool check_equal(const Q& q, const E& expect) {
+    EXPECT_INTEQ(q.size(), expect.size());
+    for (size_t i = 0; i < expect.size(); ++i) {
+        EXPECT_INTEQ(q[i], expect[i]);
+    }
+    size_t i = 0;
+    for (auto it = q.begin(); it != q.end(); ++it, ++i) {
+        EXPECT_INTEQ(*it, expect[i]);
+    }
+    if (!expect.empty()) {
+        EXPECT_INTEQ(q.front(), expect.front());
+        EXPECT_INTEQ(q.back(), expect.back());
+    }
+    return true;
+}
+
+bool test_push_pop() {
+    Value::live_ = 0;
+    {
+        incremental_deque<Value> q;
+        std::deque<uint32_t> expect;
+        bool saw_migrating = false;
+        for (uint32_t i = 0; i < 1000; ++i) {
+            if (i % 3 == 0) {
+                q.push_front(Value(i));
+                expect.push_front(i);
+            } else {
+                q.push_back(Value(i));
+                expect.push_back(i);
+            }
+            saw_migrating |= q.migrating();
+            EXPECT(check_equal(q, expect));
+        }
+        EXPECT(saw_migrating);
+        while (!expect.empty()) {
+            if (expect.size() % 2) {
+                q.pop_front();
+                expect.pop_front();
+            } else {
+                q.pop_back();
+                expect.pop_back();
+            }
+            EXPECT(check_equal(q, expect));
+        }
+        EXPECT(!q.migrating());
+        EXPECT_THROW(q.pop_front(), std::out_of_range);
+        EXPECT_THROW(q.back(), std::out_of_range);
+    }
+    EXPECT_INTEQ(Value::live_, 0);
+
+    return true;
+}
+
+// Pop elements from both ends while a migration is in progress,
+// including the ones that haven't been migrated yet.
+bool test_pop_while_migrating() {
+    for (int pushes = 0; pushes < 8; ++pushes) {
+        Value::live_ = 0;
+        {
+            incremental_deque<Value, uint32_t, std::allocator<Value>, 1> q;
+            std::deque<uint32_t> expect;
+            for (uint32_t i = 0; i < 64; ++i) {
+                q.push_back(Value(i));
+                expect.push_back(i);
+            }
+            q.push_back(Value(64));
+            expect.push_back(64);
+            EXPECT(q.migrating());
+            for (int i = 0; i < pushes; ++i) {
+                q.push_front(Value(100 + i));
+                expect.push_front(100 + i);
+            }
+            for (int i = 0; i < 10; ++i) {
+                q.pop_back();
+                expect.pop_back();
+                q.pop_front();
+                expect.pop_front();
+                EXPECT(check_equal(q, expect));
+            }
+            EXPECT(q.migrating());
+            q.finish_migration();
+            EXPECT(!q.migrating());
+            EXPECT(check_equal(q, expect));
+        }
+        EXPECT_INTEQ(Value::live_, 0);
+    }
+
+    return true;
+}
+
+// The whole point: no single operation moves more than MigrateStep
+// elements, however large the queue is.
+bool test_bounded_work() {
+    static const size_t kStep = 2;
+    incremental_deque<Value, uint32_t, std::allocator<Value>, kStep> q;
+    uint32_t max_moves = 0;
+    for (uint32_t i = 0; i < 100000; ++i) {
+        Value::Counts before = Value::counts_;
+        q.emplace_back(i);
+        Value::Counts work = Value::counts_ - before;
+        max_moves = std::max<uint32_t>(max_moves, work.moves);
+        EXPECT_INTEQ(work.copies, 0);
+    }
+    EXPECT(max_moves <= kStep);
+    EXPECT_INTEQ(q.capacity(), 131072);
+    for (uint32_t i = 0; i < 100000; ++i) {
+        EXPECT_INTEQ(q[i], i);
+    }
+
+    return true;
+}
+
+// Pushing a reference to an element of the queue itself must work,
+// even when the push triggers a resize or a migration.
+bool test_push_self_reference() {
+    incremental_deque<Value> q;
+    q.push_back(Value(1));
+    for (int i = 0; i < 100; ++i) {
+        q.push_back(q.front());
+        q.push_front(q.back());
+    }
+    EXPECT_INTEQ(q.size(), 201);
+    for (auto it = q.begin(); it != q.end(); ++it) {
+        EXPECT_INTEQ(*it, 1);
+    }
+
+    return true;
+}
+
+bool test_copy_move() {
+    Value::live_ = 0;
+    {
+        incremental_deque<Value> q;
+        std::deque<uint32_t> expect;
+        for (uint32_t i = 0; i < 33; ++i) {
+            q.push_back(Value(i));
+            expect.push_back(i);
+        }
+        EXPECT(q.migrating());
+
+        incremental_deque<Value> copy(q);
+        EXPECT(check_equal(copy, expect));
+
+        incremental_deque<Value> moved(std::move(q));
+        EXPECT(check_equal(moved, expect));
+        EXPECT(moved.migrating());
+        EXPECT(q.empty());
+        EXPECT(!q.migrating());
+
+        q = moved;
+        EXPECT(check_equal(q, expect));
+        copy = std::move(moved);
+        EXPECT(check_equal(copy, expect));
+
+        q.shrink_to_fit();
+        EXPECT(check_equal(q, expect));
+        EXPECT_INTEQ(q.capacity(), 64);
+        for (int i = 0; i < 30; ++i) {
+            q.pop_front();
+            expect.pop_front();
+        }
+        q.shrink_to_fit();
+        EXPECT_INTEQ(q.capacity(), 4);
+        EXPECT(check_equal(q, expect));
+
+        q.clear();
+        EXPECT(q.empty());
+        copy.clear();
+        EXPECT(!copy.migrating());
+    }
+    EXPECT_INTEQ(Value::live_, 0);
+
+    return true;
+}
+
+bool test_random() {
+    std::mt19937 rand(1);
+    incremental_deque<uint32_t, uint16_t> q;
+    std::deque<uint32_t> expect;
+    for (int i = 0; i < 200000; ++i) {
+        uint32_t r = rand();
+        // Drift towards larger sizes, then back.
+        bool grow = (i / 50000) % 2 == 0;
+        switch (r % 5) {
+        case 0:
+        case 1:
+            if (grow || r % 3 == 0) {
+                q.push_back(r);
+                expect.push_back(r);
+            }
+            break;
+        case 2:
+            if (grow) {
+                q.push_front(r);
+                expect.push_front(r);
+            }
+            break;
+        case 3:
+            if (!expect.empty()) {
+                q.pop_front();
+                expect.pop_front();
+            }
+            break;
+        case 4:
+            if (!expect.empty()) {
+                q.pop_back();
+                expect.pop_back();
+            }
+            break;
+        }
+        if (!expect.empty()) {
+            EXPECT_INTEQ(q.front(), expect.front());
+            EXPECT_INTEQ(q.back(), expect.back());
+            size_t j = r % expect.size();
+            EXPECT_INTEQ(q.at(j), expect[j]);
+        }
+        EXPECT_INTEQ(q.size(), expect.size());
+    }
+    EXPECT(check_equal(q, expect));
+
+    return true;
+}
+
+// An allocator for sparse buffers, which are only backed by memory
+// once touched.
+template<typename T>
+struct sparse_allocator : std::allocator<T> {
+    template<typename U>
+    struct rebind {
+        typedef sparse_allocator<U> other;
+    };
+
+    T* allocate(size_t n) {
+        void* p = mmap(NULL, n * sizeof(T), PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, size_t n) {
+        munmap(p, n * sizeof(T));
+    }
+};
+
+// Allow placing the indices anywhere in their range.
+struct indexed_queue : incremental_deque<char, uint32_t,
+                                         sparse_allocator<char>> {
+    indexed_queue(size_t initial_capacity)
+        : incremental_deque(initial_capacity) {
+    }
+
+    void set_indices(uint32_t read, uint32_t write) {
+        ptr_.read_ = read;
+        ptr_.write_ = write;
+    }
+};
+
+// A queue of max_size() elements must not shrink.
+bool test_shrink_max_size() {
+    indexed_queue q(uint64_t(1) << 31);
+    EXPECT_INTEQ(q.capacity(), q.max_size());
+    q.set_indices(0, q.max_size());
+    EXPECT_INTEQ(q.size(), q.max_size());
+    q[0] = 'a';
+    q[q.size() - 1] = 'b';
+
+    q.shrink_to_fit();
+    EXPECT_INTEQ(q.capacity(), q.max_size());
+    EXPECT_INTEQ(q.front(), 'a');
+    EXPECT_INTEQ(q.back(), 'b');
+
+    q.set_indices(0, 0);
+
+    return true;
+}
+
+// The iterators are random access, with the full set of comparisons.
+bool test_iterators() {
+    typedef incremental_deque<uint32_t> queue;
+    queue q;
+    for (uint32_t i = 0; i < 300; ++i) {
+        q.push_back(i * 37 % 300);
+    }
+    std::sort(q.begin(), q.end());
+    for (uint32_t i = 0; i < 300; ++i) {
+        EXPECT_INTEQ(q[i], i);
+    }
+
+    queue::iterator a = q.begin() + 10;
+    queue::iterator b = 20 + q.begin();
+    EXPECT(a < b && b > a && a <= b && b >= a && a <= a && a >= a);
+    EXPECT(!(b < a) && !(a > b) && !(b <= a) && !(a >= b));
+    EXPECT(b - a == 10);
+    EXPECT_INTEQ(a[5], 15);
+
+    queue::const_iterator c = a;
+    EXPECT(c == q.cbegin() + 10);
+    EXPECT(q.cend() - c == 290);
+    EXPECT_INTEQ(*std::lower_bound(q.cbegin(), q.cend(), 42u), 42);
+
+    return true;
+}
+
+int main(void) {
+    bool ok = true;
+    TEST(test_push_pop);
+    TEST(test_pop_while_migrating);
+    TEST(test_bounded_work);
+    TEST(test_push_self_reference);
+    TEST(test_copy_move);
+    TEST(test_random);
+    TEST(test_shrink_max_size);
+    TEST(test_iterators);
+
+    return !ok;
+}
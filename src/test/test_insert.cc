@@ -146,6 +146,30 @@ bool test_insert_max_size() {
     return true;
 }
 
+bool test_insert_count_overflow() {
+    // A count that doesn't fit in the index type must not get
+    // truncated to one that does.
+    {
+        inline_deque<Value, 4, uint8_t> q;
+        q.emplace_back(1);
+        EXPECT_THROW(q.insert(q.begin(), 257, Value(2)),
+                     std::length_error);
+        EXPECT_INTEQ(q.size(), 1);
+        q.insert(q.begin(), 127, Value(2));
+        EXPECT_INTEQ(q.size(), 128);
+        EXPECT_THROW(q.insert(q.begin(), 1, Value(2)),
+                     std::length_error);
+    }
+    {
+        inline_deque<Value, 4, uint16_t> q;
+        EXPECT_THROW(q.insert(q.end(), (1 << 16) + 3, Value(2)),
+                     std::length_error);
+        EXPECT_INTEQ(q.size(), 0);
+    }
+
+    return true;
+}
+
 int main(void) {
     bool ok = true;
 
@@ -154,6 +178,7 @@ int main(void) {
     TEST(test_insert_middle);
     TEST(test_insert_full);
     TEST(test_insert_max_size);
+    TEST(test_insert_count_overflow);
 
     return !ok;
 }
@@ -0,0 +1,62 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+
+#include "../inline_deque_instances.h"
+
+#include "util_test.h"
+
+// The explicitly instantiated types must link against the
+// instantiations in the library, and work the same as any other.
+
+bool test_instances_integer() {
+    inline_deque<uint32_t, 4> q;
+    for (uint32_t i = 0; i < 10; ++i) {
+        q.push_back(i);
+    }
+    q.erase(q.begin() + 2, q.begin() + 4);
+    q.insert(q.begin(), 100);
+    q.pop_back();
+
+    EXPECT_INTEQ(q.size(), 8);
+    EXPECT_INTEQ(q.front(), 100);
+    EXPECT_INTEQ(q.at(3), 4);
+    EXPECT_INTEQ(q.back(), 8);
+
+    return true;
+}
+
+bool test_instances_string() {
+    inline_deque<std::string, 1> q { "a", "b" };
+    q.push_front("c");
+    inline_deque<std::string, 1> q2(q);
+    q.clear();
+
+    EXPECT(q.empty());
+    EXPECT_STREQ(q2[0], "c");
+    EXPECT_STREQ(q2[2], "b");
+
+    return true;
+}
+
+bool test_instances_pair() {
+    inline_deque<inline_deque_pair64, 16> q;
+    q.emplace_back(1, 2);
+    q.emplace_front(3, 4);
+
+    EXPECT_INTEQ(q.front().first, 3);
+    EXPECT_INTEQ(q.back().second, 2);
+
+    return true;
+}
+
+int main(void) {
+    bool ok = true;
+
+    TEST(test_instances_integer);
+    TEST(test_instances_string);
+    TEST(test_instances_pair);
+
+    return !ok;
+}
@@ -0,0 +1,95 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+
+#include <algorithm>
+
+#include "../inline_deque.h"
+
+#include "util_test.h"
+
+// Build a queue of capacity 16 containing 0..size-1, starting at
+// storage index "offset", then make it contiguous and check the
+// results. Covers all the cases for how much free space there is
+// relative to the two segments.
+template<typename T>
+bool check_make_contiguous(int size, int offset) {
+    inline_deque<T, 16> q;
+    for (int i = 0; i < offset; ++i) {
+        q.push_back(T(0));
+        q.pop_front();
+    }
+    for (int i = 0; i < size; ++i) {
+        q.push_back(T(i));
+    }
+    auto it = q.begin() + size / 2;
+
+    auto seg = q.make_contiguous();
+
+    EXPECT_INTEQ(seg.size, size);
+    EXPECT_INTEQ(q.size(), size);
+    EXPECT_INTEQ(q.capacity(), 16);
+    typename inline_deque<T, 16>::segment segs[2];
+    EXPECT_INTEQ(q.segments(segs), (size ? 1 : 0));
+    for (int i = 0; i < size; ++i) {
+        EXPECT_INTEQ(seg.data[i], i);
+        EXPECT_INTEQ(q[i], i);
+    }
+    if (size) {
+        EXPECT(&q.front() == seg.data);
+        // Iterators remain valid.
+        EXPECT_INTEQ(*it, size / 2);
+    }
+
+    // The queue still works normally afterwards.
+    q.push_front(T(100));
+    q.push_back(T(101));
+    EXPECT_INTEQ(q.front(), 100);
+    EXPECT_INTEQ(q.back(), 101);
+
+    return true;
+}
+
+bool test_make_contiguous() {
+    for (int size = 0; size <= 16; ++size) {
+        for (int offset = 0; offset < 16; ++offset) {
+            EXPECT(check_make_contiguous<uint32_t>(size, offset));
+            Value::live_ = 0;
+            EXPECT(check_make_contiguous<Value>(size, offset));
+            EXPECT_INTEQ(Value::live_, 0);
+        }
+    }
+
+    return true;
+}
+
+bool test_make_contiguous_sort() {
+    inline_deque<int, 8> q;
+    for (int i = 0; i < 6; ++i) {
+        q.push_back(0);
+        q.pop_front();
+    }
+    for (int i = 0; i < 7; ++i) {
+        q.push_back((i * 5) % 7);
+    }
+
+    auto seg = q.make_contiguous();
+    std::sort(seg.begin(), seg.end());
+
+    for (int i = 0; i < 7; ++i) {
+        EXPECT_INTEQ(q[i], i);
+    }
+    EXPECT(std::binary_search(seg.begin(), seg.end(), 4));
+
+    return true;
+}
+
+int main(void) {
+    bool ok = true;
+
+    TEST(test_make_contiguous);
+    TEST(test_make_contiguous_sort);
+
+    return !ok;
+}
@@ -0,0 +1,176 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+
+#include "../inline_deque.h"
+
+#include "util_test.h"
+
+typedef inline_deque<Value, 4, uint32_t, std::allocator<Value>,
+                     inline_deque_bounded> bounded_queue;
+
+static bounded_queue make_bounded(size_t max_capacity,
+                                  inline_deque_overflow mode) {
+    return bounded_queue(4, std::allocator<Value>(),
+                         inline_deque_bounded(max_capacity, mode));
+}
+
+static_assert(sizeof(inline_deque<uint32_t, 4>) ==
+              sizeof(inline_deque<uint32_t, 4, uint32_t,
+                                  std::allocator<uint32_t>,
+                                  inline_deque_unbounded>),
+              "The default policy takes no space");
+
+bool test_unbounded() {
+    inline_deque<int, 1> q;
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT(q.push_back(i));
+        EXPECT(q.emplace_front(i));
+    }
+    EXPECT_INTEQ(q.size(), 2000);
+
+    return true;
+}
+
+bool test_reject() {
+    Value::live_ = 0;
+    {
+        bounded_queue q = make_bounded(16, inline_deque_overflow::reject);
+        for (uint32_t i = 0; i < 16; ++i) {
+            EXPECT(q.push_back(Value(i)));
+        }
+        EXPECT_INTEQ(q.capacity(), 16);
+        EXPECT(!q.push_back(Value(100)));
+        EXPECT(!q.push_front(Value(100)));
+        EXPECT(!q.emplace_back(100));
+        EXPECT(!q.emplace_front(100));
+        EXPECT_INTEQ(q.size(), 16);
+        EXPECT_INTEQ(q.capacity(), 16);
+        EXPECT_INTEQ(q.overflow_policy().drops(), 0);
+        for (uint32_t i = 0; i < 16; ++i) {
+            EXPECT_INTEQ(q[i], i);
+        }
+        EXPECT_THROW(q.insert(q.begin(), Value(100)), std::length_error);
+
+        q.pop_front();
+        EXPECT(q.push_back(Value(16)));
+        EXPECT_INTEQ(q.front(), 1);
+        EXPECT_INTEQ(q.back(), 16);
+
+        // Raising the limit allows growth again.
+        q.overflow_policy().set_max_capacity(32);
+        EXPECT(q.push_back(Value(17)));
+        EXPECT_INTEQ(q.capacity(), 32);
+        EXPECT_INTEQ(q.size(), 17);
+    }
+    EXPECT_INTEQ(Value::live_, 0);
+
+    return true;
+}
+
+bool test_drop_newest() {
+    Value::live_ = 0;
+    {
+        // Rounded up to 8.
+        bounded_queue q = make_bounded(5, inline_deque_overflow::drop_newest);
+        EXPECT_INTEQ(q.overflow_policy().max_capacity(), 8);
+        for (uint32_t i = 0; i < 20; ++i) {
+            EXPECT_INTEQ(q.push_back(Value(i)), (i < 8));
+        }
+        EXPECT_INTEQ(q.size(), 8);
+        EXPECT_INTEQ(q.overflow_policy().drops(), 12);
+        EXPECT_INTEQ(q.front(), 0);
+        EXPECT_INTEQ(q.back(), 7);
+        q.overflow_policy().reset_drops();
+        EXPECT_INTEQ(q.overflow_policy().drops(), 0);
+    }
+    EXPECT_INTEQ(Value::live_, 0);
+
+    return true;
+}
+
+bool test_overwrite_oldest() {
+    Value::live_ = 0;
+    {
+        bounded_queue q = make_bounded(8,
+                                       inline_deque_overflow::overwrite_oldest);
+        for (uint32_t i = 0; i < 20; ++i) {
+            EXPECT(q.push_back(Value(i)));
+            EXPECT_INTEQ(q.back(), i);
+        }
+        EXPECT_INTEQ(q.size(), 8);
+        EXPECT_INTEQ(q.capacity(), 8);
+        EXPECT_INTEQ(q.overflow_policy().drops(), 12);
+        EXPECT_INTEQ(Value::live_, 8);
+        for (uint32_t i = 0; i < 8; ++i) {
+            EXPECT_INTEQ(q[i], (12 + i));
+        }
+
+        // Pushing at the front drops from the back.
+        EXPECT(q.push_front(Value(100)));
+        EXPECT_INTEQ(q.front(), 100);
+        EXPECT_INTEQ(q.back(), 18);
+        EXPECT_INTEQ(q.size(), 8);
+        EXPECT_INTEQ(q.overflow_policy().drops(), 13);
+
+        // The new element may be a copy of the dropped one.
+        EXPECT(q.push_back(q.front()));
+        EXPECT_INTEQ(q.back(), 100);
+        EXPECT_INTEQ(q.front(), 12);
+        EXPECT(q.push_front(q.back()));
+        EXPECT_INTEQ(q.front(), 100);
+        EXPECT_INTEQ(q.back(), 18);
+        EXPECT(q.emplace_back(q.front()));
+        EXPECT_INTEQ(q.back(), 100);
+        EXPECT_INTEQ(q.size(), 8);
+        EXPECT_INTEQ(q.overflow_policy().drops(), 16);
+        EXPECT_INTEQ(Value::live_, 8);
+    }
+    EXPECT_INTEQ(Value::live_, 0);
+
+    return true;
+}
+
+bool test_inline_limit() {
+    // A limit below the inline capacity applies at the inline capacity.
+    bounded_queue q = make_bounded(1, inline_deque_overflow::reject);
+    for (uint32_t i = 0; i < 4; ++i) {
+        EXPECT(q.push_back(Value(i)));
+    }
+    EXPECT(!q.push_back(Value(4)));
+    EXPECT_INTEQ(q.capacity(), 4);
+
+    return true;
+}
+
+bool test_copy_move() {
+    bounded_queue q = make_bounded(4, inline_deque_overflow::drop_newest);
+    for (uint32_t i = 0; i < 6; ++i) {
+        q.push_back(Value(i));
+    }
+    bounded_queue copy(q);
+    EXPECT_INTEQ(copy.overflow_policy().drops(), 2);
+    EXPECT(!copy.push_back(Value(6)));
+    EXPECT_INTEQ(copy.overflow_policy().drops(), 3);
+
+    bounded_queue moved(std::move(copy));
+    EXPECT(!moved.push_back(Value(7)));
+    EXPECT_INTEQ(moved.overflow_policy().drops(), 4);
+    EXPECT(moved.overflow_policy().mode() ==
+           inline_deque_overflow::drop_newest);
+
+    return true;
+}
+
+int main(void) {
+    bool ok = true;
+    TEST(test_unbounded);
+    TEST(test_reject);
+    TEST(test_drop_newest);
+    TEST(test_overwrite_oldest);
+    TEST(test_inline_limit);
+    TEST(test_copy_move);
+
+    return !ok;
+}
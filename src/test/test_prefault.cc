@@ -0,0 +1,155 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+
+#include <sys/mman.h>
+
+#include <vector>
+
+#include "../inline_deque.h"
+#include "../inline_deque_allocator.h"
+
+#include "util_test.h"
+
+// True if all pages of the page aligned range are in memory.
+static bool resident(const void* p, size_t bytes) {
+    size_t pages = (bytes + 4095) / 4096;
+    std::vector<unsigned char> vec(pages);
+    if (mincore(const_cast<void*>(p), bytes, vec.data()) != 0) {
+        return false;
+    }
+    for (size_t i = 0; i < pages; ++i) {
+        if (!(vec[i] & 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool test_reserve() {
+    inline_deque<int, 4> q;
+    q.reserve(3);
+    EXPECT_INTEQ(q.capacity(), 4);
+    for (int i = 0; i < 4; ++i) {
+        q.push_back(i);
+    }
+    q.pop_front();
+    q.push_back(4);
+    q.reserve(5);
+    EXPECT_INTEQ(q.capacity(), 8);
+    q.reserve(1000);
+    EXPECT_INTEQ(q.capacity(), 1024);
+    q.reserve(10);
+    EXPECT_INTEQ(q.capacity(), 1024);
+    EXPECT_INTEQ(q.size(), 4);
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_INTEQ(q[i], (i + 1));
+    }
+
+    inline_deque<int, 0> heap_only;
+    heap_only.reserve(1);
+    EXPECT_INTEQ(heap_only.capacity(), 1);
+    heap_only.push_back(1);
+    EXPECT_INTEQ(heap_only.front(), 1);
+
+    inline_deque<int, 1, uint8_t> small;
+    small.reserve(128);
+    EXPECT_INTEQ(small.capacity(), 128);
+    EXPECT_THROW(small.reserve(129), std::length_error);
+
+    return true;
+}
+
+bool test_no_shrink() {
+    Value::live_ = 0;
+    {
+        inline_deque<Value, 1, uint32_t, std::allocator<Value>,
+                     inline_deque_no_shrink<>> q;
+        inline_deque<Value, 1> shrinking;
+        for (uint32_t i = 0; i < 1000; ++i) {
+            q.push_back(Value(i));
+            shrinking.push_back(Value(i));
+        }
+        for (uint32_t i = 0; i < 1000; ++i) {
+            q.pop_back();
+            shrinking.pop_back();
+        }
+        EXPECT_INTEQ(q.capacity(), 1024);
+        EXPECT(shrinking.capacity() < 1024);
+
+        // Explicit shrinking still works.
+        q.shrink_to_fit();
+        EXPECT_INTEQ(q.capacity(), 1);
+    }
+    EXPECT_INTEQ(Value::live_, 0);
+
+    // Combined with a bounded policy.
+    typedef inline_deque_no_shrink<inline_deque_bounded> policy;
+    inline_deque<int, 1, uint32_t, std::allocator<int>, policy> q(
+        1, std::allocator<int>(), policy(inline_deque_bounded(16)));
+    for (int i = 0; i < 16; ++i) {
+        EXPECT(q.push_back(i));
+    }
+    EXPECT(!q.push_back(16));
+    while (!q.empty()) {
+        q.pop_back();
+    }
+    EXPECT_INTEQ(q.capacity(), 16);
+    EXPECT_INTEQ(q.overflow_policy().max_capacity(), 16);
+
+    return true;
+}
+
+template<typename Q>
+bool check_prefault() {
+    Q q;
+    q.reserve(1 << 16);
+    q.push_back(0);
+    EXPECT(resident(&q[0], q.capacity() * sizeof(q[0])));
+    // Growing prefaults the new buffer, including the half that
+    // hasn't been written to yet.
+    for (uint64_t i = 1; i <= (1 << 16); ++i) {
+        q.push_back(i);
+    }
+    EXPECT_INTEQ(q.capacity(), (1 << 17));
+    EXPECT(resident(&q[0], q.capacity() * sizeof(q[0])));
+    for (uint64_t i = 0; i <= (1 << 16); ++i) {
+        EXPECT_INTEQ(q.front(), i);
+        q.pop_front();
+    }
+
+    return true;
+}
+
+bool test_prefault() {
+    EXPECT((check_prefault<inline_deque<uint64_t, 1, uint32_t,
+                                        prefault_allocator<uint64_t>>>()));
+    EXPECT((check_prefault<inline_deque<uint64_t, 1, uint32_t,
+                                        prefault_allocator<uint64_t,
+                                                           true>>>()));
+
+    // Small allocations.
+    Value::live_ = 0;
+    {
+        inline_deque<Value, 1, uint32_t, prefault_allocator<Value>> q;
+        for (uint32_t i = 0; i < 100; ++i) {
+            q.push_back(Value(i));
+        }
+        for (uint32_t i = 0; i < 100; ++i) {
+            EXPECT_INTEQ(q[i], i);
+        }
+    }
+    EXPECT_INTEQ(Value::live_, 0);
+
+    return true;
+}
+
+int main(void) {
+    bool ok = true;
+    TEST(test_reserve);
+    TEST(test_no_shrink);
+    TEST(test_prefault);
+
+    return !ok;
+}
@@ -15,6 +15,32 @@ static std::uniform_int_distribution<uint64_t> rand_uint64 {
     0, std::numeric_limits<uint64_t>::max()
 };
 
+// The complexity oracle. Operations on queues of these types are
+// checked against upper bounds on the number of element moves and
+// copies they are allowed to do, so that an accidental change from
+// O(1) to O(n) (or O(n) to O(n^2)) makes the test fail rather than
+// just get slower. Other queue types (i.e. std::deque) are only used
+// as a reference for the checksums.
+template<class Q>
+struct complexity_checked : std::false_type {
+};
+
+template<typename T, size_t N, typename C, class A>
+struct complexity_checked<inline_deque<T, N, C, A>> : std::true_type {
+};
+
+// The number of elements that need to be moved to a new buffer if
+// "count" elements are added to the queue.
+template<class Q>
+uint64_t growth_cost(const Q& q, uint64_t count) {
+    return 0;
+}
+
+template<typename T, size_t N, typename C, class A>
+uint64_t growth_cost(const inline_deque<T, N, C, A>& q, uint64_t count) {
+    return q.size() + count > q.capacity() ? q.size() : 0;
+}
+
 template<class Q>
 struct Worker {
     Worker() {
@@ -32,76 +58,102 @@ struct Worker {
         }
 
         auto val = rand_uint64(*rand) & 0xffff;
+        uint64_t size = queue_.size();
+        uint64_t other_size = other_queue_.size();
+        Value::Counts before = Value::counts_;
         if (queue_.size() < target_) {
+            // A push moves at most the element being pushed, plus
+            // the old contents if the queue needs to grow.
+            uint64_t growth = growth_cost(queue_, 1);
             switch (val & 7) {
             case 0:
                 queue_.push_back(Value(val));
+                check_cost("push_back(T&&)", before, 1 + growth, 0);
                 break;
             case 1:
                 queue_.emplace_back(val);
+                check_cost("emplace_back", before, growth, 0);
                 break;
             case 2:
                 queue_.push_front(Value(val));
+                check_cost("push_front(T&&)", before, 1 + growth, 0);
                 break;
             case 3:
                 queue_.emplace_front(val);
+                check_cost("emplace_front", before, growth, 0);
                 break;
             case 4: {
                 Value v(val);
                 queue_.push_back(v);
+                check_cost("push_back(const T&)", before, growth, 1);
                 break;
             }
             case 5: {
                 Value v(val);
                 queue_.push_front(v);
+                check_cost("push_front(const T&)", before, growth, 1);
                 break;
             }
             }
         } else {
+            // A pop might shrink the queue, moving the remaining
+            // elements.
             if (val & 1) {
                 mix(queue_.back().value());
                 queue_.pop_back();
+                check_cost("pop_back", before, size - 1, 0);
             } else {
                 mix(queue_.front().value());
                 queue_.pop_front();
+                check_cost("pop_front", before, size - 1, 0);
             }
         }
 
+        size = queue_.size();
+        before = Value::counts_;
         switch (val & 0xff) {
         case 0:
             queue_.shrink_to_fit();
+            check_cost("shrink_to_fit", before, size, 0);
             break;
         case 1:
             for (auto v : queue_) {
                 mix(v.value());
             }
             break;
-        // Various combinations of moves and copies.
+        // Various combinations of moves and copies. Moving a queue
+        // moves the elements only if they're stored inline, and
+        // never copies them.
         case 2:
             std::swap(queue_, other_queue_);
+            check_cost("swap", before, 2 * size + other_size, 0);
             break;
         case 3: {
             Q tmp(queue_);
             queue_ = other_queue_;
             other_queue_ = tmp;
+            check_cost("copy", before, 0, 2 * size + other_size);
             break;
         }
         case 4: {
             Q tmp(std::move(queue_));
             queue_ = std::move(other_queue_);
             other_queue_ = std::move(tmp);
+            check_cost("move", before, 2 * size + other_size, 0);
             break;
         }
         case 5: {
             Q tmp(queue_);
             queue_ = std::move(other_queue_);
             other_queue_ = std::move(tmp);
+            check_cost("copy+move", before, size + other_size, size);
             break;
         }
         case 6: {
             Q tmp(std::move(queue_));
             queue_ = other_queue_;
             other_queue_ = std::move(tmp);
+            check_cost("move+copy", before, 2 * size, other_size);
             break;
         }
         case 7: {
@@ -111,16 +163,27 @@ struct Worker {
                 if (end < start) {
                     std::swap(start, end);
                 }
+                size = queue_.size();
+                before = Value::counts_;
                 queue_.erase(queue_.begin() + start,
                              queue_.begin() + end);
+                // Only the elements after the erased range move.
+                check_cost("erase", before, size - end, 0);
             }
         }
         case 8: {
             int start = rand_uint64(*rand) % (queue_.size() + 1);
             int count = rand_uint64(*rand) % 8;
             if (count) {
+                size = queue_.size();
+                uint64_t growth = growth_cost(queue_, count);
+                before = Value::counts_;
                 queue_.insert(queue_.begin() + start, count,
                               Value(count));
+                // Only the elements after the insertion point move
+                // (plus everything, if the queue needs to grow).
+                check_cost("insert", before,
+                           size - start + growth, count);
             }
         }
         default:
@@ -134,6 +197,25 @@ struct Worker {
         }
     }
 
+    // Check that the operation that was started when the element
+    // counters were at "before" did at most max_moves moves and
+    // max_copies copies.
+    void check_cost(const char* op, const Value::Counts& before,
+                    uint64_t max_moves, uint64_t max_copies) {
+        if (!complexity_checked<Q>::value) {
+            return;
+        }
+        Value::Counts cost = Value::counts_ - before;
+        if (cost.moves > max_moves || cost.copies > max_copies) {
+            if (complexity_ok_) {
+                printf("%s: %lu moves (max %lu), %lu copies (max %lu)\n",
+                       op, cost.moves, max_moves,
+                       cost.copies, max_copies);
+            }
+            complexity_ok_ = false;
+        }
+    }
+
     void mix(uint64_t val) {
         csum_ = ((csum_ << 5) + val) ^ csum_;
     }
@@ -145,6 +227,7 @@ struct Worker {
     Q other_queue_;
     uint64_t csum_ = 0;
     uint64_t target_ = 0;
+    bool complexity_ok_ = true;
 };
 
 template<class Q>
@@ -168,6 +251,15 @@ struct Master {
         return csum;
     }
 
+    bool complexity_ok() {
+        for (auto& w : workers_) {
+            if (!w.complexity_ok_) {
+                return false;
+            }
+        }
+        return true;
+    }
+
     void setup() {
         for (auto& w : workers_) {
             w.setup(&rand_);
@@ -180,38 +272,89 @@ struct Master {
 
 template<typename Q>
 uint64_t test_random(const char* label, int n,
-                     std::map<uint64_t, std::vector<std::string>>* csums) {
+                     std::map<uint64_t, std::vector<std::string>>* csums,
+                     bool* complexity_ok) {
     uint64_t csum;
     {
         Value::live_ = 0;
         Master<Q> master(n);
         master.setup();
         csum = master.run();
+        if (!master.complexity_ok()) {
+            printf("FAIL: %s exceeded a complexity bound\n", label);
+            *complexity_ok = false;
+        }
     }
     (*csums)[csum].push_back(label);
 
     return csum;
 }
 
+// Growing a queue one element at a time should do an amortized
+// constant number of moves per push, and so should shrinking it
+// back down with pops.
+template<typename Q>
+bool test_amortized(const char* label) {
+    static const uint64_t kCount = 1 << 16;
+    Q q;
+
+    Value::Counts before = Value::counts_;
+    for (uint64_t i = 0; i < kCount; ++i) {
+        q.push_back(Value(i));
+    }
+    Value::Counts cost = Value::counts_ - before;
+    // One move for the element itself, and at most 1+2+4+...+n/2 < n
+    // for the doublings.
+    if (cost.moves > 2 * kCount || cost.copies != 0) {
+        printf("FAIL: %s: %lu moves, %lu copies for %lu pushes\n",
+               label, cost.moves, cost.copies, kCount);
+        return false;
+    }
+
+    before = Value::counts_;
+    while (!q.empty()) {
+        q.pop_back();
+    }
+    cost = Value::counts_ - before;
+    if (cost.moves > kCount || cost.copies != 0 ||
+        cost.destroys > cost.moves + kCount) {
+        printf("FAIL: %s: %lu moves, %lu copies for %lu pops\n",
+               label, cost.moves, cost.copies, kCount);
+        return false;
+    }
+
+    return true;
+}
+
 int main(int argc, char** argv) {
     int n = 1000;
     if (argc > 1) {
         sscanf(argv[1], "%d", &n);
     }
     std::map<uint64_t, std::vector<std::string>> csums;
+    bool complexity_ok = true;
     test_random<inline_deque<Value, 0, uint16_t>>(
-        "inline_deque<0>", n, &csums);
+        "inline_deque<0>", n, &csums, &complexity_ok);
     test_random<inline_deque<Value, 1, uint16_t>>(
-        "inline_deque<1, 0>", n, &csums);
+        "inline_deque<1, 0>", n, &csums, &complexity_ok);
     test_random<inline_deque<Value, 1, uint16_t>>(
-        "inline_deque<1>", n, &csums);
+        "inline_deque<1>", n, &csums, &complexity_ok);
     test_random<inline_deque<Value, 2, uint16_t>>(
-        "inline_deque<2>", n, &csums);
+        "inline_deque<2>", n, &csums, &complexity_ok);
     test_random<inline_deque<Value, 4, uint16_t>>(
-        "inline_deque<4>", n, &csums);
+        "inline_deque<4>", n, &csums, &complexity_ok);
     test_random<inline_deque<Value, 16>>(
-        "inline_deque<16>", n, &csums);
-    test_random<std::deque<Value>>("deque<>", n, &csums);
+        "inline_deque<16>", n, &csums, &complexity_ok);
+    test_random<std::deque<Value>>("deque<>", n, &csums, &complexity_ok);
+
+    complexity_ok &= test_amortized<inline_deque<Value, 0>>(
+        "inline_deque<0>");
+    complexity_ok &= test_amortized<inline_deque<Value, 16>>(
+        "inline_deque<16>");
+
+    if (!complexity_ok) {
+        return 1;
+    }
 
     if (csums.size() == 1) {
         printf("OK\n");
@@ -0,0 +1,280 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+
+#include <deque>
+
+#include "../inline_deque.h"
+#include "../inline_deque_allocator.h"
+
+#include "util_test.h"
+
+static int reallocations = 0;
+
+template<typename T>
+struct counting_allocator : realloc_allocator<T> {
+    template<typename U>
+    struct rebind {
+        typedef counting_allocator<U> other;
+    };
+
+    T* reallocate(T* p, size_t old_n, size_t new_n) {
+        ++reallocations;
+        return realloc_allocator<T>::reallocate(p, old_n, new_n);
+    }
+};
+
+// An allocator that can't shrink allocations.
+template<typename T>
+struct no_shrink_allocator : realloc_allocator<T> {
+    template<typename U>
+    struct rebind {
+        typedef no_shrink_allocator<U> other;
+    };
+
+    T* reallocate(T* p, size_t old_n, size_t new_n) {
+        if (new_n < old_n) {
+            throw std::bad_alloc();
+        }
+        return realloc_allocator<T>::reallocate(p, old_n, new_n);
+    }
+};
+
+static_assert(inline_deque_detail::has_reallocate<
+                  realloc_allocator<int>, int>::value,
+              "realloc_allocator should support reallocate()");
+static_assert(!inline_deque_detail::has_reallocate<
+                  std::allocator<int>, int>::value,
+              "std::allocator should not support reallocate()");
+
+// Fill a queue of capacity 16 starting at storage index "offset",
+// then grow it by "count" elements and check the results. Covers
+// both moving the wrapped prefix and moving the head segment.
+template<typename T>
+bool check_grow(int offset, int count, bool expect_realloc) {
+    inline_deque<T, 1, uint32_t, counting_allocator<T>> q(16);
+    for (int i = 0; i < offset; ++i) {
+        q.push_back(T(0));
+        q.pop_front();
+    }
+    for (int i = 0; i < 16; ++i) {
+        q.push_back(T(i));
+    }
+    EXPECT_INTEQ(q.capacity(), 16);
+
+    reallocations = 0;
+    for (int i = 16; i < 16 + count; ++i) {
+        q.push_back(T(i));
+    }
+    EXPECT_INTEQ(reallocations, (expect_realloc ? 1 : 0));
+    EXPECT_INTEQ(q.capacity(), 32);
+    EXPECT_INTEQ(q.size(), 16 + count);
+    for (int i = 0; i < 16 + count; ++i) {
+        EXPECT_INTEQ(q[i], i);
+    }
+
+    // The queue still works normally afterwards.
+    for (int i = 0; i < 32; ++i) {
+        q.push_front(T(-1));
+        q.pop_back();
+    }
+    EXPECT_INTEQ(q.size(), 16 + count);
+    EXPECT_INTEQ(q.front(), -1);
+    for (int i = 0; i < 16 + count; ++i) {
+        q.pop_front();
+    }
+    EXPECT(q.empty());
+
+    return true;
+}
+
+bool test_grow_in_place() {
+    for (int offset = 0; offset < 16; ++offset) {
+        for (int count = 1; count <= 16; ++count) {
+            EXPECT(check_grow<int>(offset, count, true));
+            EXPECT(check_grow<uint64_t>(offset, count, true));
+        }
+    }
+
+    return true;
+}
+
+bool test_grow_not_trivially_copyable() {
+    for (int offset = 0; offset < 16; ++offset) {
+        Value::live_ = 0;
+        EXPECT(check_grow<Value>(offset, 1, false));
+        EXPECT_INTEQ(Value::live_, 0);
+    }
+
+    return true;
+}
+
+bool test_grow_from_inline() {
+    // The first heap allocation can't be done in place.
+    inline_deque<int, 4, uint32_t, counting_allocator<int>> q;
+    reallocations = 0;
+    for (int i = 0; i < 5; ++i) {
+        q.push_back(i);
+    }
+    EXPECT_INTEQ(reallocations, 0);
+    EXPECT_INTEQ(q.capacity(), 8);
+
+    std::deque<int> expect(q.begin(), q.end());
+    for (int i = 5; i < 1000; ++i) {
+        q.push_back(i);
+        q.push_back(i);
+        q.pop_front();
+        expect.push_back(i);
+        expect.push_back(i);
+        expect.pop_front();
+    }
+    EXPECT(reallocations > 0);
+    EXPECT_INTEQ(q.size(), expect.size());
+    for (int i = 0; i < q.size(); ++i) {
+        EXPECT_INTEQ(q[i], expect[i]);
+    }
+
+    return true;
+}
+
+bool test_grow_insert() {
+    inline_deque<int, 1, uint32_t, counting_allocator<int>> q(8);
+    for (int i = 0; i < 6; ++i) {
+        q.push_front(i);
+    }
+    reallocations = 0;
+    q.insert(q.begin() + 3, 100, 7);
+    EXPECT_INTEQ(reallocations, 1);
+    EXPECT_INTEQ(q.capacity(), 128);
+    EXPECT_INTEQ(q.size(), 106);
+    EXPECT_INTEQ(q[0], 5);
+    EXPECT_INTEQ(q[2], 3);
+    EXPECT_INTEQ(q[3], 7);
+    EXPECT_INTEQ(q[102], 7);
+    EXPECT_INTEQ(q[103], 2);
+    EXPECT_INTEQ(q[105], 0);
+
+    return true;
+}
+
+// Fill a queue of capacity 64 with "count" elements starting at
+// storage index "offset", then shrink it to fit and check the
+// results. Covers all the ways the elements can be compacted.
+template<typename T>
+bool check_shrink(int offset, int count, bool expect_realloc) {
+    inline_deque<T, 1, uint32_t, counting_allocator<T>> q(64);
+    for (int i = 0; i < offset; ++i) {
+        q.push_back(T(0));
+        q.pop_front();
+    }
+    for (int i = 0; i < count; ++i) {
+        q.push_back(T(i));
+    }
+    EXPECT_INTEQ(q.capacity(), 64);
+
+    reallocations = 0;
+    q.shrink_to_fit();
+    uint32_t expect_capacity = 64;
+    while (expect_capacity > 2 * count) {
+        expect_capacity /= 2;
+    }
+    EXPECT_INTEQ(q.capacity(), expect_capacity);
+    EXPECT_INTEQ(reallocations,
+                 ((expect_realloc && expect_capacity < 64) ? 1 : 0));
+    EXPECT_INTEQ(q.size(), count);
+    for (int i = 0; i < count; ++i) {
+        EXPECT_INTEQ(q[i], i);
+    }
+
+    // The queue still works normally afterwards.
+    for (int i = 0; i < 2 * count; ++i) {
+        q.push_back(T(count + i));
+        q.pop_front();
+    }
+    for (int i = 0; i < count; ++i) {
+        EXPECT_INTEQ(q[i], (2 * count + i));
+    }
+
+    return true;
+}
+
+bool test_shrink_in_place() {
+    for (int offset = 0; offset < 64; ++offset) {
+        for (int count = 2; count <= 32; ++count) {
+            EXPECT(check_shrink<int>(offset, count, true));
+            EXPECT(check_shrink<uint64_t>(offset, count, true));
+        }
+    }
+    for (int offset = 0; offset < 64; offset += 7) {
+        Value::live_ = 0;
+        EXPECT(check_shrink<Value>(offset, 5, false));
+        EXPECT_INTEQ(Value::live_, 0);
+    }
+
+    return true;
+}
+
+// A failed shrink keeps the current storage, with the elements intact
+// however they were laid out.
+bool test_shrink_failure() {
+    for (int offset = 0; offset < 64; ++offset) {
+        for (int count = 2; count <= 32; count += 3) {
+            inline_deque<int, 1, uint32_t, no_shrink_allocator<int>> q(64);
+            for (int i = 0; i < offset; ++i) {
+                q.push_back(0);
+                q.pop_front();
+            }
+            for (int i = 0; i < count; ++i) {
+                q.push_back(i);
+            }
+            q.shrink_to_fit();
+            EXPECT_INTEQ(q.capacity(), 64);
+            EXPECT_INTEQ(q.size(), count);
+            for (int i = 0; i < count; ++i) {
+                EXPECT_INTEQ(q[i], i);
+            }
+            for (int i = 0; i < 100; ++i) {
+                q.push_back(count + i);
+                q.pop_front();
+            }
+            for (int i = 0; i < count; ++i) {
+                EXPECT_INTEQ(q[i], (100 + i));
+            }
+        }
+    }
+
+    return true;
+}
+
+bool test_shrink_on_pop() {
+    inline_deque<int, 4, uint32_t, counting_allocator<int>> q;
+    for (int i = 0; i < 1000; ++i) {
+        q.push_back(i);
+    }
+    reallocations = 0;
+    for (int i = 0; i < 998; ++i) {
+        q.pop_back();
+    }
+    // All but the final shrink to the inline storage are done in
+    // place.
+    EXPECT(reallocations > 0);
+    EXPECT_INTEQ(q.capacity(), 4);
+    EXPECT_INTEQ(q[0], 0);
+    EXPECT_INTEQ(q[1], 1);
+
+    return true;
+}
+
+int main(void) {
+    bool ok = true;
+    TEST(test_grow_in_place);
+    TEST(test_grow_not_trivially_copyable);
+    TEST(test_grow_from_inline);
+    TEST(test_grow_insert);
+    TEST(test_shrink_in_place);
+    TEST(test_shrink_failure);
+    TEST(test_shrink_on_pop);
+
+    return !ok;
+}
@@ -0,0 +1,201 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+
+#include <deque>
+#include <random>
+#include <string>
+
+#include "../record_deque.h"
+
+#include "util_test.h"
+
+typedef record_deque<64> queue;
+
+template<typename Segment>
+std::string str(Segment record) {
+    return std::string(record.data, record.size);
+}
+
+bool test_basic() {
+    queue q;
+    EXPECT(q.empty());
+    EXPECT_THROW(q.front(), std::out_of_range);
+    EXPECT_THROW(q.pop_front(), std::out_of_range);
+
+    q.push_back("hello", 5);
+    q.push_back("", 0);
+    memcpy(q.emplace_back(5), "world", 5);
+    EXPECT_INTEQ(q.size(), 3);
+    EXPECT_INTEQ(q.bytes(), (3 * queue::kHeaderSize + 10));
+    // Small totals stay in the inline storage.
+    EXPECT_INTEQ(q.capacity(), 64);
+
+    EXPECT(str(q.front()) == "hello");
+    q.front().data[0] = 'j';
+    EXPECT(str(q.front()) == "jello");
+    q.pop_front();
+    EXPECT_INTEQ(q.front().size, 0);
+    q.pop_front();
+    EXPECT(str(q.front()) == "world");
+    q.pop_front();
+    EXPECT(q.empty());
+    EXPECT_INTEQ(q.bytes(), 0);
+
+    std::string big(100, 'x');
+    queue::const_segment record = { big.data(), big.size() };
+    q.push_back(record);
+    EXPECT_INTEQ(q.capacity(), 128);
+    EXPECT(str(q.front()) == big);
+
+    record_deque<16, uint32_t, std::allocator<char>, uint8_t> small;
+    EXPECT_THROW(small.emplace_back(256), std::length_error);
+    small.emplace_back(255);
+    EXPECT_INTEQ(small.bytes(), 256);
+
+    return true;
+}
+
+bool test_iterate() {
+    queue q;
+    std::string expect[] = { "a", "bb", "ccc", "dddd", "eeeee" };
+    for (int round = 0; round < 20; ++round) {
+        for (const std::string& s : expect) {
+            q.push_back(s.data(), s.size());
+        }
+        int i = 0;
+        for (queue::const_segment record : q) {
+            EXPECT(str(record) == expect[i]);
+            ++i;
+        }
+        EXPECT_INTEQ(i, 5);
+        EXPECT_INTEQ(std::distance(q.cbegin(), q.cend()), 5);
+        EXPECT_THROW(q.pop_front(6), std::out_of_range);
+        q.pop_front(3);
+        EXPECT(str(*q.begin()) == "dddd");
+        q.pop_front(2);
+        EXPECT(q.begin() == q.end());
+    }
+
+    return true;
+}
+
+// Random pushes, pops and iteration, checked against a deque of
+// strings. Records of mixed sizes force padding at the end of the
+// storage.
+bool test_random() {
+    queue q;
+    std::deque<std::string> expect;
+    std::mt19937 rand(1);
+    for (int i = 0; i < 50000; ++i) {
+        uint32_t r = rand();
+        if (r % 16 < 9) {
+            std::string s((r >> 8) % (r % 4 ? 24 : 300), 'a' + i % 26);
+            q.push_back(s.data(), s.size());
+            expect.push_back(s);
+        } else if (r % 16 < 15) {
+            if (!expect.empty()) {
+                EXPECT(str(q.front()) == expect.front());
+                q.pop_front();
+                expect.pop_front();
+            }
+        } else {
+            size_t j = 0;
+            for (queue::const_segment record : q) {
+                EXPECT(str(record) == expect[j]);
+                ++j;
+            }
+            EXPECT_INTEQ(j, expect.size());
+            size_t count = (r >> 8) % (expect.size() + 1);
+            q.pop_front(count);
+            expect.erase(expect.begin(), expect.begin() + count);
+        }
+        EXPECT_INTEQ(q.size(), expect.size());
+        if (expect.size() > 64) {
+            q.clear();
+            expect.clear();
+        }
+    }
+
+    return true;
+}
+
+// Random pushes and pops on a small queue with 16 bit indices,
+// checked against a model over many seeds.
+bool test_model() {
+    typedef record_deque<16, uint16_t> small_queue;
+    for (uint32_t seed = 0; seed < 20; ++seed) {
+        small_queue q;
+        std::deque<std::string> expect;
+        std::mt19937 rand(seed);
+        for (int i = 0; i < 5000; ++i) {
+            uint32_t r = rand();
+            if (r % 2 && expect.size() < 32) {
+                std::string s((r >> 8) % 40, 'a' + i % 26);
+                q.push_back(s.data(), s.size());
+                expect.push_back(s);
+            } else if (!expect.empty()) {
+                small_queue::const_segment record =
+                    static_cast<const small_queue&>(q).front();
+                EXPECT_INTEQ(record.size, expect.front().size());
+                EXPECT(str(record) == expect.front());
+                q.pop_front();
+                expect.pop_front();
+            }
+            EXPECT_INTEQ(q.size(), expect.size());
+            size_t bytes = 0;
+            for (const std::string& s : expect) {
+                bytes += small_queue::kHeaderSize + s.size();
+            }
+            EXPECT_INTEQ(q.bytes(), bytes);
+        }
+    }
+
+    return true;
+}
+
+bool test_copy_move() {
+    queue a;
+    for (int i = 0; i < 30; ++i) {
+        std::string s(i, 'a' + i);
+        a.push_back(s.data(), s.size());
+        if (i % 3 == 0) {
+            a.pop_front();
+        }
+    }
+    EXPECT_INTEQ(a.size(), 20);
+
+    queue copy(a);
+    queue b(std::move(a));
+    EXPECT(a.empty());
+    EXPECT(a.begin() == a.end());
+    for (queue* q : { &b, &copy }) {
+        EXPECT_INTEQ(q->size(), 20);
+        int i = 10;
+        for (queue::const_segment record : *q) {
+            EXPECT(str(record) == std::string(i, 'a' + i));
+            ++i;
+        }
+    }
+
+    a = std::move(b);
+    EXPECT_INTEQ(a.size(), 20);
+    EXPECT_INTEQ(b.size(), 0);
+    b = a;
+    EXPECT_INTEQ(b.size(), 20);
+    EXPECT(str(b.front()) == str(a.front()));
+
+    return true;
+}
+
+int main(void) {
+    bool ok = true;
+    TEST(test_basic);
+    TEST(test_iterate);
+    TEST(test_random);
+    TEST(test_model);
+    TEST(test_copy_move);
+
+    return !ok;
+}
@@ -0,0 +1,155 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+
+#include <deque>
+#include <random>
+
+#include "../inline_deque.h"
+
+#include "util_test.h"
+
+typedef inline_deque<uint32_t, 8> queue;
+
+bool test_reserve_commit() {
+    for (int offset = 0; offset < 8; ++offset) {
+        queue q;
+        for (int i = 0; i < offset; ++i) {
+            q.push_back(0);
+            q.pop_front();
+        }
+        q.push_back(0);
+
+        // Fits in the current capacity; the space wraps around the
+        // end of the storage for most offsets.
+        queue::segment out[2];
+        int count = q.reserve_back(7, out);
+        EXPECT_INTEQ(q.capacity(), 8);
+        EXPECT_INTEQ(count, ((offset == 0 || offset == 7) ? 1 : 2));
+        EXPECT_INTEQ((out[0].size + (count > 1 ? out[1].size : 0)), 7);
+        uint32_t value = 1;
+        for (int i = 0; i < count; ++i) {
+            for (uint32_t& v : out[i]) {
+                v = value++;
+            }
+        }
+        // Commit only part of it.
+        q.commit_back(5);
+        EXPECT_INTEQ(q.size(), 6);
+        for (uint32_t i = 0; i < 6; ++i) {
+            EXPECT_INTEQ(q[i], i);
+        }
+
+        // Needs to grow.
+        count = q.reserve_back(100, out);
+        EXPECT_INTEQ(q.capacity(), 128);
+        EXPECT_INTEQ(count, 1);
+        EXPECT_INTEQ(out[0].size, 100);
+        for (uint32_t i = 0; i < 100; ++i) {
+            out[0].data[i] = 6 + i;
+        }
+        q.commit_back(100);
+        EXPECT_INTEQ(q.size(), 106);
+        for (uint32_t i = 0; i < 106; ++i) {
+            EXPECT_INTEQ(q[i], i);
+        }
+
+        EXPECT_INTEQ(q.reserve_back(0, out), 0);
+        EXPECT_THROW(q.commit_back(23), std::out_of_range);
+        EXPECT_INTEQ(q.size(), 106);
+    }
+
+    inline_deque<int, 1, uint8_t> small;
+    inline_deque<int, 1, uint8_t>::segment out[2];
+    small.push_back(1);
+    EXPECT_THROW(small.reserve_back(128, out), std::length_error);
+    EXPECT_INTEQ(small.reserve_back(127, out), 1);
+
+    return true;
+}
+
+bool test_peek_consume() {
+    Value::live_ = 0;
+    {
+        inline_deque<Value, 4> q;
+        for (uint32_t i = 0; i < 3; ++i) {
+            q.push_back(Value(100));
+            q.pop_front();
+        }
+        for (uint32_t i = 0; i < 4; ++i) {
+            q.push_back(Value(i));
+        }
+        const inline_deque<Value, 4>& cq = q;
+        inline_deque<Value, 4>::const_segment out[2];
+        EXPECT_INTEQ(cq.peek_front(10, out), 2);
+        EXPECT_INTEQ(out[0].size, 1);
+        EXPECT_INTEQ(out[1].size, 3);
+        EXPECT_INTEQ(out[1].data[2], 3);
+        EXPECT_INTEQ(cq.peek_front(1, out), 1);
+        EXPECT_INTEQ(out[0].size, 1);
+        EXPECT_INTEQ(out[0].data[0], 0);
+
+        q.consume_front(3);
+        EXPECT_INTEQ(Value::live_, 1);
+        EXPECT_INTEQ(q.front(), 3);
+        EXPECT_THROW(q.consume_front(2), std::out_of_range);
+        q.consume_front(1);
+        EXPECT(q.empty());
+        EXPECT_INTEQ(q.peek_front(10, out), 0);
+    }
+    EXPECT_INTEQ(Value::live_, 0);
+
+    return true;
+}
+
+// Random batches through reserve/commit and peek/consume, checked
+// against std::deque.
+bool test_random() {
+    std::mt19937 rand(1);
+    queue q;
+    std::deque<uint32_t> expect;
+    uint32_t next = 0;
+    for (int i = 0; i < 10000; ++i) {
+        size_t n = rand() % 20;
+        if (rand() % 2) {
+            queue::segment out[2];
+            int count = q.reserve_back(n, out);
+            size_t k = n ? rand() % (n + 1) : 0;
+            size_t written = 0;
+            for (int s = 0; s < count; ++s) {
+                for (size_t j = 0; j < out[s].size && written < k; ++j) {
+                    out[s].data[j] = next;
+                    expect.push_back(next++);
+                    ++written;
+                }
+            }
+            q.commit_back(k);
+        } else {
+            queue::segment out[2];
+            int count = q.peek_front(n, out);
+            size_t seen = 0;
+            for (int s = 0; s < count; ++s) {
+                for (uint32_t v : out[s]) {
+                    EXPECT_INTEQ(v, expect[seen++]);
+                }
+            }
+            EXPECT_INTEQ(seen, std::min(n, expect.size()));
+            size_t k = seen ? rand() % (seen + 1) : 0;
+            q.consume_front(k);
+            expect.erase(expect.begin(), expect.begin() + k);
+        }
+        EXPECT_INTEQ(q.size(), expect.size());
+    }
+
+    return true;
+}
+
+int main(void) {
+    bool ok = true;
+    TEST(test_reserve_commit);
+    TEST(test_peek_consume);
+    TEST(test_random);
+
+    return !ok;
+}
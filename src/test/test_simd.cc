@@ -0,0 +1,213 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+
+#include <cmath>
+#include <random>
+
+#include "../inline_deque.h"
+#include "../inline_deque_simd.h"
+
+#include "util_test.h"
+
+// Fill a queue with "size" elements from a small range of values, so
+// that there are plenty of duplicates. The queue is rotated by
+// "offset" elements first, so that it wraps around at different
+// points.
+template<class Q, typename T>
+void fill(Q* q, size_t size, size_t offset, std::mt19937_64* rand) {
+    for (size_t i = 0; i < offset; ++i) {
+        q->push_back(T());
+        q->pop_front();
+    }
+    for (size_t i = 0; i < size; ++i) {
+        q->push_back(static_cast<T>((*rand)() % 50) - 10);
+    }
+}
+
+template<typename T>
+bool test_kernels_for_type() {
+    std::mt19937_64 rand(1);
+    for (size_t size = 0; size < 150; size += 1 + size / 8) {
+        for (size_t offset = 0; offset < 70; offset += 13) {
+            inline_deque<T, 64> q;
+            fill<inline_deque<T, 64>, T>(&q, size, offset, &rand);
+
+            for (int v = -12; v < 42; v += 3) {
+                T value = static_cast<T>(v);
+                size_t expect_find = q.size();
+                size_t expect_count = 0;
+                for (size_t i = 0; i < q.size(); ++i) {
+                    if (q[i] == value) {
+                        expect_count++;
+                        if (expect_find == q.size()) {
+                            expect_find = i;
+                        }
+                    }
+                }
+                EXPECT_INTEQ(inline_deque_simd::find(q, value), expect_find);
+                EXPECT_INTEQ(inline_deque_simd::count(q, value),
+                             expect_count);
+                EXPECT(inline_deque_simd::contains(q, value) ==
+                       (expect_count > 0));
+            }
+
+            typename inline_deque_simd::sum_type<T>::type expect_sum = 0;
+            for (size_t i = 0; i < q.size(); ++i) {
+                expect_sum += q[i];
+            }
+            EXPECT(inline_deque_simd::sum(q) == expect_sum);
+
+            if (!q.empty()) {
+                T expect_min = q[0], expect_max = q[0];
+                for (size_t i = 0; i < q.size(); ++i) {
+                    expect_min = std::min(expect_min, q[i]);
+                    expect_max = std::max(expect_max, q[i]);
+                }
+                EXPECT(inline_deque_simd::min(q) == expect_min);
+                EXPECT(inline_deque_simd::max(q) == expect_max);
+            }
+
+            // Same contents, different wraparound point.
+            inline_deque<T, 1> copy;
+            for (size_t i = 0; i < q.size(); ++i) {
+                copy.push_back(q[i]);
+            }
+            EXPECT(inline_deque_simd::equal(q, copy));
+            if (!copy.empty()) {
+                copy[rand() % copy.size()] += 1;
+                EXPECT(!inline_deque_simd::equal(q, copy));
+                copy.pop_back();
+                EXPECT(!inline_deque_simd::equal(q, copy));
+            }
+        }
+    }
+
+    return true;
+}
+
+bool test_kernels() {
+    EXPECT(test_kernels_for_type<int8_t>());
+    EXPECT(test_kernels_for_type<uint8_t>());
+    EXPECT(test_kernels_for_type<int16_t>());
+    EXPECT(test_kernels_for_type<int32_t>());
+    EXPECT(test_kernels_for_type<uint32_t>());
+    EXPECT(test_kernels_for_type<int64_t>());
+    EXPECT(test_kernels_for_type<uint64_t>());
+    EXPECT(test_kernels_for_type<float>());
+    EXPECT(test_kernels_for_type<double>());
+    // No vectorized version, uses the scalar fallback.
+    EXPECT(test_kernels_for_type<long double>());
+
+    return true;
+}
+
+bool test_kernels_nan() {
+    inline_deque<double, 16> q;
+    for (int i = 0; i < 40; ++i) {
+        q.push_back(i == 17 ? NAN : i);
+    }
+
+    EXPECT_INTEQ(inline_deque_simd::find(q, (double) NAN), q.size());
+    EXPECT_INTEQ(inline_deque_simd::count(q, 18.0), 1);
+    EXPECT(!inline_deque_simd::equal(q, q));
+
+    return true;
+}
+
+bool test_kernels_empty() {
+    inline_deque<int32_t, 4> q;
+
+    EXPECT_INTEQ(inline_deque_simd::find(q, 0), 0);
+    EXPECT_INTEQ(inline_deque_simd::sum(q), 0);
+    EXPECT_THROW(inline_deque_simd::min(q), std::out_of_range);
+
+    return true;
+}
+
+// The functions accept queues with any overflow policy.
+bool test_overflow_policy() {
+    typedef inline_deque<int, 4, uint32_t, std::allocator<int>,
+                         inline_deque_bounded> bounded_queue;
+    bounded_queue q(4, std::allocator<int>(), inline_deque_bounded(8));
+    for (int i = 0; i < 10; ++i) {
+        q.push_back(i % 3);
+    }
+    EXPECT_INTEQ(q.size(), 8);
+    EXPECT_INTEQ(inline_deque_simd::find(q, 2), 2);
+    EXPECT_INTEQ(inline_deque_simd::count(q, 0), 3);
+    EXPECT(inline_deque_simd::contains(q, 1));
+    EXPECT_INTEQ(inline_deque_simd::min(q), 0);
+    EXPECT_INTEQ(inline_deque_simd::max(q), 2);
+    EXPECT_INTEQ(inline_deque_simd::sum(q), 7);
+
+    inline_deque<int, 4> copy;
+    for (int v : q) {
+        copy.push_back(v);
+    }
+    EXPECT(inline_deque_simd::equal(q, copy));
+    EXPECT(inline_deque_simd::equal(copy, q));
+
+    return true;
+}
+
+// The value is converted to the element type, so plain literals work
+// for any element type.
+bool test_literal_values() {
+    inline_deque<uint32_t, 4> q;
+    inline_deque<uint8_t, 4> bytes;
+    inline_deque<double, 4> doubles;
+    for (int i = 0; i < 20; ++i) {
+        q.push_back(i % 4);
+        bytes.push_back(i % 4);
+        doubles.push_back(i % 4);
+    }
+    EXPECT_INTEQ(inline_deque_simd::find(q, 3), 3);
+    EXPECT_INTEQ(inline_deque_simd::count(q, 1), 5);
+    EXPECT(inline_deque_simd::contains(q, 2));
+    EXPECT(!inline_deque_simd::contains(q, 4));
+    EXPECT_INTEQ(inline_deque_simd::find(bytes, 2), 2);
+    EXPECT_INTEQ(inline_deque_simd::count(bytes, 0), 5);
+    EXPECT(!inline_deque_simd::contains(bytes, 9));
+    EXPECT_INTEQ(inline_deque_simd::find(doubles, 1), 1);
+    EXPECT_INTEQ(inline_deque_simd::count(doubles, 3), 5);
+    EXPECT(inline_deque_simd::contains(doubles, 0));
+
+    return true;
+}
+
+#ifdef INLINE_DEQUE_SIMD_X86
+// The public functions use AVX2 when available, so also check the
+// SSE2 kernels directly.
+bool test_kernels_sse2() {
+    uint32_t data[37];
+    for (uint32_t i = 0; i < 37; ++i) {
+        data[i] = i % 10;
+    }
+
+    EXPECT_INTEQ(inline_deque_simd::detail::find_sse2(data, 37, 7u), 7);
+    EXPECT_INTEQ(inline_deque_simd::detail::find_sse2(data, 37, 11u), 37);
+    EXPECT_INTEQ(inline_deque_simd::detail::count_sse2(data, 37, 6u), 4);
+    EXPECT(inline_deque_simd::detail::equal_sse2(data, data, 37));
+    EXPECT(inline_deque_simd::detail::equal_sse2(data, data + 10, 27));
+    EXPECT(!inline_deque_simd::detail::equal_sse2(data, data + 1, 36));
+
+    return true;
+}
+#endif
+
+int main(void) {
+    bool ok = true;
+
+    TEST(test_kernels);
+    TEST(test_kernels_nan);
+    TEST(test_kernels_empty);
+    TEST(test_overflow_policy);
+    TEST(test_literal_values);
+#ifdef INLINE_DEQUE_SIMD_X86
+    TEST(test_kernels_sse2);
+#endif
+
+    return !ok;
+}
@@ -0,0 +1,263 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
+#include <new>
+#include <random>
+
+#include "../static_deque.h"
+
+#include "util_test.h"
+
+// Count heap allocations, to check that static_deque never makes any.
+// The replacements are kept out of line, since GCC otherwise sees
+// free() called on the result of operator new and warns about
+// mismatched allocation functions.
+static uint64_t allocations = 0;
+
+INLINE_DEQUE_NOINLINE void* operator new(size_t size) {
+    ++allocations;
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+INLINE_DEQUE_NOINLINE void operator delete(void* p) noexcept {
+    free(p);
+}
+
+INLINE_DEQUE_NOINLINE void operator delete(void* p,
+                                           size_t size) noexcept {
+    free(p);
+}
+
+static_assert(sizeof(static_deque<uint32_t, 16>) == 16 * 4 + 2 * 4,
+              "No overhead beyond the elements and indices");
+static_assert(sizeof(static_deque<uint8_t, 64, inline_deque_overflow::reject,
+                                  uint8_t>) == 64 + 2,
+              "Small index types");
+
+bool test_reject() {
+    Value::live_ = 0;
+    {
+        static_deque<Value, 4> q;
+        EXPECT(q.push_back(Value(1)));
+        EXPECT(q.push_back(Value(2)));
+        EXPECT(q.push_front(Value(0)));
+        EXPECT(q.emplace_back(3));
+        EXPECT(q.full());
+        EXPECT(!q.push_back(Value(4)));
+        EXPECT(!q.push_front(Value(4)));
+        EXPECT(!q.emplace_back(4));
+        EXPECT_INTEQ(q.size(), 4);
+        for (int i = 0; i < 4; ++i) {
+            EXPECT_INTEQ(q[i], i);
+        }
+        q.pop_front();
+        EXPECT(!q.full());
+        EXPECT(q.push_back(Value(4)));
+        EXPECT_INTEQ(q.front(), 1);
+        EXPECT_INTEQ(q.back(), 4);
+    }
+    EXPECT_INTEQ(Value::live_, 0);
+
+    // drop_newest is the same as reject.
+    static_deque<int, 2, inline_deque_overflow::drop_newest> q;
+    EXPECT(q.push_back(1));
+    EXPECT(q.push_back(2));
+    EXPECT(!q.push_back(3));
+    EXPECT(!q.emplace_front(0));
+    EXPECT_INTEQ(q.front(), 1);
+    EXPECT_INTEQ(q.back(), 2);
+
+    return true;
+}
+
+bool test_overwrite() {
+    Value::live_ = 0;
+    {
+        static_deque<Value, 4, inline_deque_overflow::overwrite_oldest> q;
+        for (uint32_t i = 0; i < 10; ++i) {
+            EXPECT(q.push_back(Value(i)));
+            EXPECT_INTEQ(q.back(), i);
+        }
+        EXPECT_INTEQ(q.size(), 4);
+        EXPECT_INTEQ(Value::live_, 4);
+        for (int i = 0; i < 4; ++i) {
+            EXPECT_INTEQ(q[i], (6 + i));
+        }
+
+        // Overwriting with a copy of the element being dropped.
+        q.push_back(q.front());
+        EXPECT_INTEQ(q.back(), 6);
+        EXPECT_INTEQ(q.front(), 7);
+        q.push_front(q.back());
+        EXPECT_INTEQ(q.front(), 6);
+        EXPECT_INTEQ(q.back(), 9);
+        EXPECT_INTEQ(q.size(), 4);
+    }
+    EXPECT_INTEQ(Value::live_, 0);
+
+    return true;
+}
+
+bool test_abort_not_full() {
+    static_deque<int, 2, inline_deque_overflow::abort> q;
+    EXPECT(q.push_back(1));
+    EXPECT(q.push_front(0));
+    EXPECT(q.full());
+    q.pop_back();
+    EXPECT(q.push_back(2));
+    EXPECT_INTEQ(q[1], 2);
+
+    return true;
+}
+
+bool test_no_allocation() {
+    uint64_t before = allocations;
+    {
+        typedef static_deque<Value, 64,
+                             inline_deque_overflow::overwrite_oldest> Queue;
+        Queue q;
+        for (uint32_t i = 0; i < 1000; ++i) {
+            q.push_back(Value(i));
+            q.push_front(Value(i));
+            if (i % 3 == 0) {
+                q.pop_back();
+            }
+        }
+        Queue copy(q);
+        Queue moved(std::move(copy));
+        q = moved;
+        q.clear();
+    }
+    EXPECT_INTEQ(allocations, before);
+    EXPECT_INTEQ(Value::live_, 0);
+
+    return true;
+}
+
+bool test_copy_move() {
+    Value::live_ = 0;
+    {
+        static_deque<Value, 8> q;
+        for (uint32_t i = 0; i < 6; ++i) {
+            q.push_back(Value(i));
+        }
+        static_deque<Value, 8> copy(q);
+        static_deque<Value, 8> moved(std::move(q));
+        EXPECT(q.empty());
+        EXPECT_INTEQ(copy.size(), 6);
+        EXPECT_INTEQ(moved.size(), 6);
+        q = copy;
+        copy = std::move(moved);
+        EXPECT(moved.empty());
+        for (int i = 0; i < 6; ++i) {
+            EXPECT_INTEQ(q[i], i);
+            EXPECT_INTEQ(copy[i], i);
+        }
+        int i = 0;
+        for (auto it = copy.cbegin(); it != copy.cend(); ++it, ++i) {
+            EXPECT_INTEQ(*it, i);
+        }
+        EXPECT_INTEQ(i, 6);
+        EXPECT_INTEQ((copy.end() - copy.begin()), 6);
+    }
+    EXPECT_INTEQ(Value::live_, 0);
+
+    return true;
+}
+
+// Indices wrap around the full range of a small CapacityType.
+bool test_random() {
+    std::mt19937 rand(1);
+    static_deque<uint32_t, 64, inline_deque_overflow::reject, uint8_t> q;
+    std::deque<uint32_t> expect;
+    for (int i = 0; i < 100000; ++i) {
+        uint32_t r = rand();
+        switch (r % 4) {
+        case 0:
+            EXPECT_INTEQ(q.push_back(r), (expect.size() < 64));
+            if (expect.size() < 64) {
+                expect.push_back(r);
+            }
+            break;
+        case 1:
+            EXPECT_INTEQ(q.push_front(r), (expect.size() < 64));
+            if (expect.size() < 64) {
+                expect.push_front(r);
+            }
+            break;
+        case 2:
+            if (!expect.empty()) {
+                q.pop_front();
+                expect.pop_front();
+            } else {
+                EXPECT_THROW(q.pop_front(), std::out_of_range);
+            }
+            break;
+        case 3:
+            if (!expect.empty()) {
+                q.pop_back();
+                expect.pop_back();
+            } else {
+                EXPECT_THROW(q.back(), std::out_of_range);
+            }
+            break;
+        }
+        EXPECT_INTEQ(q.size(), expect.size());
+        if (!expect.empty()) {
+            size_t j = r % expect.size();
+            EXPECT_INTEQ(q.at(j), expect[j]);
+        }
+        EXPECT_THROW(q.at(expect.size()), std::out_of_range);
+    }
+
+    return true;
+}
+
+// The iterators are random access, with the full set of comparisons.
+bool test_iterators() {
+    typedef static_deque<uint32_t, 512> queue;
+    queue q;
+    for (uint32_t i = 0; i < 300; ++i) {
+        q.push_back(i * 37 % 300);
+    }
+    std::sort(q.begin(), q.end());
+    for (uint32_t i = 0; i < 300; ++i) {
+        EXPECT_INTEQ(q[i], i);
+    }
+
+    queue::iterator a = q.begin() + 10;
+    queue::iterator b = 20 + q.begin();
+    EXPECT(a < b && b > a && a <= b && b >= a && a <= a && a >= a);
+    EXPECT(!(b < a) && !(a > b) && !(b <= a) && !(a >= b));
+    EXPECT(b - a == 10);
+    EXPECT_INTEQ(a[5], 15);
+
+    queue::const_iterator c = a;
+    EXPECT(c == q.cbegin() + 10);
+    EXPECT(q.cend() - c == 290);
+    EXPECT_INTEQ(*std::lower_bound(q.cbegin(), q.cend(), 42u), 42);
+
+    return true;
+}
+
+int main(void) {
+    bool ok = true;
+    TEST(test_reject);
+    TEST(test_overwrite);
+    TEST(test_abort_not_full);
+    TEST(test_no_allocation);
+    TEST(test_copy_move);
+    TEST(test_random);
+    TEST(test_iterators);
+
+    return !ok;
+}
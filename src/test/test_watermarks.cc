@@ -0,0 +1,200 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+
+#include <vector>
+
+#include "../inline_deque.h"
+
+#include "util_test.h"
+
+typedef inline_deque_watermarks<> watermarks;
+typedef inline_deque<int, 4, uint32_t, std::allocator<int>,
+                     watermarks> watermark_queue;
+
+static std::vector<bool> events;
+
+static void record(bool above) {
+    events.push_back(above);
+}
+
+static watermark_queue make_queue(size_t high, size_t low) {
+    events.clear();
+    return watermark_queue(4, std::allocator<int>(),
+                           watermarks(high, low, record));
+}
+
+bool test_push_pop() {
+    watermark_queue q = make_queue(10, 5);
+    for (int i = 0; i < 9; ++i) {
+        q.push_back(i);
+    }
+    EXPECT(!q.overflow_policy().above_high_watermark());
+    EXPECT_INTEQ(events.size(), 0);
+
+    q.push_front(9);
+    EXPECT(q.overflow_policy().above_high_watermark());
+    EXPECT_INTEQ(events.size(), 1);
+    EXPECT(events[0]);
+
+    // Moving around between the watermarks fires nothing.
+    for (int i = 0; i < 100; ++i) {
+        q.emplace_back(i);
+        q.pop_front();
+        q.pop_front();
+        q.emplace_front(i);
+    }
+    for (int i = 0; i < 4; ++i) {
+        q.pop_back();
+    }
+    q.push_back(1);
+    q.push_back(1);
+    EXPECT_INTEQ(events.size(), 1);
+    EXPECT_INTEQ(q.size(), 8);
+
+    while (q.size() > 5) {
+        q.pop_back();
+    }
+    EXPECT(!q.overflow_policy().above_high_watermark());
+    EXPECT_INTEQ(events.size(), 2);
+    EXPECT(!events[1]);
+
+    // And the next crossing fires again.
+    for (int i = 0; i < 5; ++i) {
+        q.push_back(i);
+    }
+    EXPECT_INTEQ(events.size(), 3);
+    EXPECT(events[2]);
+
+    return true;
+}
+
+bool test_insert_erase_clear() {
+    watermark_queue q = make_queue(4, 2);
+    q.insert(q.begin(), 3, 1);
+    EXPECT_INTEQ(events.size(), 0);
+    q.emplace(q.begin() + 1, 2);
+    EXPECT_INTEQ(events.size(), 1);
+    q.erase(q.begin(), q.begin() + 1);
+    EXPECT_INTEQ(events.size(), 1);
+    q.erase(q.begin());
+    EXPECT_INTEQ(events.size(), 2);
+    q.insert(q.end(), 5);
+    q.insert(q.end(), 6);
+    EXPECT_INTEQ(events.size(), 3);
+    q.clear();
+    EXPECT_INTEQ(events.size(), 4);
+    EXPECT(!events[3]);
+
+    return true;
+}
+
+bool test_without_callback() {
+    watermark_queue q(4, std::allocator<int>(), watermarks(3, 0));
+    q.push_back(1);
+    q.push_back(2);
+    EXPECT(!q.overflow_policy().above_high_watermark());
+    q.push_back(3);
+    EXPECT(q.overflow_policy().above_high_watermark());
+    q.pop_back();
+    EXPECT(q.overflow_policy().above_high_watermark());
+    q.pop_back();
+    q.pop_back();
+    EXPECT(!q.overflow_policy().above_high_watermark());
+
+    q.overflow_policy().set_watermarks(1, 0);
+    q.push_back(1);
+    EXPECT(q.overflow_policy().above_high_watermark());
+    EXPECT_INTEQ(q.overflow_policy().high_watermark(), 1);
+    EXPECT_INTEQ(q.overflow_policy().low_watermark(), 0);
+
+    return true;
+}
+
+bool test_bounded() {
+    typedef inline_deque_watermarks<inline_deque_bounded> policy;
+    int above = 0;
+    inline_deque<int, 1, uint32_t, std::allocator<int>, policy> q(
+        1, std::allocator<int>(),
+        policy(8, 4, [&](bool a) { above += a ? 1 : -1; },
+               inline_deque_bounded(8, inline_deque_overflow::drop_newest)));
+    for (int i = 0; i < 20; ++i) {
+        q.push_back(i);
+    }
+    EXPECT_INTEQ(q.size(), 8);
+    EXPECT_INTEQ(q.overflow_policy().drops(), 12);
+    EXPECT_INTEQ(above, 1);
+    while (!q.empty()) {
+        q.pop_front();
+    }
+    EXPECT_INTEQ(above, 0);
+
+    return true;
+}
+
+bool test_destroy_move() {
+    // Destroying a queue above the high watermark fires nothing.
+    {
+        watermark_queue q = make_queue(2, 0);
+        q.push_back(1);
+        q.push_back(2);
+        EXPECT_INTEQ(events.size(), 1);
+    }
+    EXPECT_INTEQ(events.size(), 1);
+
+    // Neither does assigning over one.
+    {
+        watermark_queue q = make_queue(2, 0);
+        watermark_queue empty = q;
+        q.push_back(1);
+        q.push_back(2);
+        q = empty;
+        EXPECT(!q.overflow_policy().above_high_watermark());
+        q.push_back(1);
+        q.push_back(2);
+        q = watermark_queue(4, std::allocator<int>(),
+                            watermarks(2, 0, record));
+        EXPECT(!q.overflow_policy().above_high_watermark());
+        EXPECT_INTEQ(events.size(), 2);
+    }
+    EXPECT_INTEQ(events.size(), 2);
+
+    // The crossing moves with the elements, and is reported once
+    // when the queue it was moved to drains.
+    {
+        watermark_queue a = make_queue(2, 0);
+        a.push_back(1);
+        a.push_back(2);
+        watermark_queue b(std::move(a));
+        EXPECT(!a.overflow_policy().above_high_watermark());
+        EXPECT(b.overflow_policy().above_high_watermark());
+        watermark_queue c = make_queue(2, 0);
+        c = std::move(b);
+        EXPECT(!b.overflow_policy().above_high_watermark());
+        a.clear();
+        b.clear();
+        EXPECT_INTEQ(events.size(), 0);
+        c.pop_back();
+        c.pop_back();
+        EXPECT_INTEQ(events.size(), 1);
+        EXPECT(!events[0]);
+        c.push_back(1);
+        c.push_back(2);
+    }
+    EXPECT_INTEQ(events.size(), 2);
+    EXPECT(events[1]);
+
+    return true;
+}
+
+int main(void) {
+    bool ok = true;
+    TEST(test_push_pop);
+    TEST(test_insert_erase_clear);
+    TEST(test_without_callback);
+    TEST(test_bounded);
+    TEST(test_destroy_move);
+
+    return !ok;
+}
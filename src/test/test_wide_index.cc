@@ -0,0 +1,273 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+//
+// Index math for queues with 64 bit indices, and for queues with more
+// than 2^32 elements. The large queues are stored in sparse memory
+// mappings, and are filled by moving the indices rather than by
+// pushing elements, so only the pages that are actually accessed
+// use any memory.
+
+#include <sys/mman.h>
+
+#include <deque>
+#include <random>
+
+#include "../inline_deque.h"
+#include "../inline_deque_allocator.h"
+
+#include "util_test.h"
+
+// An allocator for sparse buffers, which are only backed by memory
+// once touched. Reallocation remaps the pages without copying.
+template<typename T>
+struct sparse_allocator : realloc_allocator<T> {
+    template<typename U>
+    struct rebind {
+        typedef sparse_allocator<U> other;
+    };
+
+    T* allocate(size_t n) {
+        void* p = mmap(NULL, n * sizeof(T), PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, size_t n) {
+        munmap(p, n * sizeof(T));
+    }
+
+    T* reallocate(T* p, size_t old_n, size_t new_n) {
+        void* new_p = mremap(p, old_n * sizeof(T), new_n * sizeof(T),
+                             MREMAP_MAYMOVE);
+        if (new_p == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(new_p);
+    }
+};
+
+// Allow placing the indices anywhere in their range.
+template<typename Q>
+struct indexed_queue : Q {
+    typedef typename Q::size_type size_type;
+
+    indexed_queue(size_t initial_capacity) : Q(initial_capacity) {
+    }
+
+    // Only valid for trivial types, or with no elements.
+    void set_indices(size_type read, size_type write) {
+        this->ptr_.read_ = read;
+        this->ptr_.write_ = write;
+    }
+
+    size_type read_index() const {
+        return this->ptr_.read_;
+    }
+};
+
+typedef indexed_queue<inline_deque<char, 1, uint64_t,
+                                   sparse_allocator<char>>> sparse_queue;
+
+bool test_initial_capacity() {
+    typedef inline_deque<int, 1, uint8_t> small_queue;
+    EXPECT_INTEQ(small_queue(128).capacity(), 128);
+    EXPECT_THROW(small_queue(129), std::length_error);
+    EXPECT_THROW(small_queue(1000), std::length_error);
+
+    typedef inline_deque<int, 1, uint32_t> queue32;
+    EXPECT_THROW(queue32(uint64_t(1) << 32), std::length_error);
+
+    return true;
+}
+
+// Random operations on a queue whose indices start just before
+// "start", checked against std::deque.
+template<typename CapacityType>
+bool check_indices(CapacityType start) {
+    Value::live_ = 0;
+    {
+        typedef inline_deque<Value, 1, CapacityType> base;
+        indexed_queue<base> q(128);
+        std::deque<uint32_t> expect;
+        std::mt19937 rand(1);
+
+        q.set_indices(start - 1000, start - 1000);
+        bool crossed = false;
+        for (uint32_t i = 0; i < 20000; ++i) {
+            uint32_t r = rand();
+            switch (r % 8) {
+            case 0:
+            case 1:
+            case 2:
+                if (expect.size() < 100) {
+                    q.push_back(Value(i));
+                    expect.push_back(i);
+                }
+                break;
+            case 3:
+                if (expect.size() < 100) {
+                    q.push_front(Value(i));
+                    expect.push_front(i);
+                }
+                break;
+            case 4:
+            case 5:
+                if (!expect.empty()) {
+                    q.pop_front();
+                    expect.pop_front();
+                }
+                break;
+            case 6:
+                if (expect.size() < 100) {
+                    size_t pos = r % (expect.size() + 1);
+                    q.insert(q.begin() + pos, Value(i));
+                    expect.insert(expect.begin() + pos, i);
+                }
+                break;
+            case 7:
+                if (!expect.empty()) {
+                    size_t pos = r % expect.size();
+                    q.erase(q.begin() + pos);
+                    expect.erase(expect.begin() + pos);
+                }
+                break;
+            }
+            EXPECT_INTEQ(q.size(), expect.size());
+            EXPECT_INTEQ((q.end() - q.begin()), expect.size());
+            if (!expect.empty()) {
+                size_t j = r % expect.size();
+                EXPECT_INTEQ(q.at(j), expect[j]);
+                EXPECT_INTEQ(q.back(), expect.back());
+            }
+            if (q.read_index() - (start - 1000) > 1000 &&
+                q.read_index() - (start - 1000) < 2000) {
+                crossed = true;
+            }
+        }
+        // The queue never needed to be resized, which would have
+        // reset the indices.
+        EXPECT_INTEQ(q.capacity(), 128);
+        EXPECT(crossed);
+        for (size_t j = 0; j < expect.size(); ++j) {
+            EXPECT_INTEQ(q[j], expect[j]);
+        }
+    }
+    EXPECT_INTEQ(Value::live_, 0);
+
+    return true;
+}
+
+bool test_index_wrap() {
+    EXPECT(check_indices<uint64_t>(0));
+    EXPECT(check_indices<uint64_t>(uint64_t(1) << 32));
+    EXPECT(check_indices<uint64_t>(uint64_t(1) << 63));
+    EXPECT(check_indices<uint32_t>(0));
+    EXPECT(check_indices<uint16_t>(0));
+
+    return true;
+}
+
+// A queue of more than 2^32 elements, with the elements wrapping
+// around the end of the buffer.
+bool test_over_4g() {
+    const uint64_t capacity = uint64_t(1) << 33;
+    const uint64_t size = (uint64_t(1) << 32) + 16;
+    const uint64_t read = capacity - 16;
+    sparse_queue q(capacity);
+    EXPECT_INTEQ(q.capacity(), capacity);
+    q.set_indices(read, read + size);
+    EXPECT_INTEQ(q.size(), size);
+
+    const uint64_t marks[] = {
+        0, 15, 16, (uint64_t(1) << 32) - 1, uint64_t(1) << 32, size - 1,
+    };
+    for (int i = 0; i < 6; ++i) {
+        q[marks[i]] = 'a' + i;
+    }
+    for (int i = 0; i < 6; ++i) {
+        EXPECT_INTEQ(q.at(marks[i]), ('a' + i));
+        EXPECT_INTEQ(q.begin()[marks[i]], ('a' + i));
+    }
+    EXPECT_INTEQ(q.front(), 'a');
+    EXPECT_INTEQ(q.back(), 'f');
+    EXPECT_THROW(q.at(size), std::out_of_range);
+    EXPECT_INTEQ((q.end() - q.begin()), size);
+    EXPECT_INTEQ(*(q.end() - 1), 'f');
+
+    sparse_queue::segment segments[2];
+    EXPECT_INTEQ(q.segments(segments), 2);
+    EXPECT_INTEQ(segments[0].size, 16);
+    EXPECT_INTEQ(segments[1].size, (size - 16));
+    EXPECT_INTEQ(segments[1].data[0], 'c');
+
+    q.push_back('g');
+    q.push_front('z');
+    EXPECT_INTEQ(q.size(), (size + 2));
+    EXPECT_INTEQ(q.back(), 'g');
+    EXPECT_INTEQ(q[1], 'a');
+    q.pop_front();
+    q.pop_back();
+
+    // Grow past 2^33 elements. Only the 16 elements at the end of
+    // the buffer get moved.
+    q.set_indices(read, read + capacity - 1);
+    q[capacity - 2] = 'y';
+    q.push_back('x');
+    EXPECT_INTEQ(q.capacity(), capacity);
+    q.push_back('w');
+    EXPECT_INTEQ(q.capacity(), (capacity * 2));
+    EXPECT_INTEQ(q.size(), (capacity + 1));
+    for (int i = 0; i < 6; ++i) {
+        EXPECT_INTEQ(q[marks[i]], ('a' + i));
+    }
+    EXPECT_INTEQ(q[capacity - 2], 'y');
+    EXPECT_INTEQ(q[capacity - 1], 'x');
+    EXPECT_INTEQ(q.back(), 'w');
+
+    q.set_indices(0, 0);
+
+    return true;
+}
+
+// A queue of max_size() elements must neither shrink nor grow.
+bool test_max_size() {
+    typedef indexed_queue<inline_deque<char, 1, uint32_t,
+                                       sparse_allocator<char>>> queue32;
+    queue32 q(uint64_t(1) << 31);
+    EXPECT_INTEQ(q.max_size(), (uint64_t(1) << 31));
+    EXPECT_INTEQ(q.capacity(), q.max_size());
+    q.set_indices(0, q.max_size());
+    EXPECT_INTEQ(q.size(), q.max_size());
+    q[0] = 'a';
+    q[q.size() - 1] = 'b';
+
+    q.shrink_to_fit();
+    EXPECT_INTEQ(q.capacity(), q.max_size());
+    EXPECT_THROW(q.push_back('c'), std::length_error);
+    EXPECT_THROW(q.push_front('c'), std::length_error);
+    EXPECT_INTEQ(q.front(), 'a');
+    EXPECT_INTEQ(q.back(), 'b');
+
+    q.pop_back();
+    EXPECT_INTEQ(q.capacity(), q.max_size());
+    EXPECT_INTEQ(q.front(), 'a');
+
+    q.set_indices(0, 0);
+
+    return true;
+}
+
+int main(void) {
+    bool ok = true;
+    TEST(test_initial_capacity);
+    TEST(test_index_wrap);
+    TEST(test_over_4g);
+    TEST(test_max_size);
+
+    return !ok;
+}
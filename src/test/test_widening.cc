@@ -0,0 +1,213 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+
+#include <algorithm>
+#include <deque>
+
+#include "../widening_deque.h"
+
+#include "util_test.h"
+
+static_assert(sizeof(widening_deque<uint32_t, 2, uint16_t>) ==
+              sizeof(inline_deque<uint32_t, 2, uint16_t>),
+              "Same layout as the small inline_deque");
+static_assert(sizeof(widening_deque<uint32_t, 2, uint16_t>) <
+              sizeof(inline_deque<uint32_t, 2, uint32_t>),
+              "Smaller than an inline_deque with wide indices");
+
+typedef widening_deque<Value, 4, uint8_t, uint32_t> small_widening;
+
+template<typename Q, typename E>
+bool check_equal(const Q& q, const E& expect) {
+    EXPECT_INTEQ(q.size(), expect.size());
+    for (size_t i = 0; i < expect.size(); ++i) {
+        EXPECT_INTEQ(q[i], expect[i]);
+    }
+    size_t i = 0;
+    for (auto it = q.begin(); it != q.end(); ++it, ++i) {
+        EXPECT_INTEQ(*it, expect[i]);
+    }
+    if (!expect.empty()) {
+        EXPECT_INTEQ(q.front(), expect.front());
+        EXPECT_INTEQ(q.back(), expect.back());
+    }
+    return true;
+}
+
+bool test_widen() {
+    Value::live_ = 0;
+    {
+        small_widening q;
+        std::deque<uint32_t> expect;
+        // uint8_t indices allow up to 128 elements.
+        for (uint32_t i = 0; i < 128; ++i) {
+            q.push_back(Value(i));
+            expect.push_back(i);
+        }
+        EXPECT(!q.widened());
+        EXPECT_INTEQ(q.capacity(), 128);
+        EXPECT(check_equal(q, expect));
+
+        q.push_front(Value(1000));
+        expect.push_front(1000);
+        EXPECT(q.widened());
+        EXPECT_INTEQ(q.capacity(), 256);
+        EXPECT(check_equal(q, expect));
+
+        for (uint32_t i = 0; i < 10000; ++i) {
+            q.emplace_back(i);
+            expect.push_back(i);
+        }
+        EXPECT(check_equal(q, expect));
+        EXPECT_INTEQ(Value::live_, expect.size());
+
+        while (expect.size() > 1) {
+            q.pop_front();
+            expect.pop_front();
+            q.pop_back();
+            expect.pop_back();
+        }
+        EXPECT(q.widened());
+        EXPECT(check_equal(q, expect));
+        EXPECT_INTEQ(q.at(0), expect[0]);
+        EXPECT_THROW(q.at(1), std::out_of_range);
+
+        q.clear();
+        EXPECT(!q.widened());
+        EXPECT(q.empty());
+        EXPECT_THROW(q.front(), std::out_of_range);
+        q.push_back(Value(5));
+        EXPECT_INTEQ(q.front(), 5);
+    }
+    EXPECT_INTEQ(Value::live_, 0);
+
+    return true;
+}
+
+bool test_copy_move() {
+    Value::live_ = 0;
+    {
+        small_widening wide;
+        std::deque<uint32_t> expect_wide;
+        for (uint32_t i = 0; i < 200; ++i) {
+            wide.push_back(Value(i));
+            expect_wide.push_back(i);
+        }
+        small_widening small;
+        std::deque<uint32_t> expect_small;
+        for (uint32_t i = 0; i < 20; ++i) {
+            small.push_back(Value(i));
+            expect_small.push_back(i);
+        }
+        EXPECT(wide.widened());
+        EXPECT(!small.widened());
+
+        small_widening copy(wide);
+        EXPECT(copy.widened());
+        EXPECT(check_equal(copy, expect_wide));
+
+        small_widening moved(std::move(copy));
+        EXPECT(moved.widened());
+        EXPECT(check_equal(moved, expect_wide));
+        EXPECT(copy.empty());
+        EXPECT(!copy.widened());
+
+        copy = small;
+        EXPECT(check_equal(copy, expect_small));
+        copy = moved;
+        EXPECT(check_equal(copy, expect_wide));
+        // Moving a wide queue onto a small one with heap storage.
+        small = std::move(moved);
+        EXPECT(check_equal(small, expect_wide));
+        EXPECT(moved.empty());
+        moved = std::move(small);
+        EXPECT(check_equal(moved, expect_wide));
+        small_widening other;
+        other.push_back(Value(1));
+        moved = std::move(other);
+        EXPECT_INTEQ(moved.size(), 1);
+        EXPECT(!moved.widened());
+    }
+    EXPECT_INTEQ(Value::live_, 0);
+
+    return true;
+}
+
+// A failed promotion leaves the small queue as it was, without
+// leaking the wide queue.
+bool test_widen_failure() {
+    typedef widening_deque<Value, 4, uint8_t, uint32_t,
+                           failing_allocator<Value>> failing_widening;
+    Value::live_ = 0;
+    // The promotion allocates the wide queue, and then its storage.
+    for (int budget = 0; budget <= 2; ++budget) {
+        {
+            failing_widening q;
+            std::deque<uint32_t> expect;
+            for (uint32_t i = 0; i < 128; ++i) {
+                q.push_back(Value(i));
+                expect.push_back(i);
+            }
+            int allocations = live_allocations;
+            alloc_budget = budget;
+            if (budget < 2) {
+                EXPECT_THROW(q.push_back(Value(128)), std::bad_alloc);
+                EXPECT(!q.widened());
+                EXPECT_INTEQ(live_allocations, allocations);
+            } else {
+                q.push_back(Value(128));
+                expect.push_back(128);
+                EXPECT(q.widened());
+            }
+            alloc_budget = -1;
+            EXPECT(check_equal(q, expect));
+            q.push_front(Value(1000));
+            expect.push_front(1000);
+            EXPECT(q.widened());
+            EXPECT(check_equal(q, expect));
+        }
+        EXPECT_INTEQ(Value::live_, 0);
+        EXPECT_INTEQ(live_allocations, 0);
+    }
+
+    return true;
+}
+
+// The iterators are random access, with the full set of comparisons.
+bool test_iterators() {
+    typedef widening_deque<uint32_t, 4, uint8_t, uint32_t> queue;
+    queue q;
+    for (uint32_t i = 0; i < 300; ++i) {
+        q.push_back(i * 37 % 300);
+    }
+    std::sort(q.begin(), q.end());
+    for (uint32_t i = 0; i < 300; ++i) {
+        EXPECT_INTEQ(q[i], i);
+    }
+
+    queue::iterator a = q.begin() + 10;
+    queue::iterator b = 20 + q.begin();
+    EXPECT(a < b && b > a && a <= b && b >= a && a <= a && a >= a);
+    EXPECT(!(b < a) && !(a > b) && !(b <= a) && !(a >= b));
+    EXPECT(b - a == 10);
+    EXPECT_INTEQ(a[5], 15);
+
+    queue::const_iterator c = a;
+    EXPECT(c == q.cbegin() + 10);
+    EXPECT(q.cend() - c == 290);
+    EXPECT_INTEQ(*std::lower_bound(q.cbegin(), q.cend(), 42u), 42);
+
+    return true;
+}
+
+int main(void) {
+    bool ok = true;
+    TEST(test_widen);
+    TEST(test_copy_move);
+    TEST(test_widen_failure);
+    TEST(test_iterators);
+
+    return !ok;
+}
@@ -7,6 +7,8 @@
 #define UTIL_TEST_H
 
 #include <cassert>
+#include <memory>
+#include <new>
 
 #define TEST(fun) \
     do {                                              \
@@ -63,29 +65,55 @@
         }                                               \
     } while (0)
 
-// A class with some move semantics
+// A class with some move semantics. Every construction, copy, move
+// and destruction is counted, so that tests can check how much work
+// an operation did on the elements (see Value::Counts).
 class Value {
 public:
+    struct Counts {
+        // All constructions, including copy and move constructions.
+        uint64_t constructs = 0;
+        // Copy constructions and copy assignments.
+        uint64_t copies = 0;
+        // Move constructions and move assignments.
+        uint64_t moves = 0;
+        uint64_t destroys = 0;
+
+        Counts operator-(const Counts& other) const {
+            Counts ret;
+            ret.constructs = constructs - other.constructs;
+            ret.copies = copies - other.copies;
+            ret.moves = moves - other.moves;
+            ret.destroys = destroys - other.destroys;
+            return ret;
+        }
+    };
+
     explicit Value(uint32_t val) : val_(val) {
         ++live_;
+        ++counts_.constructs;
     }
 
     Value(const Value& other) : Value(other.val_) {
+        ++counts_.copies;
     }
 
     Value(Value&& other) : Value(other.val_) {
         other.val_ = 0x88888888;
+        ++counts_.moves;
     }
 
     ~Value() {
         val_ = 0xffffffff;
         deleted_ = true;
         --live_;
+        ++counts_.destroys;
     }
 
     Value& operator=(const Value& other) {
         assert(!deleted_);
         val_ = other.val_;
+        ++counts_.copies;
         return *this;
     }
 
@@ -93,6 +121,7 @@ public:
         assert(!deleted_);
         val_ = other.val_;
         other.val_ = 0x88888888;
+        ++counts_.moves;
         return *this;
     }
 
@@ -107,6 +136,7 @@ public:
 
 
     static uint64_t live_;
+    static Counts counts_;
 
 private:
     uint32_t val_;
@@ -114,5 +144,42 @@ private:
 };
 
 uint64_t Value::live_ = 0;
+Value::Counts Value::counts_;
+
+// Fails allocations once alloc_budget runs out (unless it's
+// negative), and counts the live allocations.
+int alloc_budget = -1;
+int live_allocations = 0;
+
+template<typename T>
+struct failing_allocator : std::allocator<T> {
+    template<typename U>
+    struct rebind {
+        typedef failing_allocator<U> other;
+    };
+
+    failing_allocator() {
+    }
+
+    template<typename U>
+    failing_allocator(const failing_allocator<U>& other) {
+    }
+
+    T* allocate(size_t n) {
+        if (alloc_budget == 0) {
+            throw std::bad_alloc();
+        }
+        if (alloc_budget > 0) {
+            --alloc_budget;
+        }
+        ++live_allocations;
+        return std::allocator<T>::allocate(n);
+    }
+
+    void deallocate(T* p, size_t n) {
+        --live_allocations;
+        std::allocator<T>::deallocate(p, n);
+    }
+};
 
 #endif // UTIL_TEST_H
@@ -0,0 +1,352 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+//
+// widening_deque is an inline_deque (see inline_deque.h) with small
+// indices that are transparently widened if the queue gets large.
+//
+// The index type of an inline_deque is usually chosen to be large
+// enough for the largest queue that could ever happen, even if almost
+// all queues are small. A widening_deque starts out as an inline_deque
+// with SmallType indices (e.g. uint16_t), which makes the queue header
+// smaller. When the queue would grow beyond the max_size() of
+// SmallType indices, rather than raising std::length_error it moves
+// its elements to a separately allocated inline_deque with WideType
+// indices, and forwards all operations to it from then on.
+//
+// The promoted state is marked by a capacity of 0, which isn't
+// otherwise possible since InlineCapacity must be at least 1. A
+// promoted queue stays promoted until it's cleared or assigned to.
+// If the promotion throws, the queue stays unpromoted.
+//
+// Template parameters:
+//
+// * typename T, size_t InlineCapacity, class Allocator
+//   As for inline_deque. InlineCapacity must be at least 1.
+// * typename SmallType
+//   The type of the indices before promotion.
+// * typename WideType
+//   The type of the indices after promotion.
+//
+// The API is a subset of the inline_deque one:
+//
+// * widening_deque(const Allocator& alloc = Allocator())
+// * push_front(), push_back(), emplace_front(), emplace_back()
+// * pop_front(), pop_back()
+// * front(), back(), operator[], at()
+// * empty(), size(), max_size(), capacity(), clear()
+// * begin(), end(), cbegin(), cend() (random access iterators)
+// * copy and move construction / assignment
+// * get_allocator()
+//
+// Additionally:
+//
+// * bool widened() const
+//   Return true if the queue has been promoted to wide indices.
+//
+// Invalidation: As for inline_deque. The promotion invalidates
+// references.
+
+#ifndef WIDENING_DEQUE_H
+#define WIDENING_DEQUE_H
+
+#include <new>
+
+#include "inline_deque.h"
+
+template<typename T,
+         size_t InlineCapacity = 1,
+         typename SmallType = uint16_t,
+         typename WideType = uint64_t,
+         class Allocator = std::allocator<T>>
+class widening_deque
+    : protected inline_deque<T, InlineCapacity, SmallType, Allocator> {
+public:
+    static_assert(InlineCapacity > 0,
+                  "InlineCapacity must be at least 1");
+    static_assert(sizeof(WideType) > sizeof(SmallType),
+                  "WideType must be wider than SmallType");
+
+    typedef inline_deque<T, InlineCapacity, SmallType, Allocator> small_type;
+    typedef inline_deque<T, 0, WideType, Allocator> wide_type;
+
+    typedef T value_type;
+    typedef Allocator allocator_type;
+    typedef WideType size_type;
+    typedef ptrdiff_t difference_type;
+    typedef T& reference;
+    typedef const T& const_reference;
+
+    explicit widening_deque(const Allocator& alloc = Allocator())
+        : small_type(InlineCapacity, alloc) {
+    }
+
+    ~widening_deque() {
+        reset_wide();
+    }
+
+    // Adding new elements at front / back of queue.
+
+    void push_front(const T& e) {
+        emplace_front(e);
+    }
+
+    void push_back(const T& e) {
+        emplace_back(e);
+    }
+
+    void push_front(T&& e) {
+        emplace_front(std::move(e));
+    }
+
+    void push_back(T&& e) {
+        emplace_back(std::move(e));
+    }
+
+    template<typename... Args>
+    void emplace_front(Args&&... args) {
+        if (!widened() && !small_full()) {
+            small_type::emplace_front(std::forward<Args>(args)...);
+            return;
+        }
+        widen();
+        wide()->emplace_front(std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    void emplace_back(Args&&... args) {
+        if (!widened() && !small_full()) {
+            small_type::emplace_back(std::forward<Args>(args)...);
+            return;
+        }
+        widen();
+        wide()->emplace_back(std::forward<Args>(args)...);
+    }
+
+    // Accessing items (front, back, random access, pop).
+
+    const T& front() const {
+        return widened() ? wide()->front() : small_type::front();
+    }
+
+    const T& back() const {
+        return widened() ? wide()->back() : small_type::back();
+    }
+
+    T& front() {
+        return widened() ? wide()->front() : small_type::front();
+    }
+
+    T& back() {
+        return widened() ? wide()->back() : small_type::back();
+    }
+
+    T& operator[] (size_t i) {
+        return widened() ? (*wide())[i] : small_type::operator[](i);
+    }
+
+    const T& operator[] (size_t i) const {
+        return widened() ? (*wide())[i] : small_type::operator[](i);
+    }
+
+    T& at(size_t i) {
+        return widened() ? wide()->at(i) : small_type::at(i);
+    }
+
+    const T& at(size_t i) const {
+        return widened() ? wide()->at(i) : small_type::at(i);
+    }
+
+    void pop_front() {
+        if (widened()) {
+            wide()->pop_front();
+        } else {
+            small_type::pop_front();
+        }
+    }
+
+    void pop_back() {
+        if (widened()) {
+            wide()->pop_back();
+        } else {
+            small_type::pop_back();
+        }
+    }
+
+    // Size of queue
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    WideType size() const {
+        return widened() ? wide()->size() : small_type::size();
+    }
+
+    WideType max_size() const {
+        return (std::numeric_limits<WideType>::max() >> 1) + 1;
+    }
+
+    WideType capacity() const {
+        return widened() ? wide()->capacity() : small_type::capacity();
+    }
+
+    bool widened() const {
+        return this->capacity_ == 0;
+    }
+
+    void clear() {
+        if (widened()) {
+            reset_wide();
+        } else {
+            small_type::clear();
+        }
+    }
+
+    // Copying / assignment
+
+    widening_deque(const widening_deque& other)
+        : small_type(InlineCapacity, other.get_allocator()) {
+        copy_from(other);
+    }
+
+    widening_deque(widening_deque&& other)
+        : small_type(InlineCapacity, other.get_allocator()) {
+        move_from(other);
+    }
+
+    widening_deque& operator=(const widening_deque& other) {
+        if (&other != this) {
+            clear();
+            copy_from(other);
+        }
+        return *this;
+    }
+
+    widening_deque& operator=(widening_deque&& other) {
+        if (&other != this) {
+            clear();
+            move_from(other);
+        }
+        return *this;
+    }
+
+    // Iterators
+
+    typedef inline_deque_detail::index_iterator<
+        widening_deque, T> iterator;
+    typedef inline_deque_detail::index_iterator<
+        const widening_deque, const T> const_iterator;
+
+    iterator begin() {
+        return iterator(this, 0);
+    }
+
+    iterator end() {
+        return iterator(this, size());
+    }
+
+    const_iterator begin() const {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const {
+        return const_iterator(this, size());
+    }
+
+    const_iterator cbegin() const {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator cend() const {
+        return const_iterator(this, size());
+    }
+
+    // Misc
+
+    Allocator get_allocator() const {
+        return small_type::get_allocator();
+    }
+
+protected:
+    typedef typename std::allocator_traits<Allocator>::template
+        rebind_alloc<wide_type> wide_allocator;
+
+    // True if a small queue can't grow any further.
+    bool small_full() const {
+        return this->full() && this->capacity_ == small_type::max_size();
+    }
+
+    // While widened, the storage pointer of the small queue points to
+    // the wide queue.
+    wide_type* wide() const {
+        return reinterpret_cast<wide_type*>(this->e_.e_);
+    }
+
+    // Destroy and free a wide queue.
+    struct wide_deleter {
+        void operator()(wide_type* wide) {
+            wide_allocator alloc(wide->get_allocator());
+            wide->~wide_type();
+            alloc.deallocate(wide, 1);
+        }
+    };
+
+    // Move all elements to a newly allocated wide queue, if not
+    // already done. The queue is only marked as promoted once all
+    // the elements have been moved; until then the wide queue is
+    // owned by a unique_ptr, so a failure frees it again.
+    INLINE_DEQUE_COLD void widen() {
+        if (widened()) {
+            return;
+        }
+        wide_allocator alloc(get_allocator());
+        wide_type* storage = alloc.allocate(1);
+        try {
+            new (storage) wide_type(size_t(small_type::size()) * 2,
+                                    get_allocator());
+        } catch (...) {
+            alloc.deallocate(storage, 1);
+            throw;
+        }
+        std::unique_ptr<wide_type, wide_deleter> wide(storage);
+        for (SmallType i = 0; i < small_type::size(); ++i) {
+            wide->emplace_back(std::move(small_type::operator[](i)));
+        }
+        small_type::reset();
+        this->e_.e_ = reinterpret_cast<T*>(wide.release());
+        this->capacity_ = 0;
+        this->ptr_.read_ = 0;
+        this->ptr_.write_ = 0;
+    }
+
+    // Free the wide queue (if any), and go back to an empty small
+    // queue.
+    void reset_wide() {
+        if (!widened()) {
+            return;
+        }
+        wide_deleter()(wide());
+        this->capacity_ = InlineCapacity;
+    }
+
+    void copy_from(const widening_deque& other) {
+        for (WideType i = 0; i < other.size(); ++i) {
+            emplace_back(other[i]);
+        }
+    }
+
+    void move_from(widening_deque& other) {
+        if (other.widened()) {
+            small_type::reset();
+            this->e_.e_ = other.e_.e_;
+            this->capacity_ = 0;
+            other.capacity_ = InlineCapacity;
+        } else {
+            small_type::operator=(std::move(other));
+        }
+    }
+};
+
+#endif // WIDENING_DEQUE_H
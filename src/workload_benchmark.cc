@@ -0,0 +1,375 @@
+// -*- mode: c++; c-basic-offset: 4 indent-tabs-mode: nil -*- */
+//
+// Copyright 2016 Juho Snellman, released under a MIT license (see
+// LICENSE).
+//
+// Benchmarks for a set of small but realistic workloads, rather
+// than just pushing and popping in a loop:
+//
+// * bfs: breadth-first search over a random graph, with the queue
+//   as the frontier.
+// * window: sliding window maximum (a monotonic queue) and sum over
+//   a random series.
+// * packets: per-flow packet queues, with packets arriving to flows
+//   following a Zipf distribution and being dequeued round-robin
+//   from the active flows.
+// * scheduler: a round-robin task scheduler, where tasks are run
+//   for a time slice and then requeued until done.
+// * undo: a bounded undo history, with edits pushed at the back,
+//   undos popping from the back and the oldest entries being
+//   discarded from the front.
+//
+// Each workload is parameterized on the queue type, and uses
+// deterministic inputs. The checksums of each workload must match
+// across all queue types.
+//
+// Usage: workload_benchmark [scale]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "inline_deque.h"
+
+template<typename T>
+using std_deque = std::deque<T>;
+
+template<typename T>
+using inline_deque_0 = inline_deque<T, 0>;
+
+template<typename T>
+using inline_deque_1 = inline_deque<T, 1>;
+
+template<typename T>
+using inline_deque_4 = inline_deque<T, 4>;
+
+template<typename T>
+using inline_deque_16 = inline_deque<T, 16>;
+
+// BFS
+
+struct Graph {
+    Graph(uint32_t nodes, uint32_t degree, uint64_t seed) {
+        std::mt19937_64 rand(seed);
+        offsets_.reserve(nodes + 1);
+        edges_.reserve(nodes * degree);
+        for (uint32_t i = 0; i < nodes; ++i) {
+            offsets_.push_back(edges_.size());
+            // Mostly local edges with a few long-distance ones, so
+            // that the frontier stays wide but the graph doesn't fall
+            // apart into components.
+            for (uint32_t j = 0; j < degree; ++j) {
+                uint64_t r = rand();
+                uint32_t to;
+                if (j == 0) {
+                    to = (i + 1) % nodes;
+                } else if (r & 1) {
+                    to = (i + (r >> 1) % 64) % nodes;
+                } else {
+                    to = (r >> 1) % nodes;
+                }
+                edges_.push_back(to);
+            }
+        }
+        offsets_.push_back(edges_.size());
+    }
+
+    uint32_t size() const {
+        return offsets_.size() - 1;
+    }
+
+    std::vector<uint32_t> offsets_;
+    std::vector<uint32_t> edges_;
+};
+
+template<template<typename> class Q>
+uint64_t run_bfs(const Graph& graph, int rounds) {
+    uint64_t csum = 0;
+    std::vector<uint32_t> dist(graph.size());
+    for (int round = 0; round < rounds; ++round) {
+        std::fill(dist.begin(), dist.end(), UINT32_MAX);
+        uint32_t start = (round * 7919) % graph.size();
+        Q<uint32_t> frontier;
+        dist[start] = 0;
+        frontier.push_back(start);
+        while (!frontier.empty()) {
+            uint32_t node = frontier.front();
+            frontier.pop_front();
+            for (uint32_t e = graph.offsets_[node];
+                 e < graph.offsets_[node + 1]; ++e) {
+                uint32_t to = graph.edges_[e];
+                if (dist[to] == UINT32_MAX) {
+                    dist[to] = dist[node] + 1;
+                    frontier.push_back(to);
+                }
+            }
+        }
+        for (auto d : dist) {
+            csum += d;
+        }
+    }
+    return csum;
+}
+
+// Sliding window
+
+template<template<typename> class Q>
+uint64_t run_window(const std::vector<uint32_t>& series, int window) {
+    struct Entry {
+        uint32_t index;
+        uint32_t value;
+    };
+    uint64_t csum = 0;
+    uint64_t sum = 0;
+    // Monotonically decreasing values, for the window maximum.
+    Q<Entry> max_queue;
+    // All values in the window, for the sum.
+    Q<uint32_t> values;
+    for (uint32_t i = 0; i < series.size(); ++i) {
+        uint32_t v = series[i];
+        while (!max_queue.empty() && max_queue.back().value <= v) {
+            max_queue.pop_back();
+        }
+        max_queue.push_back(Entry { i, v });
+        if (max_queue.front().index + window <= i) {
+            max_queue.pop_front();
+        }
+        values.push_back(v);
+        sum += v;
+        if (values.size() > window) {
+            sum -= values.front();
+            values.pop_front();
+        }
+        csum += max_queue.front().value ^ sum;
+    }
+    return csum;
+}
+
+// Packet queues
+
+struct Packet {
+    uint32_t flow;
+    uint32_t length;
+    uint64_t seq;
+};
+
+// Flow ids following a Zipf distribution with exponent s.
+std::vector<uint32_t> zipf_flows(uint32_t flows, double s, size_t count,
+                                 uint64_t seed) {
+    std::vector<double> cdf(flows);
+    double total = 0;
+    for (uint32_t i = 0; i < flows; ++i) {
+        total += 1.0 / std::pow(i + 1, s);
+        cdf[i] = total;
+    }
+    std::mt19937_64 rand(seed);
+    std::vector<uint32_t> ret(count);
+    for (size_t i = 0; i < count; ++i) {
+        double r = (rand() >> 11) * (1.0 / (1ull << 53)) * total;
+        ret[i] = std::lower_bound(cdf.begin(), cdf.end(), r) - cdf.begin();
+    }
+    return ret;
+}
+
+template<template<typename> class Q>
+uint64_t run_packets(const std::vector<uint32_t>& arrivals,
+                     uint32_t flows) {
+    uint64_t csum = 0;
+    std::vector<Q<Packet>> queues(flows);
+    // The flows with packets queued, in round-robin order.
+    Q<uint32_t> active;
+    uint64_t seq = 0;
+    size_t next = 0;
+    while (next < arrivals.size() || !active.empty()) {
+        // A burst of arrivals...
+        for (int i = 0; i < 4 && next < arrivals.size(); ++i, ++next) {
+            uint32_t flow = arrivals[next];
+            if (queues[flow].empty()) {
+                active.push_back(flow);
+            }
+            queues[flow].push_back(Packet { flow,
+                        64 + static_cast<uint32_t>(seq % 1400),
+                        seq });
+            ++seq;
+        }
+        // ... and a slightly smaller number of departures, so that
+        // the queues build up over time.
+        for (int i = 0; i < 3 && !active.empty(); ++i) {
+            uint32_t flow = active.front();
+            active.pop_front();
+            const Packet& p = queues[flow].front();
+            csum = csum * 31 + p.seq + p.length;
+            queues[flow].pop_front();
+            if (!queues[flow].empty()) {
+                active.push_back(flow);
+            }
+        }
+    }
+    return csum;
+}
+
+// Scheduler
+
+struct Task {
+    uint32_t id;
+    uint32_t remaining;
+};
+
+template<template<typename> class Q>
+uint64_t run_scheduler(uint32_t tasks, uint64_t seed) {
+    std::mt19937_64 rand(seed);
+    uint64_t csum = 0;
+    uint64_t clock = 0;
+    uint32_t next_id = 0;
+    Q<Task> run_queue;
+    for (; next_id < tasks / 4; ++next_id) {
+        run_queue.push_back(Task { next_id,
+                    static_cast<uint32_t>(rand() % 100) });
+    }
+    while (!run_queue.empty()) {
+        Task task = run_queue.front();
+        run_queue.pop_front();
+        uint32_t slice = std::min(task.remaining, 10u);
+        clock += slice;
+        task.remaining -= slice;
+        if (task.remaining) {
+            run_queue.push_back(task);
+        } else {
+            csum += clock * task.id;
+        }
+        // Tasks occasionally spawn new tasks; high priority ones go
+        // to the front.
+        uint64_t r = rand();
+        if (next_id < tasks && (r & 3) == 0) {
+            Task spawn { next_id++, static_cast<uint32_t>((r >> 8) % 100) };
+            if (r & 0x10) {
+                run_queue.push_front(spawn);
+            } else {
+                run_queue.push_back(spawn);
+            }
+        }
+    }
+    return csum;
+}
+
+// Undo history
+
+struct Edit {
+    uint64_t position;
+    uint64_t length;
+    std::string text;
+};
+
+template<template<typename> class Q>
+uint64_t run_undo(uint32_t edits, uint32_t max_history, uint64_t seed) {
+    std::mt19937_64 rand(seed);
+    uint64_t csum = 0;
+    Q<Edit> history;
+    for (uint32_t i = 0; i < edits; ++i) {
+        uint64_t r = rand();
+        if ((r & 7) == 0 && !history.empty()) {
+            // Undo a run of edits.
+            for (uint32_t n = (r >> 3) % 8; n && !history.empty(); --n) {
+                csum = csum * 31 + history.back().position +
+                    history.back().text.size();
+                history.pop_back();
+            }
+        } else {
+            history.push_back(Edit { r % 100000, (r >> 20) % 64,
+                        std::string((r >> 32) % 24, 'x') });
+            if (history.size() > max_history) {
+                history.pop_front();
+            }
+        }
+    }
+    return csum + history.size();
+}
+
+// Driver
+
+struct Inputs {
+    Inputs(int scale)
+        : graph(100000 * scale, 4, 1),
+          packet_flows(10000),
+          arrivals(zipf_flows(packet_flows, 1.0, 1000000 * scale, 3)) {
+        std::mt19937_64 rand(2);
+        for (int i = 0; i < 2000000 * scale; ++i) {
+            series.push_back(rand() % 1000000);
+        }
+    }
+
+    Graph graph;
+    std::vector<uint32_t> series;
+    uint32_t packet_flows;
+    std::vector<uint32_t> arrivals;
+};
+
+// The checksums for each workload, for checking that all queue
+// implementations computed the same thing.
+static std::map<std::string, uint64_t> csums;
+static bool csum_mismatch = false;
+
+template<class Fun>
+void run(const char* label, const char* workload, Fun fun) {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t csum = fun();
+    auto end = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+    auto it = csums.find(workload);
+    if (it == csums.end()) {
+        csums[workload] = csum;
+    } else if (it->second != csum) {
+        csum_mismatch = true;
+    }
+
+    printf("%-18s %-10s %10.2f ms  %016lx\n", label, workload, ms, csum);
+}
+
+template<template<typename> class Q>
+void run_all(const char* label, const Inputs& in, int scale) {
+    run(label, "bfs", [&] {
+            return run_bfs<Q>(in.graph, 8);
+        });
+    run(label, "window", [&] {
+            return run_window<Q>(in.series, 32) +
+                run_window<Q>(in.series, 4096);
+        });
+    run(label, "packets", [&] {
+            return run_packets<Q>(in.arrivals, in.packet_flows);
+        });
+    run(label, "scheduler", [&] {
+            return run_scheduler<Q>(200000 * scale, 4);
+        });
+    run(label, "undo", [&] {
+            return run_undo<Q>(2000000 * scale, 1000, 5);
+        });
+}
+
+int main(int argc, char** argv) {
+    int scale = 1;
+    if (argc > 1) {
+        sscanf(argv[1], "%d", &scale);
+    }
+
+    Inputs in(scale);
+
+    run_all<std_deque>("std::deque", in, scale);
+    run_all<inline_deque_0>("inline_deque<0>", in, scale);
+    run_all<inline_deque_1>("inline_deque<1>", in, scale);
+    run_all<inline_deque_4>("inline_deque<4>", in, scale);
+    run_all<inline_deque_16>("inline_deque<16>", in, scale);
+
+    if (csum_mismatch) {
+        printf("FAIL: Checksum mismatch\n");
+        return 1;
+    }
+
+    return 0;
+}